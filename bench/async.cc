@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+
+#include "crtc.h"
+
+using namespace crtc;
+
+// Posts batches of callbacks through Async::Call, SetImmediate and SetTimeout and reports ns and heap allocations
+// per callback once the loop has warmed up. Callbacks that fit AsyncTask inline should report 0 allocations.
+//
+//   crtc_bench_async [callbacks] [batch]
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  if (void* ptr = malloc(size ? size : 1)) {
+    return ptr;
+  }
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+static void Drain() {
+  while (Module::DispatchEvents(false)) { }
+}
+
+template <typename Post> static void Run(const char* name, size_t callbacks, size_t batch, Post post) {
+  uint64_t counter = 0;
+
+  // One untimed round so the loop's free list holds a batch worth of nodes.
+  for (size_t index = 0; index < batch; index++) {
+    post(&counter);
+  }
+
+  Drain();
+  counter = 0;
+
+  uint64_t allocated = allocations.load();
+  auto begin = Clock::now();
+
+  for (size_t done = 0; done < callbacks; done += batch) {
+    for (size_t index = 0; index < batch; index++) {
+      post(&counter);
+    }
+
+    Drain();
+  }
+
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+  uint64_t total = allocations.load() - allocated;
+
+  printf("%-14s %9llu callbacks: %7.1f ns/callback, %5.3f allocations/callback\n",
+         name,
+         static_cast<unsigned long long>(counter),
+         ns / counter,
+         static_cast<double>(total) / counter);
+}
+
+int main(int argc, char** argv) {
+  size_t callbacks = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+  size_t batch = argc > 2 ? strtoul(argv[2], nullptr, 10) : 256;
+
+  if (!batch) {
+    batch = 1;
+  }
+
+  Module::Init();
+
+  Run("Async::Call", callbacks, batch, [](uint64_t* counter) {
+    Async::Call([counter]() {
+      (*counter)++;
+    });
+  });
+
+  Run("SetImmediate", callbacks, batch, [](uint64_t* counter) {
+    SetImmediate([](uint64_t* value, int step) {
+      *value += step;
+    }, counter, 1);
+  });
+
+  Run("SetTimeout(0)", callbacks, batch, [](uint64_t* counter) {
+    SetTimeout([](uint64_t* value) {
+      (*value)++;
+    }, 0, counter);
+  });
+
+  Run("std::function", callbacks, batch, [](uint64_t* counter) {
+    std::function<void()> callback([counter]() {
+      (*counter)++;
+    });
+
+    Async::Call(std::move(callback));
+  });
+
+  Drain();
+  Module::Dispose();
+  return 0;
+}
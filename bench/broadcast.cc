@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "crtc.h"
+#include "loopback.h"
+
+using namespace crtc;
+
+// Fans one payload out to N negotiated channels of a loopback connection, once with a Send() of an ArrayBuffer::New()
+// copy per channel and once with RTCDataChannel::Broadcast() from one shared buffer. Reports the cost of a fan-out
+// and the received MB/s, the broadcast cost should not grow with payload size.
+//
+//   crtc_bench_broadcast [channels] [rounds] [size...]
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint64_t kMaxBuffered = 512 * 1024;
+
+static size_t receivedMessages = 0;
+static uint64_t receivedBytes = 0;
+
+template <typename FanOut> static void Run(Loopback* pair, const char* name, size_t size, size_t rounds, size_t subscribers, FanOut fanout) {
+  std::vector<uint8_t> payload(size, 0x5a);
+  Clock::duration sending = Clock::duration::zero();
+  size_t skipped = 0;
+
+  receivedMessages = 0;
+  receivedBytes = 0;
+
+  auto begin = Clock::now();
+
+  for (size_t round = 0; round < rounds && !pair->error; round++) {
+    auto start = Clock::now();
+
+    skipped += fanout(payload);
+    sending += Clock::now() - start;
+
+    Pump(0);
+  }
+
+  while (receivedMessages + skipped < rounds * subscribers && Clock::now() - begin < std::chrono::seconds(60)) {
+    Pump(1);
+  }
+
+  double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+  printf("%-9s %7zu bytes x %4zu channels: %8.1f us/fan-out, %8.1f MB/s received, %zu skipped\n",
+         name,
+         size,
+         subscribers,
+         std::chrono::duration<double, std::micro>(sending).count() / rounds,
+         receivedBytes / seconds / (1024 * 1024),
+         skipped);
+}
+
+int main(int argc, char** argv) {
+  size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 64;
+  size_t rounds = argc > 2 ? strtoul(argv[2], nullptr, 10) : 2000;
+  std::vector<size_t> sizes;
+
+  for (int index = 3; index < argc; index++) {
+    sizes.push_back(strtoul(argv[index], nullptr, 10));
+  }
+
+  if (sizes.empty()) {
+    sizes = { 256, 4096, 65536 };
+  }
+
+  Module::Init();
+
+  Loopback pair;
+
+  if (!Open(&pair)) {
+    fprintf(stderr, "unable to open loopback data channel%s%s\n",
+            pair.error ? ": " : "",
+            pair.error ? pair.error->Message().c_str() : "");
+
+    Close(&pair);
+    Module::Dispose();
+    return 1;
+  }
+
+  std::vector<std::shared_ptr<RTCDataChannel>> senders;
+  std::vector<std::shared_ptr<RTCDataChannel>> receivers;
+  RTCPeerConnection::RTCDataChannelInit init;
+
+  init.negotiated = true;
+
+  for (size_t index = 0; index < count; index++) {
+    init.id = static_cast<int>(100 + index);
+    senders.push_back(pair.local->CreateDataChannel("broadcast", init));
+    receivers.push_back(pair.remote->CreateDataChannel("broadcast", init));
+
+    receivers.back()->onMessage([](std::shared_ptr<ArrayBuffer> data, bool binary) {
+      receivedMessages++;
+      receivedBytes += data->ByteLength();
+    });
+  }
+
+  for (auto deadline = Clock::now() + std::chrono::seconds(10); Clock::now() < deadline; Pump(10)) {
+    bool open = true;
+
+    for (size_t index = 0; index < count; index++) {
+      open = open && senders[index]->ReadyState() == RTCDataChannel::kOpen && receivers[index]->ReadyState() == RTCDataChannel::kOpen;
+    }
+
+    if (open) {
+      break;
+    }
+  }
+
+  for (size_t size : sizes) {
+    Run(&pair, "send", size, rounds, count, [&senders](const std::vector<uint8_t>& payload) {
+      size_t skipped = 0;
+
+      for (auto& sender : senders) {
+        if (sender->BufferedAmount() >= kMaxBuffered) {
+          skipped++;
+          continue;
+        }
+
+        sender->Send(ArrayBuffer::New(payload.data(), payload.size()));
+      }
+
+      return skipped;
+    });
+
+    Run(&pair, "broadcast", size, rounds, count, [&senders](const std::vector<uint8_t>& payload) {
+      auto buffer = ArrayBuffer::NewZeroCopy(payload.size());
+      size_t skipped = 0;
+
+      memcpy(buffer->Data(), payload.data(), payload.size());
+
+      for (auto result : RTCDataChannel::Broadcast(buffer, senders, true, kMaxBuffered)) {
+        skipped += result != RTCDataChannel::kBroadcastSent ? 1 : 0;
+      }
+
+      return skipped;
+    });
+  }
+
+  for (auto& receiver : receivers) {
+    receiver->onMessage(nullptr);
+  }
+
+  senders.clear();
+  receivers.clear();
+
+  Close(&pair);
+  Module::Dispose();
+  return 0;
+}
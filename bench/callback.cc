@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "utils.hpp"
+
+using namespace crtc;
+
+// Invokes one callback from several threads (the media/data threads) while another thread keeps re-registering it,
+// once through synchronized_callback and once through atomic_callback. Reports invocations per second and the
+// worst time a re-registration took.
+//
+//   crtc_bench_callback [threads] [milliseconds]
+
+typedef std::chrono::steady_clock Clock;
+
+template <typename Callback> static void Run(const char* name, size_t threads, int milliseconds) {
+  Callback callback;
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> invokers;
+  std::atomic<uint64_t> total(0);
+
+  // Counts into the calling thread's own counter, the only shared state is the callback itself.
+  callback = [](const void* data, size_t length) {
+    *static_cast<uint64_t*>(const_cast<void*>(data)) += length;
+  };
+
+  for (size_t index = 0; index < threads; index++) {
+    invokers.emplace_back([&]() {
+      uint64_t local = 0;
+
+      while (!stop.load(std::memory_order_relaxed)) {
+        callback(static_cast<const void*>(&local), static_cast<size_t>(1));
+      }
+
+      total.fetch_add(local);
+    });
+  }
+
+  uint64_t registrations = 0;
+  double worst = 0;
+  auto begin = Clock::now();
+
+  while (Clock::now() - begin < std::chrono::milliseconds(milliseconds)) {
+    auto start = Clock::now();
+
+    callback = [](const void* data, size_t length) {
+      *static_cast<uint64_t*>(const_cast<void*>(data)) += length;
+    };
+
+    worst = std::max(worst, std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    registrations++;
+
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+
+  stop = true;
+
+  for (auto& thread : invokers) {
+    thread.join();
+  }
+
+  double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+  printf("%-22s %2zu threads: %12.0f calls/s, %6llu registrations, worst registration %8.1f us\n",
+         name,
+         threads,
+         total.load() / seconds,
+         static_cast<unsigned long long>(registrations),
+         worst);
+}
+
+int main(int argc, char** argv) {
+  size_t threads = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4;
+  int milliseconds = argc > 2 ? atoi(argv[2]) : 1000;
+
+  for (size_t count = 1; count <= threads; count *= 2) {
+    Run<synchronized_callback<const void*, size_t>>("synchronized_callback", count, milliseconds);
+    Run<atomic_callback<const void*, size_t>>("atomic_callback", count, milliseconds);
+  }
+
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+#include "crtc.h"
+#include "loopback.h"
+
+using namespace crtc;
+
+// Sends small messages over a loopback data channel, once as they are and once with RTCDataChannelInit::coalescing,
+// and reports messages/s, SCTP messages per message and the process CPU time per message.
+//
+//   crtc_bench_coalescing [messages] [size] [delay] [maxSize]
+
+typedef std::chrono::steady_clock Clock;
+
+static double CpuMicros() {
+#if !defined(_WIN32)
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e6 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+  }
+#endif
+
+  return 0;
+}
+
+static bool Run(size_t messages, size_t size, const RTCPeerConnection::RTCDataChannelInit& init) {
+  Loopback pair;
+
+  if (!Open(&pair, init) || pair.receiver->Coalesced() != init.coalescing) {
+    fprintf(stderr, "unable to open loopback data channel%s%s\n",
+            pair.error ? ": " : "",
+            pair.error ? pair.error->Message().c_str() : "");
+
+    Close(&pair);
+    return false;
+  }
+
+  size_t received = 0;
+
+  pair.receiver->onMessage([&received](std::shared_ptr<ArrayBuffer> data, bool binary) {
+    received++;
+  });
+
+  std::vector<uint8_t> payload(size, 0x5a);
+  size_t sent = 0;
+  double cpu = CpuMicros();
+  auto begin = Clock::now();
+
+  while (received < messages && !pair.error && Clock::now() - begin < std::chrono::seconds(60)) {
+    while (sent < messages && pair.sender->BufferedAmount() < 1024 * 1024) {
+      pair.sender->Send(payload.data(), payload.size());
+      sent++;
+    }
+
+    Pump(0);
+  }
+
+  double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+  RTCDataChannel::CoalescingStats stats = pair.sender->GetCoalescingStats();
+  uint64_t wire = init.coalescing ? stats.wireMessagesSent : received;
+
+  cpu = CpuMicros() - cpu;
+
+  printf("%-10s %zu x %zu bytes: %.0f msgs/s, %.3f SCTP messages/msg, %.2f us CPU/msg\n",
+         init.coalescing ? "coalescing" : "plain",
+         received,
+         size,
+         received / elapsed,
+         received ? static_cast<double>(wire) / received : 0.0,
+         received ? cpu / received : 0.0);
+
+  pair.receiver->onMessage(nullptr);
+  Close(&pair);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  size_t messages = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+  size_t size = argc > 2 ? strtoul(argv[2], nullptr, 10) : 64;
+  RTCPeerConnection::RTCDataChannelInit init;
+
+  if (argc > 3) {
+    init.coalescingDelay = atoi(argv[3]);
+  }
+
+  if (argc > 4) {
+    init.coalescingMaxSize = strtoul(argv[4], nullptr, 10);
+  }
+
+  Module::Init();
+
+  bool ok = Run(messages, size, init);
+
+  init.coalescing = true;
+  ok = Run(messages, size, init) && ok;
+
+  Module::Dispose();
+  return ok ? 0 : 1;
+}
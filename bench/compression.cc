@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+#include "crtc.h"
+#include "loopback.h"
+
+using namespace crtc;
+
+// Sends JSON-like messages over a compressed loopback data channel and prints the sender's and receiver's
+// compression stats: ratio, deflate/inflate CPU time per message and the received MB/s of uncompressed payload.
+//
+//   crtc_bench_compression [messages] [size] [threshold] [level]
+
+typedef std::chrono::steady_clock Clock;
+
+static std::string Json(size_t size, size_t index) {
+  std::string text = "[";
+
+  while (text.size() < size) {
+    text += "{\"id\":" + std::to_string(index++) + ",\"type\":\"position\",\"x\":12.5,\"y\":-3.25,\"visible\":true},";
+  }
+
+  text.resize(size);
+  return text;
+}
+
+int main(int argc, char** argv) {
+  size_t messages = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+  size_t size = argc > 2 ? strtoul(argv[2], nullptr, 10) : 4096;
+  RTCPeerConnection::RTCDataChannelInit init;
+
+  init.compression = true;
+
+  if (argc > 3) {
+    init.compressionThreshold = strtoul(argv[3], nullptr, 10);
+  }
+
+  if (argc > 4) {
+    init.compressionLevel = atoi(argv[4]);
+  }
+
+  Module::Init();
+
+  Loopback pair;
+
+  if (!Open(&pair, init) || !pair.receiver->Compressed()) {
+    fprintf(stderr, "unable to open compressed loopback data channel%s%s\n",
+            pair.error ? ": " : "",
+            pair.error ? pair.error->Message().c_str() : "");
+
+    Close(&pair);
+    Module::Dispose();
+    return 1;
+  }
+
+  size_t received = 0;
+  uint64_t receivedBytes = 0;
+
+  pair.receiver->onMessage([&received, &receivedBytes](std::shared_ptr<ArrayBuffer> data, bool binary) {
+    received++;
+    receivedBytes += data->ByteLength();
+  });
+
+  std::string payload = Json(size, 0);
+  size_t sent = 0;
+  auto begin = Clock::now();
+
+  while (received < messages && !pair.error && Clock::now() - begin < std::chrono::seconds(60)) {
+    while (sent < messages && pair.sender->BufferedAmount() < 1024 * 1024) {
+      pair.sender->Send(reinterpret_cast<const unsigned char*>(payload.data()), payload.size(), false);
+      sent++;
+    }
+
+    Pump(1);
+  }
+
+  double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+  RTCDataChannel::CompressionStats sender = pair.sender->GetCompressionStats();
+  RTCDataChannel::CompressionStats receiver = pair.receiver->GetCompressionStats();
+
+  printf("%zu x %zu bytes, threshold %zu, level %d: %.1f MB/s, %llu/%llu compressed, ratio %.2f, deflate %.1f us/msg, inflate %.1f us/msg\n",
+         received,
+         size,
+         init.compressionThreshold,
+         init.compressionLevel,
+         receivedBytes / elapsed / (1024 * 1024),
+         static_cast<unsigned long long>(sender.messagesCompressed),
+         static_cast<unsigned long long>(sender.messagesSent),
+         sender.bytesOut ? static_cast<double>(sender.bytesIn) / sender.bytesOut : 0.0,
+         sender.messagesSent ? static_cast<double>(sender.compressMicros) / sender.messagesSent : 0.0,
+         receiver.messagesReceived ? static_cast<double>(receiver.decompressMicros) / receiver.messagesReceived : 0.0);
+
+  Close(&pair);
+  Module::Dispose();
+  return 0;
+}
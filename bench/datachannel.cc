@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "crtc.h"
+#include "loopback.h"
+
+using namespace crtc;
+
+// Data channel throughput and round trip latency between two connections in one process, swept over message size,
+// ordered and unordered delivery and the number of channels sharing the association. Throughput keeps every channel
+// below kHighWater for a fixed time, latency ping-pongs one message per channel through an echo on the far end.
+// Prints one JSON array, an object per run, so results can be diffed between builds.
+//
+//   crtc_bench_datachannel [seconds] [size...]
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint64_t kHighWater = 1024 * 1024;
+static const size_t kPings = 2000;
+static const int kChannels[] = { 1, 4, 16 };
+
+static size_t receivedMessages = 0;
+static uint64_t receivedBytes = 0;
+
+struct Channels {
+  std::vector<std::shared_ptr<RTCDataChannel>> senders;
+  std::vector<std::shared_ptr<RTCDataChannel>> receivers;
+};
+
+struct Result {
+  size_t messages;
+  double seconds;
+  uint64_t bytes;
+  std::vector<double> rtt;
+};
+
+// Channel 0 is the loopback's own, the others are negotiated on both ends so they pair up by id without waiting for
+// onDataChannel.
+static bool OpenChannels(Loopback* pair, int count, bool ordered, Channels* channels) {
+  RTCPeerConnection::RTCDataChannelInit init;
+
+  init.ordered = ordered;
+  init.negotiated = true;
+
+  channels->senders.push_back(pair->sender);
+  channels->receivers.push_back(pair->receiver);
+
+  for (int index = 1; index < count; index++) {
+    init.id = 100 + index;
+    channels->senders.push_back(pair->local->CreateDataChannel("bench", init));
+    channels->receivers.push_back(pair->remote->CreateDataChannel("bench", init));
+
+    if (!channels->senders.back() || !channels->receivers.back()) {
+      return false;
+    }
+  }
+
+  auto deadline = Clock::now() + std::chrono::seconds(10);
+
+  while (!pair->error && Clock::now() < deadline) {
+    bool open = true;
+
+    for (size_t index = 0; index < channels->senders.size(); index++) {
+      open = open &&
+        channels->senders[index]->ReadyState() == RTCDataChannel::kOpen &&
+        channels->receivers[index]->ReadyState() == RTCDataChannel::kOpen;
+    }
+
+    if (open) {
+      return true;
+    }
+
+    Pump(10);
+  }
+
+  return false;
+}
+
+// Runs the loop until nothing was dispatched for 50 ms, so calls posted before the callbacks were cleared are done.
+static void Settle() {
+  auto quiet = Clock::now() + std::chrono::milliseconds(50);
+
+  while (Clock::now() < quiet) {
+    if (Module::DispatchEvents(false)) {
+      quiet = Clock::now() + std::chrono::milliseconds(50);
+    }
+    else {
+      Pump(1);
+    }
+  }
+}
+
+static void Throughput(Channels* channels, size_t size, int seconds, Result* result) {
+  auto payload = ArrayBuffer::NewZeroCopy(size);
+
+  memset(payload->Data(), 0x5a, size);
+
+  for (auto& receiver : channels->receivers) {
+    receiver->onMessage([](std::shared_ptr<ArrayBuffer> data, bool binary) {
+      receivedMessages++;
+      receivedBytes += data->ByteLength();
+    });
+  }
+
+  receivedMessages = 0;
+  receivedBytes = 0;
+
+  auto begin = Clock::now();
+  auto end = begin + std::chrono::seconds(seconds);
+
+  while (Clock::now() < end) {
+    for (auto& sender : channels->senders) {
+      while (sender->BufferedAmount() < kHighWater) {
+        sender->Send(payload);
+      }
+    }
+
+    Pump(1);
+  }
+
+  result->messages = receivedMessages;
+  result->bytes = receivedBytes;
+  result->seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+  // Let the tail drain so it does not land in the latency run.
+  for (auto drain = Clock::now() + std::chrono::seconds(5); Clock::now() < drain;) {
+    uint64_t buffered = 0;
+
+    for (auto& sender : channels->senders) {
+      buffered += sender->BufferedAmount();
+    }
+
+    if (!buffered) {
+      break;
+    }
+
+    Pump(1);
+  }
+
+  for (auto& receiver : channels->receivers) {
+    receiver->onMessage(nullptr);
+  }
+
+  Settle();
+}
+
+// The first 4 bytes of a ping carry its sequence number, the far end sends the buffer back as is.
+static void Latency(Channels* channels, size_t size, Result* result) {
+  size_t count = channels->senders.size();
+  std::vector<Clock::time_point> sent(kPings);
+  size_t next = 0;
+
+  size = std::max<size_t>(size, 4);
+  result->rtt.clear();
+  result->rtt.reserve(kPings);
+
+  auto ping = [&](size_t index) {
+    if (next >= kPings) {
+      return;
+    }
+
+    auto payload = ArrayBuffer::NewZeroCopy(size);
+    uint32_t sequence = static_cast<uint32_t>(next++);
+
+    memcpy(payload->Data(), &sequence, sizeof(sequence));
+    sent[sequence] = Clock::now();
+    channels->senders[index]->Send(payload);
+  };
+
+  for (size_t index = 0; index < count; index++) {
+    auto receiver = channels->receivers[index].get();
+
+    receiver->onMessage([receiver](std::shared_ptr<ArrayBuffer> data, bool binary) {
+      receiver->Send(data, binary);
+    });
+
+    channels->senders[index]->onMessage([&, index](std::shared_ptr<ArrayBuffer> data, bool binary) {
+      uint32_t sequence = 0;
+
+      memcpy(&sequence, data->Data(), sizeof(sequence));
+
+      if (sequence < kPings) {
+        result->rtt.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent[sequence]).count());
+      }
+
+      ping(index);
+    });
+  }
+
+  for (size_t index = 0; index < count; index++) {
+    ping(index);
+  }
+
+  auto deadline = Clock::now() + std::chrono::seconds(30);
+
+  while (result->rtt.size() < next && Clock::now() < deadline) {
+    Pump(1);
+  }
+
+  for (size_t index = 0; index < count; index++) {
+    channels->receivers[index]->onMessage(nullptr);
+    channels->senders[index]->onMessage(nullptr);
+  }
+
+  Settle();
+  std::sort(result->rtt.begin(), result->rtt.end());
+}
+
+static double Percentile(const std::vector<double>& sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0;
+  }
+
+  size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int main(int argc, char** argv) {
+  int seconds = argc > 1 ? atoi(argv[1]) : 2;
+  std::vector<size_t> sizes;
+
+  for (int index = 2; index < argc; index++) {
+    sizes.push_back(strtoul(argv[index], nullptr, 10));
+  }
+
+  if (sizes.empty()) {
+    sizes = { 64, 1024, 16 * 1024, 64 * 1024 };
+  }
+
+  Module::Init();
+
+  bool first = true;
+  int status = 0;
+
+  printf("[\n");
+
+  for (bool ordered : { true, false }) {
+    for (int count : kChannels) {
+      Loopback pair;
+      Channels channels;
+      RTCPeerConnection::RTCDataChannelInit init;
+
+      init.ordered = ordered;
+
+      if (!Open(&pair, init) || !OpenChannels(&pair, count, ordered, &channels)) {
+        fprintf(stderr, "unable to open %d %s loopback data channels%s%s\n",
+                count,
+                ordered ? "ordered" : "unordered",
+                pair.error ? ": " : "",
+                pair.error ? pair.error->Message().c_str() : "");
+
+        status = 1;
+      }
+      else {
+        for (size_t size : sizes) {
+          Result result;
+
+          Throughput(&channels, size, seconds, &result);
+          Latency(&channels, size, &result);
+
+          printf("%s  {\"size\": %zu, \"ordered\": %s, \"channels\": %d, \"messages\": %zu, \"msgs_per_sec\": %.0f, \"mb_per_sec\": %.2f, "
+                 "\"rtt_us\": {\"samples\": %zu, \"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f}}",
+                 first ? "" : ",\n",
+                 size,
+                 ordered ? "true" : "false",
+                 count,
+                 result.messages,
+                 result.messages / result.seconds,
+                 result.bytes / result.seconds / (1024 * 1024),
+                 result.rtt.size(),
+                 Percentile(result.rtt, 0.50),
+                 Percentile(result.rtt, 0.99),
+                 Percentile(result.rtt, 0.999));
+
+          fflush(stdout);
+          first = false;
+        }
+      }
+
+      channels.senders.clear();
+      channels.receivers.clear();
+      Close(&pair);
+    }
+  }
+
+  printf("\n]\n");
+
+  Module::Dispose();
+  return status;
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "crtc.h"
+#include "executor.h"
+
+using namespace crtc;
+
+// Floods each executor policy with tasks that take about a microsecond and reports the submit cost next to the
+// executor's own counters. A bounded pool that falls behind shows up as drops and a peak queue depth at maxQueued.
+//
+//   crtc_bench_executor [tasks] [threads] [maxQueued]
+
+typedef std::chrono::steady_clock Clock;
+
+static void Spin() {
+  auto end = Clock::now() + std::chrono::microseconds(1);
+
+  while (Clock::now() < end) { }
+}
+
+static void Run(const char* name, const std::shared_ptr<Executor>& executor, size_t tasks, bool dispatch) {
+  auto target = ExecutorInternal::From(executor);
+  std::atomic<size_t> done(0);
+  auto begin = Clock::now();
+
+  for (size_t index = 0; index < tasks; index++) {
+    target->Execute([&done]() {
+      Spin();
+      done.fetch_add(1, std::memory_order_relaxed);
+    });
+  }
+
+  double submit = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+
+  // Wait for whatever was accepted, the loop executor only drains while the default loop is dispatched.
+  for (;;) {
+    if (dispatch) {
+      while (Module::DispatchEvents(false)) { }
+    }
+
+    Executor::Stats stats = executor->GetStats();
+
+    if (done.load() >= stats.executed && !stats.queued) {
+      break;
+    }
+
+    std::this_thread::yield();
+  }
+
+  Executor::Stats stats = executor->GetStats();
+
+  printf("%-7s %9zu tasks: submit %6.1f ns/task, executed %llu, dropped %llu, peak queue %llu\n",
+         name,
+         tasks,
+         submit / tasks,
+         static_cast<unsigned long long>(stats.executed),
+         static_cast<unsigned long long>(stats.dropped),
+         static_cast<unsigned long long>(stats.peakQueued));
+}
+
+int main(int argc, char** argv) {
+  size_t tasks = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+  size_t threads = argc > 2 ? strtoul(argv[2], nullptr, 10) : 2;
+  size_t maxQueued = argc > 3 ? strtoul(argv[3], nullptr, 10) : 1024;
+
+  Module::Init();
+
+  Run("inline", Executor::Inline(), tasks, false);
+  Run("loop", Executor::Loop(nullptr, maxQueued), tasks, true);
+  Run("pool", Executor::Pool(threads, maxQueued), tasks, false);
+
+  Module::Dispose();
+  return 0;
+}
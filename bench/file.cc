@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "crtc.h"
+#include "loopback.h"
+
+using namespace crtc;
+
+// Writes a file of the given size, sends it with SendFile() over a framed loopback data channel into ReceiveFile()
+// and reports the MB/s from the first chunk to the last byte written, then checks that both files match.
+//
+//   crtc_bench_file [megabytes] [chunk] [directory]
+
+typedef std::chrono::steady_clock Clock;
+
+static bool WriteSource(const std::string& path, size_t size) {
+  FILE* file = fopen(path.c_str(), "wb");
+  std::vector<uint8_t> block(1024 * 1024);
+
+  if (!file) {
+    return false;
+  }
+
+  for (size_t index = 0; index < block.size(); index++) {
+    block[index] = static_cast<uint8_t>(index * 31 + 7);
+  }
+
+  for (size_t written = 0; written < size; written += block.size()) {
+    size_t length = size - written < block.size() ? size - written : block.size();
+
+    if (fwrite(block.data(), 1, length, file) != length) {
+      fclose(file);
+      return false;
+    }
+  }
+
+  return fclose(file) == 0;
+}
+
+static bool Same(const std::string& left, const std::string& right) {
+  FILE* a = fopen(left.c_str(), "rb");
+  FILE* b = fopen(right.c_str(), "rb");
+  std::vector<uint8_t> x(1024 * 1024), y(1024 * 1024);
+  bool same = a && b;
+
+  while (same) {
+    size_t read = fread(x.data(), 1, x.size(), a);
+
+    same = fread(y.data(), 1, y.size(), b) == read && memcmp(x.data(), y.data(), read) == 0;
+
+    if (read < x.size()) {
+      break;
+    }
+  }
+
+  if (a) {
+    fclose(a);
+  }
+
+  if (b) {
+    fclose(b);
+  }
+
+  return same;
+}
+
+int main(int argc, char** argv) {
+  size_t megabytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 256;
+  RTCDataChannel::FramedOptions options;
+  std::string directory = argc > 3 ? argv[3] : "/tmp";
+  std::string source = directory + "/crtc_bench_file.in";
+  std::string target = directory + "/crtc_bench_file.out";
+
+  if (argc > 2) {
+    options.chunkSize = strtoul(argv[2], nullptr, 10);
+  }
+
+  if (!WriteSource(source, megabytes * 1024 * 1024)) {
+    fprintf(stderr, "unable to write %s\n", source.c_str());
+    return 1;
+  }
+
+  Module::Init();
+
+  Loopback pair;
+
+  if (!Open(&pair)) {
+    fprintf(stderr, "unable to open loopback data channel%s%s\n",
+            pair.error ? ": " : "",
+            pair.error ? pair.error->Message().c_str() : "");
+
+    Close(&pair);
+    Module::Dispose();
+    return 1;
+  }
+
+  pair.sender->SetFramed(true, options);
+  pair.receiver->SetFramed(true, options);
+
+  std::shared_ptr<Error> sendError, receiveError;
+  bool sent = false, received = false;
+  Clock::time_point begin, end;
+
+  RTCDataChannel::FileOptions receive;
+
+  receive.maxSize = static_cast<uint64_t>(megabytes) * 1024 * 1024;
+
+  pair.receiver->ReceiveFile(target.c_str(), receive, [&](std::shared_ptr<Error> error) {
+    receiveError = error;
+    received = true;
+    end = Clock::now();
+  });
+
+  begin = Clock::now();
+
+  pair.sender->SendFile(source.c_str(), RTCDataChannel::FileOptions(), [&](std::shared_ptr<Error> error) {
+    sendError = error;
+    sent = true;
+  });
+
+  while ((!sent || !received) && !sendError && !pair.error && Clock::now() - begin < std::chrono::seconds(120)) {
+    Pump(1);
+  }
+
+  if (!received || sendError || receiveError) {
+    std::shared_ptr<Error> error = sendError ? sendError : receiveError ? receiveError : pair.error;
+
+    fprintf(stderr, "file transfer failed%s%s\n", error ? ": " : "", error ? error->Message().c_str() : "");
+    Close(&pair);
+    Module::Dispose();
+    return 1;
+  }
+
+  double elapsed = std::chrono::duration<double>(end - begin).count();
+
+  printf("%zu MB in %zu byte chunks: %.1f MB/s, %s\n",
+         megabytes,
+         options.chunkSize,
+         megabytes / elapsed,
+         Same(source, target) ? "files match" : "FILES DIFFER");
+
+  remove(source.c_str());
+  remove(target.c_str());
+
+  Close(&pair);
+  Module::Dispose();
+  return 0;
+}
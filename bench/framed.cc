@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+#include "crtc.h"
+#include "loopback.h"
+
+using namespace crtc;
+
+// Sends large messages in framed mode over a loopback data channel and reports MB/s and the process' peak RSS over
+// the one payload both ends share. Reassembled messages add their own size once, streamed ones (onChunk) only a
+// chunk, independent of the message size.
+//
+//   crtc_bench_framed [messages] [size] [stream|reassemble] [chunk]
+
+typedef std::chrono::steady_clock Clock;
+
+static long ReadStatus(const char* key) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  size_t length = strlen(key);
+
+  while (std::getline(status, line)) {
+    if (line.compare(0, length, key) == 0) {
+      return atol(line.c_str() + length);
+    }
+  }
+
+  return -1;
+}
+
+int main(int argc, char** argv) {
+  size_t messages = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4;
+  size_t size = argc > 2 ? strtoul(argv[2], nullptr, 10) : 100 * 1024 * 1024;
+  bool stream = argc > 3 && strcmp(argv[3], "stream") == 0;
+  RTCDataChannel::FramedOptions options;
+
+  if (argc > 4) {
+    options.chunkSize = strtoul(argv[4], nullptr, 10);
+  }
+
+  options.maxReassembly = static_cast<uint64_t>(size) * 2;
+
+  Module::Init();
+
+  Loopback pair;
+
+  if (!Open(&pair)) {
+    fprintf(stderr, "unable to open loopback data channel%s%s\n",
+            pair.error ? ": " : "",
+            pair.error ? pair.error->Message().c_str() : "");
+
+    Close(&pair);
+    Module::Dispose();
+    return 1;
+  }
+
+  uint64_t receivedBytes = 0;
+  size_t received = 0;
+  uint64_t errors = 0;
+
+  pair.sender->SetFramed(true, options);
+  pair.receiver->SetFramed(true, options);
+
+  if (stream) {
+    pair.receiver->onChunk([&receivedBytes, &received](std::shared_ptr<ArrayBuffer> chunk, uint64_t offset, uint64_t length, bool binary) {
+      receivedBytes += chunk->ByteLength();
+
+      if (offset + chunk->ByteLength() == length) {
+        received++;
+      }
+    });
+  }
+  else {
+    pair.receiver->onMessage([&receivedBytes, &received](std::shared_ptr<ArrayBuffer> data, bool binary) {
+      receivedBytes += data->ByteLength();
+      received++;
+    });
+  }
+
+  pair.receiver->onError([&errors](std::shared_ptr<Error> error) {
+    errors++;
+  });
+
+  pair.sender->onError([&errors](std::shared_ptr<Error> error) {
+    errors++;
+  });
+
+  auto payload = ArrayBuffer::NewZeroCopy(size);
+  memset(payload->Data(), 0x5a, size);
+
+  long rss = ReadStatus("VmRSS:");
+  auto begin = Clock::now();
+
+  for (size_t index = 0; index < messages; index++) {
+    pair.sender->Send(payload);
+  }
+
+  while (received < messages && !errors && Clock::now() - begin < std::chrono::seconds(300)) {
+    Pump(1);
+  }
+
+  double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+  printf("%-10s %zu x %zu bytes, chunk %zu: %.1f MB/s, rss before %ld kB, peak %ld kB, %zu received, %llu errors\n",
+         stream ? "stream" : "reassemble",
+         messages,
+         size,
+         options.chunkSize,
+         receivedBytes / elapsed / (1024 * 1024),
+         rss,
+         ReadStatus("VmHWM:"),
+         received,
+         static_cast<unsigned long long>(errors));
+
+  Close(&pair);
+  Module::Dispose();
+  return 0;
+}
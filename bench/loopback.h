@@ -0,0 +1,139 @@
+#ifndef CRTC_BENCH_LOOPBACK_H
+#define CRTC_BENCH_LOOPBACK_H
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#if defined(__linux__)
+#include <poll.h>
+#endif
+
+#include "crtc.h"
+
+// Two connections in one process that only exchange host candidates (no STUN) and deliver every callback to the
+// default loop, so a benchmark drives both ends from its own thread with Pump(). The Loopback has to stay alive
+// until Close() returned, the connection callbacks point back at it.
+
+struct Loopback {
+  std::shared_ptr<crtc::RTCPeerConnection> local;
+  std::shared_ptr<crtc::RTCPeerConnection> remote;
+  std::shared_ptr<crtc::RTCDataChannel> sender;
+  std::shared_ptr<crtc::RTCDataChannel> receiver;
+  std::shared_ptr<crtc::Error> error;
+};
+
+// Runs ready callbacks, waits up to timeoutMs on the loop's fd when there were none.
+inline void Pump(int timeoutMs = 1) {
+  if (crtc::Module::DispatchEvents(false)) {
+    return;
+  }
+
+#if defined(__linux__)
+  struct pollfd fd = {};
+
+  fd.fd = crtc::Module::GetFd();
+  fd.events = POLLIN;
+
+  if (fd.fd >= 0) {
+    poll(&fd, 1, timeoutMs);
+    crtc::Module::DispatchEvents(false);
+    return;
+  }
+#endif
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+  crtc::Module::DispatchEvents(false);
+}
+
+inline bool Open(Loopback* pair,
+                 const crtc::RTCPeerConnection::RTCDataChannelInit& init = crtc::RTCPeerConnection::RTCDataChannelInit(),
+                 int timeoutMs = 10000,
+                 crtc::RTCPeerConnection::RTCConfiguration config = crtc::RTCPeerConnection::RTCConfiguration()) {
+  using namespace crtc;
+
+  config.iceServers.clear();
+
+  pair->local = RTCPeerConnection::New(config, EventLoop::Default());
+  pair->remote = RTCPeerConnection::New(config, EventLoop::Default());
+
+  if (!pair->local || !pair->remote) {
+    return false;
+  }
+
+  auto fail = [pair](std::shared_ptr<Error> error) {
+    if (error && !pair->error) {
+      pair->error = error;
+    }
+  };
+
+  pair->local->onIceCandidate([pair](const std::shared_ptr<RTCPeerConnection::RTCIceCandidate> candidate) {
+    pair->remote->AddIceCandidate(*candidate);
+  });
+
+  pair->remote->onIceCandidate([pair](const std::shared_ptr<RTCPeerConnection::RTCIceCandidate> candidate) {
+    pair->local->AddIceCandidate(*candidate);
+  });
+
+  pair->remote->onDataChannel([pair](const std::shared_ptr<RTCDataChannel> channel) {
+    pair->receiver = channel;
+  });
+
+  pair->sender = pair->local->CreateDataChannel("bench", init);
+
+  if (!pair->sender) {
+    return false;
+  }
+
+  pair->local->CreateOffer([pair, fail](RTCPeerConnection::RTCSessionDescription* description) {
+    auto offer = std::make_shared<const RTCPeerConnection::RTCSessionDescription>(*description);
+
+    pair->local->SetLocalDescription(offer, fail);
+    pair->remote->SetRemoteDescription(offer, [pair, fail](std::shared_ptr<Error> error) {
+      if (error) {
+        return fail(error);
+      }
+
+      pair->remote->CreateAnswer([pair, fail](RTCPeerConnection::RTCSessionDescription* description) {
+        auto answer = std::make_shared<const RTCPeerConnection::RTCSessionDescription>(*description);
+
+        pair->remote->SetLocalDescription(answer, fail);
+        pair->local->SetRemoteDescription(answer, fail);
+      }, RTCPeerConnection::RTCAnswerOptions(), fail);
+    });
+  }, RTCPeerConnection::RTCOfferOptions(), fail);
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+  while (!pair->error && std::chrono::steady_clock::now() < deadline) {
+    if (pair->receiver &&
+        pair->receiver->ReadyState() == RTCDataChannel::kOpen &&
+        pair->sender->ReadyState() == RTCDataChannel::kOpen)
+    {
+      return true;
+    }
+
+    Pump(10);
+  }
+
+  return false;
+}
+
+inline void Close(Loopback* pair) {
+  for (auto& pc : { pair->local, pair->remote }) {
+    if (pc) {
+      pc->onIceCandidate(nullptr);
+      pc->onDataChannel(nullptr);
+      pc->Close();
+    }
+  }
+
+  while (crtc::Module::DispatchEvents(false)) { }
+
+  pair->sender.reset();
+  pair->receiver.reset();
+  pair->local.reset();
+  pair->remote.reset();
+}
+
+#endif
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "crtc.h"
+#include "loopback.h"
+
+using namespace crtc;
+
+// One bulk stream keeps an RTCDataChannelMux busy with large writes while a control stream sends a small message
+// every 10 ms. Reports the bulk MB/s and the control messages' one way latency, once with both streams at the same
+// priority and once with the control stream above the bulk one.
+//
+//   crtc_bench_mux [seconds] [chunk]
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint32_t kBulk = 1;
+static const uint32_t kControl = 2;
+
+static double Percentile(const std::vector<double>& sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0;
+  }
+
+  return sorted[std::min(static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5), sorted.size() - 1)];
+}
+
+static void Run(Loopback* pair, int seconds, size_t chunk, int priority) {
+  auto sender = RTCDataChannelMux::New(pair->sender);
+  auto receiver = RTCDataChannelMux::New(pair->receiver);
+  uint64_t bulkBytes = 0;
+  std::vector<double> latency;
+
+  receiver->onStream([&](std::shared_ptr<RTCDataChannelMux::Stream> stream) {
+    if (stream->Id() == kBulk) {
+      stream->onMessage([&bulkBytes](std::shared_ptr<ArrayBuffer> data, bool binary) {
+        bulkBytes += data->ByteLength();
+      });
+
+      return;
+    }
+
+    stream->onMessage([&latency](std::shared_ptr<ArrayBuffer> data, bool binary) {
+      Clock::rep sent = 0;
+
+      memcpy(&sent, data->Data(), sizeof(sent));
+      latency.push_back(std::chrono::duration<double, std::micro>(Clock::now() - Clock::time_point(Clock::duration(sent))).count());
+    });
+  });
+
+  auto bulk = sender->CreateStream(kBulk, 0);
+  auto control = sender->CreateStream(kControl, priority);
+  auto payload = ArrayBuffer::NewZeroCopy(chunk);
+  bool waiting = false;
+
+  memset(payload->Data(), 0x5a, chunk);
+
+  auto begin = Clock::now();
+  auto next = begin;
+
+  while (Clock::now() - begin < std::chrono::seconds(seconds)) {
+    while (!waiting) {
+      if (bulk->Write(payload)) {
+        continue;
+      }
+
+      waiting = true;
+
+      bulk->Ready([&waiting](std::shared_ptr<Error> error) {
+        waiting = false;
+      });
+    }
+
+    if (Clock::now() >= next) {
+      auto ping = ArrayBuffer::NewZeroCopy(sizeof(Clock::rep));
+      Clock::rep now = Clock::now().time_since_epoch().count();
+
+      memcpy(ping->Data(), &now, sizeof(now));
+      control->Write(ping);
+      next += std::chrono::milliseconds(10);
+    }
+
+    Pump(1);
+  }
+
+  double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+  std::sort(latency.begin(), latency.end());
+
+  printf("control priority %d: bulk %.1f MB/s, control latency p50 %.1f us, p99 %.1f us, max %.1f us over %zu messages\n",
+         priority,
+         bulkBytes / elapsed / (1024 * 1024),
+         Percentile(latency, 0.50),
+         Percentile(latency, 0.99),
+         latency.empty() ? 0.0 : latency.back(),
+         latency.size());
+
+  // Release the muxes before the next run takes over the channels, posted calls still reference the locals above.
+  bulk->Close();
+  control->Close();
+  sender.reset();
+  receiver.reset();
+
+  while (Module::DispatchEvents(false)) { }
+}
+
+int main(int argc, char** argv) {
+  int seconds = argc > 1 ? atoi(argv[1]) : 5;
+  size_t chunk = argc > 2 ? strtoul(argv[2], nullptr, 10) : 64 * 1024;
+
+  Module::Init();
+
+  Loopback pair;
+
+  if (!Open(&pair)) {
+    fprintf(stderr, "unable to open loopback data channel%s%s\n",
+            pair.error ? ": " : "",
+            pair.error ? pair.error->Message().c_str() : "");
+
+    Close(&pair);
+    Module::Dispose();
+    return 1;
+  }
+
+  Run(&pair, seconds, chunk, 0);
+  Run(&pair, seconds, chunk, 1);
+
+  Close(&pair);
+  Module::Dispose();
+  return 0;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "crtc.h"
+
+using namespace crtc;
+
+// Creates 10/100/1000 connections and reports OS thread count, resident memory and setup time.
+//
+//   crtc_bench_peerconnection [--isolated] [--shards N] [count...]
+//
+// --isolated gives every connection its own RTCPeerConnectionFactory, which is how
+// RTCPeerConnection::New() behaved before the factory threads were shared.
+// --shards N places the connections on a factory with N network/worker thread pairs.
+
+static long ReadStatus(const char* key) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  size_t length = strlen(key);
+
+  while (std::getline(status, line)) {
+    if (line.compare(0, length, key) == 0) {
+      return atol(line.c_str() + length);
+    }
+  }
+
+  return -1;
+}
+
+static void Run(size_t count, bool isolated, const std::shared_ptr<RTCPeerConnectionFactory>& sharded) {
+  std::vector<std::shared_ptr<RTCPeerConnectionFactory>> factories;
+  std::vector<std::shared_ptr<RTCPeerConnection>> connections;
+  RTCPeerConnection::RTCConfiguration config;
+
+  config.iceServers.clear();
+
+  long threads = ReadStatus("Threads:");
+  long rss = ReadStatus("VmRSS:");
+  auto begin = std::chrono::steady_clock::now();
+
+  for (size_t index = 0; index < count; index++) {
+    if (isolated) {
+      factories.push_back(RTCPeerConnectionFactory::New());
+      connections.push_back(factories.back()->CreatePeerConnection(config));
+    } else if (sharded) {
+      connections.push_back(sharded->CreatePeerConnection(config));
+    } else {
+      connections.push_back(RTCPeerConnection::New(config));
+    }
+  }
+
+  auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+
+  printf("%-9s %6zu connections: threads %+5ld, rss %+8ld kB, setup %10.1f us total, %8.1f us/connection\n",
+         isolated ? "isolated" : (sharded ? "sharded" : "shared"),
+         count,
+         ReadStatus("Threads:") - threads,
+         ReadStatus("VmRSS:") - rss,
+         elapsed,
+         elapsed / count);
+
+  if (sharded) {
+    auto shards = sharded->Shards();
+
+    for (size_t index = 0; index < shards.size(); index++) {
+      printf("  shard %zu: %zu connections, %llu network tasks, %llu worker tasks\n",
+             index,
+             shards[index].connections,
+             static_cast<unsigned long long>(shards[index].networkTasks),
+             static_cast<unsigned long long>(shards[index].workerTasks));
+    }
+  }
+
+  for (auto& pc : connections) {
+    if (pc) {
+      pc->Close();
+    }
+  }
+
+  connections.clear();
+  factories.clear();
+
+  while (Module::DispatchEvents(false)) { }
+}
+
+int main(int argc, char** argv) {
+  std::vector<size_t> counts;
+  bool isolated = false;
+  size_t shards = 0;
+
+  for (int index = 1; index < argc; index++) {
+    if (!strcmp(argv[index], "--isolated")) {
+      isolated = true;
+    } else if (!strcmp(argv[index], "--shards") && index + 1 < argc) {
+      shards = strtoul(argv[++index], nullptr, 10);
+    } else {
+      counts.push_back(strtoul(argv[index], nullptr, 10));
+    }
+  }
+
+  if (counts.empty()) {
+    counts = { 10, 100, 1000 };
+  }
+
+  Module::Init();
+
+  std::shared_ptr<RTCPeerConnectionFactory> sharded;
+
+  if (shards) {
+    RTCPeerConnectionFactory::Options options;
+    options.shards = shards;
+    sharded = RTCPeerConnectionFactory::New(options);
+  }
+
+  for (auto count : counts) {
+    Run(count, isolated, sharded);
+  }
+
+  sharded.reset();
+
+  Module::Dispose();
+  return 0;
+}
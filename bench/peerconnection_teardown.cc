@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "crtc.h"
+
+using namespace crtc;
+
+// Tears down 100/500 connections that have a data channel and a local offer applied (ports allocated)
+// and reports how long the main thread was blocked and when the resources were actually released.
+//
+//   crtc_bench_teardown [--sync] [count...]
+//
+// --sync drops the connections without CloseAsync(), every connection then closes its transports in its destructor,
+// which runs on the loop.
+
+typedef std::chrono::steady_clock Clock;
+
+static long ReadStatus(const char* key) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  size_t length = strlen(key);
+
+  while (std::getline(status, line)) {
+    if (line.compare(0, length, key) == 0) {
+      return atol(line.c_str() + length);
+    }
+  }
+
+  return -1;
+}
+
+static double Millis(Clock::time_point begin) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+static void Dispatch() {
+  if (!Module::DispatchEvents(static_cast<size_t>(64), static_cast<int64_t>(1000))) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+static size_t Connections() {
+  size_t connections = 0;
+
+  for (const auto& shard : RTCPeerConnectionFactory::Default()->Shards()) {
+    connections += shard.connections;
+  }
+
+  return connections;
+}
+
+static std::vector<std::shared_ptr<RTCPeerConnection>> Prepare(size_t count) {
+  std::vector<std::shared_ptr<RTCPeerConnection>> connections;
+  std::vector<std::shared_ptr<RTCDataChannel>> channels;
+  RTCPeerConnection::RTCConfiguration config;
+
+  config.iceServers.clear();
+
+  for (size_t index = 0; index < count; index++) {
+    auto pc = RTCPeerConnection::New(config);
+
+    if (!pc) {
+      continue;
+    }
+
+    RTCPeerConnection* target = pc.get();
+
+    channels.push_back(pc->CreateDataChannel("bench"));
+    pc->CreateOffer([target](RTCPeerConnection::RTCSessionDescription* desc) {
+      target->SetLocalDescription(std::make_shared<const RTCPeerConnection::RTCSessionDescription>(*desc));
+    });
+
+    connections.push_back(pc);
+  }
+
+  auto begin = Clock::now();
+  size_t ready = 0;
+
+  while (ready < connections.size() && Millis(begin) < 30000) {
+    Dispatch();
+    ready = 0;
+
+    for (const auto& pc : connections) {
+      if (pc->SignalingState() == RTCPeerConnection::kHaveLocalOffer) {
+        ready++;
+      }
+    }
+  }
+
+  if (ready < connections.size()) {
+    fprintf(stderr, "only %zu of %zu connections applied their offer\n", ready, connections.size());
+  }
+
+  return connections;
+}
+
+static void Run(size_t count, bool sync) {
+  long threads = ReadStatus("Threads:");
+  long rss = ReadStatus("VmRSS:");
+  auto connections = Prepare(count);
+  size_t total = connections.size();
+  size_t completed = 0;
+
+  long peakThreads = ReadStatus("Threads:");
+  long peakRss = ReadStatus("VmRSS:");
+  auto begin = Clock::now();
+
+  if (!sync) {
+    for (auto& pc : connections) {
+      pc->CloseAsync([&completed]() {
+        completed++;
+      });
+    }
+  }
+
+  connections.clear();
+
+  double blocked = Millis(begin);
+
+  while (!sync && completed < total) {
+    Dispatch();
+  }
+
+  while (sync && Connections() > 0 && Millis(begin) < 30000) {
+    Dispatch();
+  }
+
+  double released = Millis(begin);
+
+  printf("%-5s %6zu connections: main thread blocked %9.1f ms, released after %9.1f ms, threads %+4ld/%+4ld, rss %+8ld/%+8ld kB\n",
+         sync ? "sync" : "async",
+         total,
+         blocked,
+         released,
+         peakThreads - threads,
+         ReadStatus("Threads:") - threads,
+         peakRss - rss,
+         ReadStatus("VmRSS:") - rss);
+}
+
+int main(int argc, char** argv) {
+  std::vector<size_t> counts;
+  bool sync = false;
+
+  for (int index = 1; index < argc; index++) {
+    if (!strcmp(argv[index], "--sync")) {
+      sync = true;
+    } else {
+      counts.push_back(strtoul(argv[index], nullptr, 10));
+    }
+  }
+
+  if (counts.empty()) {
+    counts = { 100, 500 };
+  }
+
+  Module::Init();
+
+  for (auto count : counts) {
+    Run(count, sync);
+  }
+
+  while (Module::DispatchEvents(false)) { }
+
+  Module::Dispose();
+  return 0;
+}
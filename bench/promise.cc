@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+
+#include "crtc.h"
+#include "promise.h"
+
+using namespace crtc;
+
+// Resolves N promises through the default loop and reports ns and heap allocations per operation, once with
+// Then/Catch continuations and once with a coroutine awaiting the same work.
+//
+//   crtc_bench_promise [iterations]
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  if (void* ptr = malloc(size ? size : 1)) {
+    return ptr;
+  }
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+static void Drain() {
+  while (Module::DispatchEvents(false)) { }
+}
+
+static void Report(const char* name, size_t iterations, Clock::time_point begin, uint64_t allocated) {
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+
+  printf("%-10s %8zu ops: %8.1f ns/op, %5.2f allocations/op\n",
+         name,
+         iterations,
+         ns / iterations,
+         static_cast<double>(allocated) / iterations);
+}
+
+static void RunPromise(size_t iterations) {
+  uint64_t sum = 0;
+  uint64_t allocated = allocations.load();
+  auto begin = Clock::now();
+
+  for (size_t index = 0; index < iterations; index++) {
+    Promise<int>::New([index](const Promise<int>::FullFilledCallback& resolve, const Promise<int>::RejectedCallback& reject) {
+      resolve(static_cast<int>(index));
+    })->Then([&sum](int value) {
+      sum += value;
+    })->Catch([](const std::shared_ptr<Error>& error) {
+      fprintf(stderr, "%s\n", error->Message().c_str());
+    });
+
+    Drain();
+  }
+
+  Report("promise", iterations, begin, allocations.load() - allocated);
+
+  if (sum != static_cast<uint64_t>(iterations) * (iterations - 1) / 2) {
+    fprintf(stderr, "promise: unexpected sum %llu\n", static_cast<unsigned long long>(sum));
+  }
+}
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+static Awaitable<int> Compute(int value) {
+  return Awaitable<int>([value](std::function<void(std::shared_ptr<Error>, int)> done) {
+    Promise<int>::New([value](const Promise<int>::FullFilledCallback& resolve, const Promise<int>::RejectedCallback& reject) {
+      resolve(value);
+    })->Then([done](int result) {
+      done(nullptr, result);
+    })->Catch([done](const std::shared_ptr<Error>& error) {
+      done(error, 0);
+    });
+  });
+}
+
+static Task Accumulate(int value, uint64_t* sum) {
+  auto result = co_await Compute(value);
+
+  if (!result.error) {
+    *sum += result.value;
+  }
+}
+
+static void RunCoroutine(size_t iterations) {
+  uint64_t sum = 0;
+  uint64_t allocated = allocations.load();
+  auto begin = Clock::now();
+
+  for (size_t index = 0; index < iterations; index++) {
+    Accumulate(static_cast<int>(index), &sum);
+    Drain();
+  }
+
+  Report("co_await", iterations, begin, allocations.load() - allocated);
+
+  if (sum != static_cast<uint64_t>(iterations) * (iterations - 1) / 2) {
+    fprintf(stderr, "co_await: unexpected sum %llu\n", static_cast<unsigned long long>(sum));
+  }
+}
+#endif
+
+int main(int argc, char** argv) {
+  size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+
+  Module::Init();
+
+  // Warm up so the loop's queue and thread locals are allocated before counting.
+  RunPromise(1000);
+  RunPromise(iterations);
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+  RunCoroutine(iterations);
+#endif
+
+  Drain();
+  Module::Dispose();
+  return 0;
+}
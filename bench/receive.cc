@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+
+#include "crtc.h"
+#include "arraybuffer.h"
+#include "eventloop.h"
+
+using namespace crtc;
+
+// Replays RTCDataChannel's receive path, wrapping a received buffer and posting it to onMessage on the default loop,
+// and reports ns and heap allocations per message once warmed up. Messages wrapped by the pool should report 0
+// allocations, make_shared one per message. The receive buffer itself belongs to webrtc and is not counted.
+//
+//   crtc_bench_receive [messages] [batch]
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  if (void* ptr = malloc(size ? size : 1)) {
+    return ptr;
+  }
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+static void Drain() {
+  while (Module::DispatchEvents(false)) { }
+}
+
+template <typename Wrap> static void Run(const char* name, size_t messages, size_t batch, Wrap wrap) {
+  auto loop = EventLoopInternal::Default();
+  rtc::CopyOnWriteBuffer payload(1024);
+  atomic_callback<std::shared_ptr<ArrayBuffer>, bool> onmessage;
+  uint64_t received = 0;
+
+  onmessage = [&received](std::shared_ptr<ArrayBuffer> data, bool binary) {
+    received += data->ByteLength() ? 1 : 0;
+  };
+
+  // One untimed round so the loop's nodes and the pool's blocks cover a batch.
+  for (size_t index = 0; index < batch; index++) {
+    Emit(loop, onmessage, wrap(payload), true);
+  }
+
+  Drain();
+  received = 0;
+
+  uint64_t allocated = allocations.load();
+  auto begin = Clock::now();
+
+  for (size_t done = 0; done < messages; done += batch) {
+    for (size_t index = 0; index < batch; index++) {
+      Emit(loop, onmessage, wrap(payload), true);
+    }
+
+    Drain();
+  }
+
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+  uint64_t total = allocations.load() - allocated;
+
+  printf("%-12s %9llu messages: %7.1f ns/message, %5.3f allocations/message\n",
+         name,
+         static_cast<unsigned long long>(received),
+         ns / received,
+         static_cast<double>(total) / received);
+}
+
+int main(int argc, char** argv) {
+  size_t messages = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+  size_t batch = argc > 2 ? strtoul(argv[2], nullptr, 10) : 256;
+
+  if (!batch) {
+    batch = 1;
+  }
+
+  Module::Init();
+
+  Run("make_shared", messages, batch, [](const rtc::CopyOnWriteBuffer& buffer) {
+    return std::shared_ptr<ArrayBuffer>(std::make_shared<WrapRtcBuffer>(buffer));
+  });
+
+  WrapRtcBufferPool pool(batch);
+
+  Run("pool", messages, batch, [&pool](const rtc::CopyOnWriteBuffer& buffer) {
+    return pool.Wrap(buffer);
+  });
+
+  printf("pool: %zu blocks allocated\n", pool.Allocated());
+
+  Drain();
+  Module::Dispose();
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "crtc.h"
+#include "loopback.h"
+
+using namespace crtc;
+
+// Moves bytes over a loopback data channel once per RTCConfiguration::sctp buffer size (send buffer and receive
+// window alike, 0 being webrtc's default) and reports MB/s next to the round trip time measured on the same channel.
+// Loopback has next to no delay, so the window hardly matters there; to see the bandwidth-delay product at work, add
+// delay to the interface first, e.g. on Linux:
+//
+//   tc qdisc add dev lo root netem delay 20ms     (remove with: tc qdisc del dev lo root)
+//
+//   crtc_bench_sctp [bytes] [size] [buffer...]
+
+typedef std::chrono::steady_clock Clock;
+
+static double RoundTrip(Loopback* pair, int count) {
+  std::vector<double> samples;
+  bool echoed = false;
+
+  pair->receiver->onMessage([pair](std::shared_ptr<ArrayBuffer> data, bool binary) {
+    pair->receiver->Send(data, binary);
+  });
+
+  pair->sender->onMessage([&echoed](std::shared_ptr<ArrayBuffer> data, bool binary) {
+    echoed = true;
+  });
+
+  for (int index = 0; index < count && !pair->error; index++) {
+    auto begin = Clock::now();
+
+    echoed = false;
+    pair->sender->Send(ArrayBuffer::New("ping"));
+
+    while (!echoed && !pair->error && Clock::now() - begin < std::chrono::seconds(5)) {
+      Pump(1);
+    }
+
+    if (!echoed) {
+      break;
+    }
+
+    samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+  }
+
+  pair->sender->onMessage(nullptr);
+  pair->receiver->onMessage(nullptr);
+
+  if (samples.empty()) {
+    return 0;
+  }
+
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+static bool Run(size_t bytes, size_t size, size_t buffer) {
+  RTCPeerConnection::RTCConfiguration config;
+  Loopback pair;
+
+  config.sctp.sendBufferSize = buffer;
+  config.sctp.receiveWindowSize = buffer;
+
+  if (!Open(&pair, RTCPeerConnection::RTCDataChannelInit(), 10000, config)) {
+    fprintf(stderr, "unable to open loopback data channel%s%s\n",
+            pair.error ? ": " : "",
+            pair.error ? pair.error->Message().c_str() : "");
+
+    Close(&pair);
+    return false;
+  }
+
+  double rtt = RoundTrip(&pair, 20);
+  size_t received = 0;
+
+  pair.receiver->onMessage([&received](std::shared_ptr<ArrayBuffer> data, bool binary) {
+    received += data->ByteLength();
+  });
+
+  std::shared_ptr<ArrayBuffer> payload = ArrayBuffer::New(size);
+  size_t limit = std::max<size_t>(buffer, 16 * 1024 * 1024);
+  size_t sent = 0;
+  auto begin = Clock::now();
+
+  memset(payload->Data(), 0x5a, size);
+
+  while (received < bytes && !pair.error && Clock::now() - begin < std::chrono::seconds(120)) {
+    // Kept above the SCTP send buffer, the window and not the application is what limits the rate.
+    while (sent < bytes && pair.sender->BufferedAmount() < limit) {
+      pair.sender->Send(payload);
+      sent += size;
+    }
+
+    Pump(1);
+  }
+
+  double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+  char label[32];
+
+  if (buffer) {
+    snprintf(label, sizeof(label), "%zu KiB", buffer / 1024);
+  }
+  else {
+    snprintf(label, sizeof(label), "default");
+  }
+
+  printf("%-10s %zu bytes in %zu byte messages: %.2f MB/s, rtt %.2f ms\n",
+         label,
+         received,
+         size,
+         received / elapsed / (1024 * 1024),
+         rtt);
+
+  pair.receiver->onMessage(nullptr);
+  Close(&pair);
+  return received >= bytes;
+}
+
+int main(int argc, char** argv) {
+  size_t bytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 256 * 1024 * 1024;
+  size_t size = argc > 2 ? strtoul(argv[2], nullptr, 10) : 64 * 1024;
+  std::vector<size_t> buffers;
+
+  for (int index = 3; index < argc; index++) {
+    buffers.push_back(strtoul(argv[index], nullptr, 10));
+  }
+
+  if (buffers.empty()) {
+    buffers = { 0, 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024 };
+  }
+
+  Module::Init();
+
+  bool ok = true;
+
+  for (size_t buffer : buffers) {
+    ok = Run(bytes, size, buffer) && ok;
+  }
+
+  Module::Dispose();
+  return ok ? 0 : 1;
+}
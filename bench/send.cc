@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "crtc.h"
+#include "loopback.h"
+
+using namespace crtc;
+
+// Pushes the same payload through a loopback data channel per message size: built in an ArrayBuffer::New() buffer,
+// which Send() copies into the transport buffer, in ArrayBuffer::NewZeroCopy(), which Send() queues as is, and the
+// same zero copy buffers handed to SendBatch() 64 at a time. Every path copies the payload into the buffer once per
+// message, like an application serializing into it.
+//
+//   crtc_bench_send [megabytes] [size...]
+//
+// Each run moves megabytes of payload, at most kMaxMessages messages.
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint64_t kHighWater = 4 * 1024 * 1024;
+static const size_t kBatch = 64;
+static const size_t kMaxMessages = 500000;
+
+static uint64_t receivedBytes = 0;
+static uint64_t receivedMessages = 0;
+
+// send(payload, remaining) sends up to remaining messages and returns how many it sent.
+template <typename Send> static void Run(Loopback* pair, const char* name, size_t size, size_t count, Send send) {
+  std::vector<uint8_t> payload(size, 0x5a);
+  Clock::duration sending = Clock::duration::zero();
+  size_t sent = 0;
+
+  receivedBytes = 0;
+  receivedMessages = 0;
+
+  auto begin = Clock::now();
+
+  while (receivedMessages < count && !pair->error && Clock::now() - begin < std::chrono::seconds(60)) {
+    while (sent < count && pair->sender->BufferedAmount() < kHighWater) {
+      auto start = Clock::now();
+
+      sent += send(payload, count - sent);
+      sending += Clock::now() - start;
+    }
+
+    Pump(1);
+  }
+
+  double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+  printf("%-9s %7zu bytes x %8zu: %8.1f MB/s, %9.0f msgs/s, build+send %7.2f us/msg%s\n",
+         name,
+         size,
+         count,
+         receivedBytes / seconds / (1024 * 1024),
+         receivedMessages / seconds,
+         std::chrono::duration<double, std::micro>(sending).count() / (sent ? sent : 1),
+         receivedMessages < count ? " (incomplete)" : "");
+}
+
+static std::shared_ptr<ArrayBuffer> Build(const std::vector<uint8_t>& payload) {
+  auto buffer = ArrayBuffer::NewZeroCopy(payload.size());
+
+  memcpy(buffer->Data(), payload.data(), payload.size());
+  return buffer;
+}
+
+int main(int argc, char** argv) {
+  size_t megabytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 256;
+  std::vector<size_t> sizes;
+
+  for (int index = 2; index < argc; index++) {
+    sizes.push_back(strtoul(argv[index], nullptr, 10));
+  }
+
+  if (sizes.empty()) {
+    sizes = { 64, 1024, 16 * 1024, 64 * 1024, 256 * 1024 };
+  }
+
+  Module::Init();
+
+  Loopback pair;
+
+  if (!Open(&pair)) {
+    fprintf(stderr, "unable to open loopback data channel%s%s\n",
+            pair.error ? ": " : "",
+            pair.error ? pair.error->Message().c_str() : "");
+
+    Close(&pair);
+    Module::Dispose();
+    return 1;
+  }
+
+  pair.receiver->onMessage([](std::shared_ptr<ArrayBuffer> data, bool binary) {
+    receivedBytes += data->ByteLength();
+    receivedMessages++;
+  });
+
+  pair.sender->onError([&pair](std::shared_ptr<Error> error) {
+    pair.error = error;
+  });
+
+  for (auto size : sizes) {
+    size_t count = (megabytes * 1024 * 1024) / (size ? size : 1);
+
+    count = count ? std::min(count, kMaxMessages) : 1;
+
+    Run(&pair, "copy", size, count, [&pair](const std::vector<uint8_t>& payload, size_t remaining) {
+      pair.sender->Send(ArrayBuffer::New(payload.data(), payload.size()));
+      return static_cast<size_t>(1);
+    });
+
+    Run(&pair, "zero-copy", size, count, [&pair](const std::vector<uint8_t>& payload, size_t remaining) {
+      pair.sender->Send(Build(payload));
+      return static_cast<size_t>(1);
+    });
+
+    Run(&pair, "batch", size, count, [&pair](const std::vector<uint8_t>& payload, size_t remaining) {
+      std::vector<std::shared_ptr<ArrayBuffer>> batch;
+
+      for (size_t index = 0; index < kBatch && index < remaining; index++) {
+        batch.push_back(Build(payload));
+      }
+
+      pair.sender->SendBatch(batch);
+      return batch.size();
+    });
+  }
+
+  if (pair.error) {
+    fprintf(stderr, "%s\n", pair.error->Message().c_str());
+  }
+
+  Close(&pair);
+  Module::Dispose();
+  return 0;
+}
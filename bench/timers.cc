@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <poll.h>
+#endif
+
+#include "crtc.h"
+
+using namespace crtc;
+
+// Keeps N timers outstanding on the default loop and reports the cost of inserting, cancelling and firing them.
+// Firing spreads the timers over one second, wakeups counts how often the loop's fd woke the dispatcher.
+//
+//   crtc_bench_timers [timers]
+
+typedef std::chrono::steady_clock Clock;
+
+static double Nanos(Clock::duration duration) {
+  return std::chrono::duration<double, std::nano>(duration).count();
+}
+
+static void WaitForEvents(int timeoutMs) {
+#if defined(__linux__)
+  struct pollfd fd = {};
+
+  fd.fd = Module::GetFd();
+  fd.events = POLLIN;
+
+  if (fd.fd >= 0) {
+    poll(&fd, 1, timeoutMs);
+    return;
+  }
+#endif
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+int main(int argc, char** argv) {
+  size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+  std::vector<AsyncHandle> handles(count);
+  std::mt19937 random(42);
+  size_t fired = 0;
+
+  Module::Init();
+
+  // Insert, timers between 10 s and 60 s so none of them fires during the run.
+  auto begin = Clock::now();
+
+  for (size_t index = 0; index < count; index++) {
+    handles[index] = SetTimeout([&fired]() {
+      fired++;
+    }, 10000 + static_cast<int>(random() % 50000));
+  }
+
+  double insert = Nanos(Clock::now() - begin);
+
+  // Cancel every timer through its handle.
+  size_t cancelled = 0;
+  begin = Clock::now();
+
+  for (auto& handle : handles) {
+    cancelled += ClearTimeout(handle) ? 1 : 0;
+  }
+
+  double cancel = Nanos(Clock::now() - begin);
+
+  // Fire, timers spread over 1..1000 ms.
+  for (size_t index = 0; index < count; index++) {
+    SetTimeout([&fired]() {
+      fired++;
+    }, 1 + static_cast<int>(random() % 1000));
+  }
+
+  size_t wakeups = 0;
+  Clock::duration dispatch = Clock::duration::zero();
+  begin = Clock::now();
+
+  while (fired < count && Clock::now() - begin < std::chrono::seconds(10)) {
+    WaitForEvents(100);
+
+    auto start = Clock::now();
+
+    Module::DispatchEvents(static_cast<size_t>(0), static_cast<int64_t>(0));
+    dispatch += Clock::now() - start;
+    wakeups++;
+  }
+
+  printf("%zu timers: insert %.1f ns/timer, cancel %.1f ns/timer (%zu cancelled), fire %.1f ns/timer over %zu wakeups (%zu fired)\n",
+         count,
+         insert / count,
+         cancel / count,
+         cancelled,
+         fired ? Nanos(dispatch) / fired : 0.0,
+         wakeups,
+         fired);
+
+  while (Module::DispatchEvents(false)) { }
+
+  Module::Dispose();
+  return 0;
+}
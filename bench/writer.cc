@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include "crtc.h"
+#include "loopback.h"
+
+using namespace crtc;
+
+// Streams chunks through an RTCDataChannelWriter over a loopback data channel for a fixed time. Prints the received
+// MB/s every second, then the average, the highest BufferedAmount() seen and the number of failed sends, which stays
+// 0 while the writer keeps the buffer between the water marks.
+//
+//   crtc_bench_writer [seconds] [chunk] [highWaterMark] [lowWaterMark]
+
+typedef std::chrono::steady_clock Clock;
+
+static uint64_t receivedBytes = 0;
+static uint64_t errors = 0;
+
+int main(int argc, char** argv) {
+  int seconds = argc > 1 ? atoi(argv[1]) : 10;
+  size_t chunk = argc > 2 ? strtoul(argv[2], nullptr, 10) : 64 * 1024;
+  RTCDataChannelWriter::Options options;
+
+  if (argc > 3) {
+    options.highWaterMark = strtoull(argv[3], nullptr, 10);
+  }
+
+  if (argc > 4) {
+    options.lowWaterMark = strtoull(argv[4], nullptr, 10);
+  }
+
+  Module::Init();
+
+  Loopback pair;
+
+  if (!Open(&pair)) {
+    fprintf(stderr, "unable to open loopback data channel%s%s\n",
+            pair.error ? ": " : "",
+            pair.error ? pair.error->Message().c_str() : "");
+
+    Close(&pair);
+    Module::Dispose();
+    return 1;
+  }
+
+  pair.receiver->onMessage([](std::shared_ptr<ArrayBuffer> data, bool binary) {
+    receivedBytes += data->ByteLength();
+  });
+
+  pair.sender->onError([](std::shared_ptr<Error> error) {
+    errors++;
+  });
+
+  auto writer = RTCDataChannelWriter::New(pair.sender, options);
+  auto payload = ArrayBuffer::NewZeroCopy(chunk);
+  bool waiting = false;
+  bool closed = false;
+  uint64_t peak = 0;
+
+  memset(payload->Data(), 0x5a, chunk);
+
+  auto begin = Clock::now();
+  auto report = begin + std::chrono::seconds(1);
+  uint64_t reported = 0;
+
+  while (!closed && Clock::now() - begin < std::chrono::seconds(seconds)) {
+    while (!waiting && !closed) {
+      if (writer->Write(payload)) {
+        continue;
+      }
+
+      waiting = true;
+      peak = std::max(peak, pair.sender->BufferedAmount());
+
+      writer->Ready([&waiting, &closed](std::shared_ptr<Error> error) {
+        waiting = false;
+        closed = error != nullptr;
+      });
+    }
+
+    Pump(1);
+
+    if (Clock::now() >= report) {
+      printf("%8.1f MB/s\n", (receivedBytes - reported) / (1024.0 * 1024.0));
+      reported = receivedBytes;
+      report += std::chrono::seconds(1);
+    }
+  }
+
+  double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+  printf("chunk %zu, marks %llu/%llu: %.1f MB/s average, peak buffered %llu bytes, %llu failed sends%s\n",
+         chunk,
+         static_cast<unsigned long long>(options.lowWaterMark),
+         static_cast<unsigned long long>(options.highWaterMark),
+         receivedBytes / elapsed / (1024 * 1024),
+         static_cast<unsigned long long>(peak),
+         static_cast<unsigned long long>(errors),
+         closed ? " (channel closed)" : "");
+
+  writer.reset();
+  Close(&pair);
+  Module::Dispose();
+  return 0;
+}
@@ -59,6 +59,15 @@ WebRTC uses Real-Time Protocol to transfer audio and video.
 #include <vector>
 #include <string>
 #include <functional>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <exception>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#endif
 
 namespace crtc {
 
@@ -143,36 +152,209 @@ namespace crtc {
 		static double Since(int64_t begin, int64_t end = Now()); // returns seconds
 	};
 
+	/// Queue of callbacks that is dispatched by the application thread calling DispatchEvents().
+	/// Default() is the loop behind Module::DispatchEvents(), additional loops let every application thread run its own
+	/// set of connections. Connections created with a loop deliver their callbacks (and those of their data channels and
+	/// tracks) to it instead of calling them on the webrtc thread that fired them.
+
+	class CRTC_EXPORT EventLoop {
+		EventLoop(const EventLoop&) = delete;
+		EventLoop& operator=(const EventLoop&) = delete;
+
+	public:
+		explicit EventLoop();
+		virtual ~EventLoop();
+
+		static std::shared_ptr<EventLoop> New();
+		static std::shared_ptr<EventLoop> Default();
+
+		virtual bool DispatchEvents(bool kForever = false) = 0;
+
+		/// Runs at most maxTasks ready callbacks or for at most maxMicros microseconds, 0 leaves that bound off.
+		/// Returns true when ready callbacks were left behind, GetFd() then stays readable.
+
+		virtual bool DispatchEvents(size_t maxTasks, int64_t maxMicros) = 0;
+
+		/// File descriptor that polls readable while callbacks are ready to run, -1 where it is not supported (non Linux).
+		/// It is meant for an existing epoll/poll loop that calls DispatchEvents(maxTasks, maxMicros) when it fires.
+
+		virtual int GetFd() const = 0;
+	};
+
+	/// Where an on* callback runs, passed along with the callback when it is registered. Inline() calls it on the webrtc
+	/// thread that fired it, Loop() posts it to an event loop and Pool() to a set of worker threads. With maxQueued set a
+	/// call that finds that many calls waiting is dropped and counted. Without an executor callbacks follow the owner:
+	/// its event loop when it is bound to one, inline otherwise.
+
+	class CRTC_EXPORT Executor {
+		Executor(const Executor&) = delete;
+		Executor& operator=(const Executor&) = delete;
+
+	public:
+		struct CRTC_EXPORT Stats {
+			uint64_t executed;   // calls started
+			uint64_t dropped;    // calls dropped because the queue was full
+			size_t queued;       // calls waiting right now
+			size_t peakQueued;   // highest number of waiting calls seen
+		};
+
+		explicit Executor();
+		virtual ~Executor();
+
+		static std::shared_ptr<Executor> Inline();
+		static std::shared_ptr<Executor> Loop(const std::shared_ptr<EventLoop>& loop = nullptr, size_t maxQueued = 0);
+		static std::shared_ptr<Executor> Pool(size_t threads, size_t maxQueued = 1024);
+
+		virtual Stats GetStats() const = 0;
+	};
+
+	/// Move-only callable for Async::Call. Callables up to kInlineSize bytes (a std::function, a lambda holding a few
+	/// pointers) are stored inline so handing them to a loop does not touch the heap, larger ones are boxed.
+
+	class AsyncTask {
+	public:
+		static constexpr size_t kInlineSize = 64;
+
+		AsyncTask() noexcept : _ops(nullptr) { }
+
+		template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, AsyncTask>::value>::type>
+		AsyncTask(F&& func) : _ops(nullptr) {
+			typedef typename std::decay<F>::type Callable;
+
+			if constexpr (std::is_constructible<bool, const Callable&>::value) {
+				if (!static_cast<bool>(func)) {
+					return;
+				}
+			}
+
+			if constexpr (IsInline<Callable>()) {
+				new (_storage) Callable(std::forward<F>(func));
+				_ops = &InlineOps<Callable>::ops;
+			}
+			else {
+				*reinterpret_cast<Callable**>(_storage) = new Callable(std::forward<F>(func));
+				_ops = &BoxedOps<Callable>::ops;
+			}
+		}
+
+		AsyncTask(AsyncTask&& other) noexcept : _ops(nullptr) {
+			*this = std::move(other);
+		}
+
+		AsyncTask& operator=(AsyncTask&& other) noexcept {
+			if (this != &other) {
+				Reset();
+
+				if (other._ops) {
+					other._ops->move(_storage, other._storage);
+					_ops = other._ops;
+					other._ops = nullptr;
+				}
+			}
+
+			return *this;
+		}
+
+		AsyncTask(const AsyncTask&) = delete;
+		AsyncTask& operator=(const AsyncTask&) = delete;
+
+		~AsyncTask() {
+			Reset();
+		}
+
+		void operator()() {
+			if (_ops) {
+				_ops->invoke(_storage);
+			}
+		}
+
+		explicit operator bool() const noexcept {
+			return _ops != nullptr;
+		}
+
+		void Reset() noexcept {
+			if (_ops) {
+				_ops->destroy(_storage);
+				_ops = nullptr;
+			}
+		}
+
+	private:
+		struct Ops {
+			void (*invoke)(void* storage);
+			void (*move)(void* to, void* from) noexcept;
+			void (*destroy)(void* storage) noexcept;
+		};
+
+		template <typename F> static constexpr bool IsInline() {
+			return sizeof(F) <= kInlineSize && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<F>::value;
+		}
+
+		template <typename F> struct InlineOps {
+			static void Invoke(void* storage) { (*static_cast<F*>(storage))(); }
+			static void Move(void* to, void* from) noexcept { new (to) F(std::move(*static_cast<F*>(from))); static_cast<F*>(from)->~F(); }
+			static void Destroy(void* storage) noexcept { static_cast<F*>(storage)->~F(); }
+			static constexpr Ops ops = { &Invoke, &Move, &Destroy };
+		};
+
+		template <typename F> struct BoxedOps {
+			static void Invoke(void* storage) { (**static_cast<F**>(storage))(); }
+			static void Move(void* to, void* from) noexcept { *static_cast<F**>(to) = *static_cast<F**>(from); }
+			static void Destroy(void* storage) noexcept { delete *static_cast<F**>(storage); }
+			static constexpr Ops ops = { &Invoke, &Move, &Destroy };
+		};
+
+		alignas(std::max_align_t) unsigned char _storage[kInlineSize];
+		const Ops* _ops;
+	};
+
+	/// Handle of a delayed Async::Call() or SetTimeout(). Cancel() drops the callback if it did not become due yet,
+	/// handles of callbacks that ran, were cancelled or whose loop is gone are ignored.
+
+	class CRTC_EXPORT AsyncHandle {
+	public:
+		AsyncHandle();
+		AsyncHandle(const std::weak_ptr<EventLoop>& loop, uint64_t id);
+
+		bool Cancel();
+
+	private:
+		std::weak_ptr<EventLoop> _loop;
+		uint64_t _id;
+	};
+
 	class CRTC_EXPORT Async {
 		explicit Async() = delete;
 		Async(const Async&) = delete;
 		Async& operator=(const Async&) = delete;
 	public:
-		static void Call(std::function<void()> callback, int delayMs = 0);
+		/// Without a loop the callback goes to the loop dispatching on the calling thread, or to EventLoop::Default().
+		/// Loops recycle their task nodes, a callback that fits AsyncTask inline is queued without allocating.
+		/// Delayed callbacks go to the loop's timer wheel (millisecond ticks) and return a handle that cancels them.
+
+		static AsyncHandle Call(AsyncTask callback, int delayMs = 0, const std::shared_ptr<EventLoop>& loop = nullptr);
 	};
 
 	/// \sa https://developer.mozilla.org/en/docs/Web/API/Window/SetImmediate
 
 	template <typename F, typename... Args> static inline void SetImmediate(F&& func, Args... args) {
-		std::function<void(Args...)> callback(func);
-
-		Async::Call(Callback([=]() {
-			callback(args...);
-			}, [=]() {
-				callback(args...);
-				}));
+		Async::Call([func = std::forward<F>(func), args...]() mutable {
+			func(args...);
+		});
 	}
 
 	/// \sa https://developer.mozilla.org/en-US/docs/Web/API/WindowTimers/setTimeout
 
-	template <typename F, typename... Args> static inline void SetTimeout(F&& func, int delay, Args... args) {
-		std::function<void(Args... args)> callback(func);
+	template <typename F, typename... Args> static inline AsyncHandle SetTimeout(F&& func, int delay, Args... args) {
+		return Async::Call([func = std::forward<F>(func), args...]() mutable {
+			func(args...);
+		}, (delay > 0) ? delay : 0);
+	}
+
+	/// \sa https://developer.mozilla.org/en-US/docs/Web/API/clearTimeout
 
-		Async::Call(Callback([=]() {
-			callback(args...);
-			}, [=]() {
-				callback(args...);
-				}), (delay > 0) ? delay : 0);
+	static inline bool ClearTimeout(AsyncHandle& handle) {
+		return handle.Cancel();
 	}
 
 	/// \sa https://developer.mozilla.org/en/docs/Web/JavaScript/Reference/Global_Objects/Error
@@ -205,6 +387,17 @@ namespace crtc {
 		static std::shared_ptr<ArrayBuffer> New(const String& data);
 		static std::shared_ptr<ArrayBuffer> New(const uint8_t* data, size_t byteLength = 0);
 
+		/// Zero filled buffer that RTCDataChannel::Send() hands to the transport without copying it, received messages use
+		/// the same kind of buffer. Data() copies the bytes first when a send still holds them, so a pointer taken from
+		/// Data() before the Send() must not be written through afterwards.
+
+		static std::shared_ptr<ArrayBuffer> NewZeroCopy(size_t byteLength);
+
+		/// Wraps data without copying it, deleter(data) runs once the last reference is gone. Without a deleter data
+		/// has to outlive the buffer.
+
+		static std::shared_ptr<ArrayBuffer> Adopt(uint8_t* data, size_t byteLength, std::function<void(uint8_t*)> deleter = nullptr);
+
 		virtual size_t ByteLength() const = 0;
 
 		virtual std::shared_ptr<ArrayBuffer> Slice(size_t begin = 0, size_t end = 0) const = 0;
@@ -376,6 +569,8 @@ namespace crtc {
 	public:
 		static void Init();
 		static bool DispatchEvents(bool kForever = false);
+		static bool DispatchEvents(size_t maxTasks, int64_t maxMicros);
+		static int GetFd();
 		static void Dispose();
 		static void RegisterAsyncCallback(const std::function<void()>& callback);
 		static void UnregisterAsyncCallback();
@@ -427,13 +622,13 @@ namespace crtc {
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/MediaStreamTrack/clone
 
-		virtual void onStarted(std::function<void()> callback) = 0;
-		virtual void onEnded(std::function<void()> callback) = 0;
-		virtual void onMute(std::function<void()> callback) = 0;
-		virtual void onUnmute(std::function<void()> callback) = 0;
-		virtual void onAudio(std::function<void(const void*, int, int, size_t, size_t)> callback) = 0;
-		virtual void onVideo(std::function<void(std::shared_ptr<VideoFrame>)> callback) = 0;
-		virtual void onFrameDrop(std::function<void()> callback) = 0;
+		virtual void onStarted(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onEnded(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onMute(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onUnmute(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onAudio(std::function<void(const void*, int, int, size_t, size_t)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onVideo(std::function<void(std::shared_ptr<VideoFrame>)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onFrameDrop(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
 	};
 
 	typedef std::vector<std::shared_ptr<MediaStreamTrack>> MediaStreamTracks;
@@ -565,6 +760,39 @@ namespace crtc {
 			kClosed
 		};
 
+		/// Receive high water mark a channel starts with, see Pause().
+
+		static constexpr uint64_t kDefaultReceiveHighWaterMark = 16 * 1024 * 1024;
+
+		/// One piece of a message passed to Send(fragments).
+
+		struct CRTC_EXPORT Fragment {
+			const unsigned char* data;
+			size_t length;
+		};
+
+		/// Framed mode, turned on with SetFramed() at both ends of a reliable channel. Every message goes out as chunks of
+		/// at most chunkSize bytes behind a 24 byte header, queued only while the channel buffers less than highWaterMark,
+		/// so a large Send() never sits in the transport at once. Received chunks are reassembled for onMessage while
+		/// incomplete messages hold at most maxReassembly bytes, a message that does not fit is dropped with onError.
+		/// A message that got no chunk for reassemblyTimeout milliseconds (0 never) is dropped too, chunks lost on an
+		/// unreliable channel would hold the space otherwise. With onChunk set chunks are handed out as they arrive
+		/// instead and nothing is held.
+
+		struct CRTC_EXPORT FramedOptions {
+			FramedOptions() :
+				chunkSize(64 * 1024),
+				highWaterMark(1024 * 1024),
+				maxReassembly(64 * 1024 * 1024),
+				reassemblyTimeout(30000)
+			{ }
+
+			size_t chunkSize;
+			uint64_t highWaterMark;
+			uint64_t maxReassembly;
+			int reassemblyTimeout;
+		};
+
 		explicit RTCDataChannel();
 		virtual ~RTCDataChannel();
 
@@ -581,10 +809,28 @@ namespace crtc {
 		virtual uint64_t BufferedAmount() = 0;
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCDataChannel/bufferedAmountLowThreshold
+		/// onBufferedAmountLow fires whenever BufferedAmount() falls from above the threshold to at or below it.
 
 		virtual uint64_t BufferedAmountLowThreshold() = 0;
 		virtual void SetBufferedAmountLowThreshold(uint64_t threshold = 0) = 0;
 
+		/// Receive side flow control. While the channel is paused messages for onMessage and onChunk wait in its
+		/// receive queue, Resume() delivers them in order (on the loop, without one on the calling thread).
+		/// ReceivedAmount() counts the bytes waiting plus the ones whose callback has not returned yet (or was not
+		/// handed to its executor yet). webrtc keeps reading from the SCTP association either way, so the queue can not
+		/// slow the sender down by itself: a message that would take ReceivedAmount() above the receive high water mark
+		/// is dropped, onError fires and the channel closes, failing the sender's sends instead of growing without
+		/// bound. The mark defaults to kDefaultReceiveHighWaterMark (16 MiB), 0 lets a paused channel queue without
+		/// limit. The queue is used from the first Pause() or SetReceiveHighWaterMark() on, before that messages are
+		/// emitted as they arrive. Messages taken by ReceiveFile() do not go through it.
+
+		virtual void Pause() = 0;
+		virtual void Resume() = 0;
+		virtual bool Paused() = 0;
+		virtual uint64_t ReceivedAmount() = 0;
+		virtual uint64_t ReceiveHighWaterMark() = 0;
+		virtual void SetReceiveHighWaterMark(uint64_t highWaterMark = kDefaultReceiveHighWaterMark) = 0;
+
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCDataChannel/maxPacketLifeTime
 
 		virtual uint16_t MaxPacketLifeTime() = 0;
@@ -615,15 +861,270 @@ namespace crtc {
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCDataChannel/send
 
+		/// Does not block: the message is handed to the network thread and failures are reported through onError.
+		/// BufferedAmount() counts it from the moment Send() returns. Buffers from ArrayBuffer::NewZeroCopy(), received
+		/// messages and their slices are queued without a copy, any other buffer is copied once.
+
 		virtual void Send(const std::shared_ptr<ArrayBuffer>& data, bool binary = true) = 0;
 
 		virtual void Send(const unsigned char* data, size_t length, bool binary = true) = 0;
 
-		virtual void onBufferedAmountLow(std::function<void()> callback) = 0;
-		virtual void onOpen(std::function<void()> callback) = 0;
-		virtual void onClose(std::function<void()> callback) = 0;
-		virtual void onMessage(std::function<void(std::shared_ptr<ArrayBuffer>, bool)> callback) = 0;
-		virtual void onError(std::function<void(std::shared_ptr<Error>)> callback) = 0;
+		/// Sends the fragments as a single message, they are gathered straight into the transport buffer.
+
+		virtual void Send(const std::vector<Fragment>& fragments, bool binary = true) = 0;
+
+		/// Sends every buffer as its own message with one hop to the network thread for the whole batch, the messages
+		/// are queued there back to back and in order with the ones from Send().
+
+		virtual void SendBatch(const std::vector<std::shared_ptr<ArrayBuffer>>& buffers, bool binary = true) = 0;
+
+		enum BroadcastResult {
+			kBroadcastSent,
+			kBroadcastBuffered,
+			kBroadcastClosed,
+		};
+
+		/// Sends data to every channel from one shared buffer, an ArrayBuffer::NewZeroCopy() buffer is not copied at all.
+		/// Channels that are not open are skipped with kBroadcastClosed, with maxBufferedAmount set the ones that buffer
+		/// at least that much with kBroadcastBuffered. The check uses the amount each channel saw last plus what was sent
+		/// since, no channel is asked for its state. Results are in the order of channels.
+
+		static std::vector<BroadcastResult> Broadcast(const std::shared_ptr<ArrayBuffer>& data, const std::vector<std::shared_ptr<RTCDataChannel>>& channels, bool binary = true, uint64_t maxBufferedAmount = 0);
+
+		/// Counters of a channel opened with RTCDataChannelInit::compression. The compression ratio is bytesIn / bytesOut,
+		/// the times are CPU time spent in zlib on the worker threads.
+
+		struct CRTC_EXPORT CompressionStats {
+			CompressionStats() :
+				messagesSent(0),
+				messagesCompressed(0),
+				bytesIn(0),
+				bytesOut(0),
+				messagesReceived(0),
+				bytesReceived(0),
+				bytesInflated(0),
+				compressMicros(0),
+				decompressMicros(0)
+			{ }
+
+			uint64_t messagesSent;
+			uint64_t messagesCompressed;
+			uint64_t bytesIn;
+			uint64_t bytesOut;
+			uint64_t messagesReceived;
+			uint64_t bytesReceived;
+			uint64_t bytesInflated;
+			uint64_t compressMicros;
+			uint64_t decompressMicros;
+		};
+
+		/// Counters of a channel opened with RTCDataChannelInit::coalescing, messages per wire message is the bundling
+		/// ratio. A bundle is lost or expires as a whole on channels that are not reliable.
+
+		struct CRTC_EXPORT CoalescingStats {
+			CoalescingStats() :
+				messagesSent(0),
+				wireMessagesSent(0),
+				messagesReceived(0),
+				wireMessagesReceived(0)
+			{ }
+
+			uint64_t messagesSent;
+			uint64_t wireMessagesSent;
+			uint64_t messagesReceived;
+			uint64_t wireMessagesReceived;
+		};
+
+		/// True when the channel was negotiated with coalescing, by either end.
+
+		virtual bool Coalesced() = 0;
+		virtual CoalescingStats GetCoalescingStats() = 0;
+
+		/// True when the channel was negotiated with compression, by either end.
+
+		virtual bool Compressed() = 0;
+		virtual CompressionStats GetCompressionStats() = 0;
+
+		/// Turns framed mode on or off, see FramedOptions. Set it before the first message in either direction. While a
+		/// framed message is sent its ArrayBuffer is read chunk by chunk, only ArrayBuffer::NewZeroCopy() buffers may be
+		/// written to after Send(). BufferedAmount() includes the bytes that are not chunked yet.
+
+		virtual void SetFramed(bool framed, const FramedOptions& options = FramedOptions()) = 0;
+		virtual bool Framed() = 0;
+
+		/// Part of a file to send with SendFile(), length 0 sends everything from offset to the end of the file.
+		/// ReceiveFile() only uses maxSize: a message announcing more bytes fails the receive before any file is created.
+
+		struct CRTC_EXPORT FileOptions {
+			FileOptions() :
+				offset(0),
+				length(0),
+				maxSize(4ULL * 1024 * 1024 * 1024),
+				binary(true)
+			{ }
+
+			uint64_t offset;
+			uint64_t length;
+			uint64_t maxSize;
+			bool binary;
+		};
+
+		/// Sends a file as one framed message, framed mode has to be on. The file is memory mapped and chunks are copied
+		/// from the mapping straight into the transport buffer as the channel drains below the high water mark, so it
+		/// is never read whole. progress(sent, total) follows every chunk handed to the transport, callback runs once:
+		/// with nullptr after the last chunk, with an error when the file can not be read or the channel closes first.
+		/// Both run on the channel's loop. The file must not be truncated while it is sent.
+
+		virtual void SendFile(const String& path, const FileOptions& options = FileOptions(), std::function<void(std::shared_ptr<Error>)> callback = nullptr, std::function<void(uint64_t sent, uint64_t total)> progress = nullptr) = 0;
+
+		/// Writes the next framed message that starts arriving to path instead of handing it to onMessage or onChunk.
+		/// The file is created (or truncated) at the message's size, mapped and every chunk is copied into place as it is
+		/// received, nothing is reassembled in memory. Calls queue up, one file per message in the order the messages
+		/// start. progress(received, total) and callback work as for SendFile(), callback also receives an error when the
+		/// message is larger than options.maxSize or the disk can not hold it.
+
+		virtual void ReceiveFile(const String& path, const FileOptions& options = FileOptions(), std::function<void(std::shared_ptr<Error>)> callback = nullptr, std::function<void(uint64_t received, uint64_t total)> progress = nullptr) = 0;
+
+		virtual void onBufferedAmountLow(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onOpen(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onClose(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+
+		/// Received ArrayBuffers share webrtc's buffer and come from a per channel pool, delivered on the loop a message
+		/// costs no heap allocation once warmed up as long as the callback fits std::function's inline storage.
+
+		virtual void onMessage(std::function<void(std::shared_ptr<ArrayBuffer>, bool)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+
+		/// Framed mode only, receives every chunk of a message at its offset in a message of length bytes, in arrival order.
+
+		virtual void onChunk(std::function<void(std::shared_ptr<ArrayBuffer> chunk, uint64_t offset, uint64_t length, bool binary)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onError(std::function<void(std::shared_ptr<Error>)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+	};
+
+	/// Flow control for one RTCDataChannel. Write() sends right away and returns whether the channel still buffers less
+	/// than highWaterMark. A writer that stops on false and continues from Ready() keeps the channel busy while its
+	/// buffer stays between lowWaterMark and highWaterMark, well below the point where SCTP rejects sends.
+	/// A channel has at most one writer, a new one replaces the previous.
+
+	class CRTC_EXPORT RTCDataChannelWriter {
+		RTCDataChannelWriter(const RTCDataChannelWriter&) = delete;
+		RTCDataChannelWriter& operator=(const RTCDataChannelWriter&) = delete;
+
+	public:
+		struct CRTC_EXPORT Options {
+			Options() :
+				highWaterMark(4 * 1024 * 1024),
+				lowWaterMark(1024 * 1024)
+			{ }
+
+			uint64_t highWaterMark;
+			uint64_t lowWaterMark;
+		};
+
+		explicit RTCDataChannelWriter();
+		virtual ~RTCDataChannelWriter();
+
+		static std::shared_ptr<RTCDataChannelWriter> New(const std::shared_ptr<RTCDataChannel>& channel, const Options& options = Options());
+
+		virtual std::shared_ptr<RTCDataChannel> Channel() const = 0;
+
+		/// True while the channel buffers less than highWaterMark.
+
+		virtual bool Writable() = 0;
+
+		/// Sends data (a batch with RTCDataChannel::SendBatch()) and returns Writable(). Data written after a false return
+		/// is still sent, the marks only bound a writer that waits for Ready().
+
+		virtual bool Write(const std::shared_ptr<ArrayBuffer>& data, bool binary = true) = 0;
+		virtual bool Write(const std::vector<std::shared_ptr<ArrayBuffer>>& buffers, bool binary = true) = 0;
+
+		/// callback runs once with nullptr when the writer may continue: right away while Writable(), otherwise once the
+		/// channel drained to lowWaterMark. It receives an error when the channel closes first. It runs on the channel's
+		/// loop, inline on the webrtc thread without one.
+
+		virtual void Ready(std::function<void(std::shared_ptr<Error>)> callback) = 0;
+	};
+
+	/// Logical streams over one RTCDataChannel, for traffic that would otherwise need a channel per entity. Every
+	/// message carries its 4 byte stream id, both ends need a mux on the channel and the mux takes over its onMessage
+	/// and flow control, so a channel has either a mux or an RTCDataChannelWriter.
+	///
+	/// Writes are queued per stream and handed to the channel while it buffers less than highWaterMark: streams with
+	/// a higher priority go first, streams of equal priority share the channel by weight. Keeping the channel's own
+	/// buffer short is what lets an urgent stream overtake bulk transfers queued before it.
+	///
+	/// Streams the remote end writes to are only opened while onStream is set and fewer than maxStreams are open,
+	/// messages for other unknown ids are dropped.
+
+	class CRTC_EXPORT RTCDataChannelMux {
+		RTCDataChannelMux(const RTCDataChannelMux&) = delete;
+		RTCDataChannelMux& operator=(const RTCDataChannelMux&) = delete;
+
+	public:
+		struct CRTC_EXPORT Options {
+			Options() :
+				highWaterMark(256 * 1024),
+				streamHighWaterMark(1024 * 1024),
+				streamLowWaterMark(256 * 1024),
+				maxStreams(1024)
+			{ }
+
+			uint64_t highWaterMark;
+			uint64_t streamHighWaterMark;
+			uint64_t streamLowWaterMark;
+			size_t maxStreams;
+		};
+
+		class CRTC_EXPORT Stream {
+			Stream(const Stream&) = delete;
+			Stream& operator=(const Stream&) = delete;
+
+		public:
+			explicit Stream();
+			virtual ~Stream();
+
+			virtual uint32_t Id() const = 0;
+			virtual int Priority() = 0;
+			virtual uint32_t Weight() = 0;
+			virtual void SetPriority(int priority, uint32_t weight = 1) = 0;
+
+			/// Bytes written to this stream that the mux has not handed to the channel yet.
+
+			virtual uint64_t BufferedAmount() = 0;
+
+			/// Queues data and returns whether the stream buffers less than streamHighWaterMark. Data written after a
+			/// false return is still sent, the mark only bounds a writer that waits for Ready().
+
+			virtual bool Write(const std::shared_ptr<ArrayBuffer>& data, bool binary = true) = 0;
+
+			/// callback runs once with nullptr when the stream may continue: right away while it buffers less than
+			/// streamHighWaterMark, otherwise once it drained to streamLowWaterMark. It receives an error when the stream
+			/// or the channel closes first. It runs on the channel's loop.
+
+			virtual void Ready(std::function<void(std::shared_ptr<Error>)> callback) = 0;
+
+			/// Drops queued writes and removes the stream from the mux. Messages that still arrive for its id are dropped
+			/// until CreateStream() opens it again.
+
+			virtual void Close() = 0;
+
+			virtual void onMessage(std::function<void(std::shared_ptr<ArrayBuffer>, bool)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		};
+
+		explicit RTCDataChannelMux();
+		virtual ~RTCDataChannelMux();
+
+		static std::shared_ptr<RTCDataChannelMux> New(const std::shared_ptr<RTCDataChannel>& channel, const Options& options = Options());
+
+		virtual std::shared_ptr<RTCDataChannel> Channel() const = 0;
+
+		/// Returns the stream with id, opening it with priority and weight when the mux does not know it yet.
+
+		virtual std::shared_ptr<Stream> CreateStream(uint32_t id, int priority = 0, uint32_t weight = 1) = 0;
+
+		/// Called for streams the remote end opened, on the channel's loop right before their first message is delivered,
+		/// so a stream's onMessage can be set here.
+
+		virtual void onStream(std::function<void(std::shared_ptr<Stream>)> callback) = 0;
 	};
 
 	/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCPeerConnection
@@ -634,6 +1135,11 @@ namespace crtc {
 
 	public:
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCPeerConnection/createDataChannel#RTCDataChannelInit_dictionary
+		///
+		/// compression deflates every message of at least compressionThreshold bytes with zlib at compressionLevel. It is
+		/// announced in the channel's protocol, so the remote end inflates and compresses its own messages with the
+		/// defaults, both ends of a negotiated channel have to ask for it. Compression runs on a shared worker pool in
+		/// message order, RTCDataChannel::Protocol() does not show the marker.
 
 		struct CRTC_EXPORT RTCDataChannelInit {
 			RTCDataChannelInit() :
@@ -642,7 +1148,13 @@ namespace crtc {
 				maxRetransmits(-1),
 				ordered(true),
 				negotiated(false),
-				protocol()
+				protocol(),
+				compression(false),
+				compressionThreshold(1024),
+				compressionLevel(6),
+				coalescing(false),
+				coalescingDelay(1),
+				coalescingMaxSize(16 * 1024)
 			{ }
 
 			int id;
@@ -651,6 +1163,17 @@ namespace crtc {
 			bool ordered;
 			bool negotiated;
 			String protocol;
+			bool compression;
+			size_t compressionThreshold;
+			int compressionLevel;
+
+			/// Bundles small messages into one SCTP message, split again before the remote onMessage, see
+			/// RTCDataChannel::CoalescingStats. A message waits at most coalescingDelay milliseconds (0 only waits for
+			/// the network thread's next turn) or until coalescingMaxSize bytes are pending. Both ends have to be
+			/// libcrtc, the remote end learns about it through the channel's protocol like with compression.
+			bool coalescing;
+			int coalescingDelay;
+			size_t coalescingMaxSize;
 		};
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCSessionDescription
@@ -738,6 +1261,28 @@ namespace crtc {
 			std::vector<String> urls;
 		};
 
+		/// SCTP settings for the connection's data channels, 0 keeps webrtc's default. A channel moves at most one send
+		/// buffer or receive window per round trip, so throughput over a long fat path is capped at the smaller of the
+		/// two divided by the round trip time: size both to the bandwidth-delay product. maxMessageSize is the largest
+		/// message the SCTP socket sends, the SDP keeps announcing webrtc's default, so only raise it when the remote end
+		/// is configured the same. The stream counts are announced at association setup and bound the channel ids.
+
+		struct CRTC_EXPORT RTCSctpTransportOptions {
+			RTCSctpTransportOptions() :
+				sendBufferSize(0),
+				receiveWindowSize(0),
+				maxMessageSize(0),
+				maxOutboundStreams(0),
+				maxInboundStreams(0)
+			{ }
+
+			size_t sendBufferSize;
+			size_t receiveWindowSize;
+			size_t maxMessageSize;
+			uint16_t maxOutboundStreams;
+			uint16_t maxInboundStreams;
+		};
+
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCConfiguration
 
 		struct CRTC_EXPORT RTCConfiguration {
@@ -749,6 +1294,7 @@ namespace crtc {
 			std::vector<RTCIceServer> iceServers;
 			RTCIceTransportPolicy iceTransportPolicy;
 			RTCRtcpMuxPolicy rtcpMuxPolicy;
+			RTCSctpTransportOptions sctp;
 		};
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCPeerConnection/createOffer#RTCOfferOptions_dictionary
@@ -772,25 +1318,38 @@ namespace crtc {
 		explicit RTCPeerConnection();
 		virtual ~RTCPeerConnection();
 
-		static std::shared_ptr<RTCPeerConnection> New(const RTCConfiguration& config = RTCConfiguration());
+		/// With a loop every callback of the connection, its data channels and tracks is delivered by loop->DispatchEvents(),
+		/// without one callbacks run on the webrtc thread that raised them.
+
+		static std::shared_ptr<RTCPeerConnection> New(const RTCConfiguration& config = RTCConfiguration(), const std::shared_ptr<EventLoop>& loop = nullptr);
 
 		virtual std::shared_ptr<RTCDataChannel> CreateDataChannel(const String& label, const RTCDataChannelInit& options = RTCDataChannelInit()) = 0;
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCPeerConnection/addIceCandidate
 
-		virtual void AddIceCandidate(const RTCIceCandidate& candidate) = 0;
+		/// Does not block, callback runs on the connection's loop with nullptr on success. Candidates that arrive before the
+		/// remote description are queued and applied once it is set.
+
+		virtual void AddIceCandidate(const RTCIceCandidate& candidate, std::function<void(std::shared_ptr<Error>)> callback = nullptr) = 0;
+
+		/// Parses and applies a whole trickle batch with a single hop to the signaling thread.
+		/// callback receives one entry per candidate, nullptr for the ones that were applied.
+
+		virtual void AddIceCandidates(const std::vector<RTCIceCandidate>& candidates, std::function<void(std::vector<std::shared_ptr<Error>>)> callback = nullptr) = 0;
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCPeerConnection/addStream
 
 		virtual void AddStream(const std::shared_ptr<MediaStream>& stream) = 0;
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCPeerConnection/createAnswer
+		/// callback and onerror run on the connection's loop.
 
-		virtual void CreateAnswer(std::function<void(RTCPeerConnection::RTCSessionDescription*)> callback, const RTCAnswerOptions& options = RTCAnswerOptions()) = 0;
+		virtual void CreateAnswer(std::function<void(RTCPeerConnection::RTCSessionDescription*)> callback, const RTCAnswerOptions& options = RTCAnswerOptions(), std::function<void(std::shared_ptr<Error>)> onerror = nullptr) = 0;
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCPeerConnection/createOffer
+		/// callback and onerror run on the connection's loop.
 
-		virtual void CreateOffer(std::function<void(RTCPeerConnection::RTCSessionDescription*)> callback, const RTCOfferOptions& options = RTCOfferOptions()) = 0;
+		virtual void CreateOffer(std::function<void(RTCPeerConnection::RTCSessionDescription*)> callback, const RTCOfferOptions& options = RTCOfferOptions(), std::function<void(std::shared_ptr<Error>)> onerror = nullptr) = 0;
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCPeerConnection/getLocalStreams
 
@@ -809,17 +1368,25 @@ namespace crtc {
 		//virtual bool SetConfiguration(const RTCConfiguration& config) = 0;
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCPeerConnection/setLocalDescription
+		/// callback receives nullptr once the description is applied, the error otherwise.
 
-		virtual void SetLocalDescription(std::shared_ptr<const RTCSessionDescription> sdp) = 0;
+		virtual void SetLocalDescription(std::shared_ptr<const RTCSessionDescription> sdp, std::function<void(std::shared_ptr<Error>)> callback = nullptr) = 0;
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCPeerConnection/setRemoteDescription
+		/// callback receives nullptr once the description is applied, the error otherwise.
 
-		virtual void SetRemoteDescription(std::shared_ptr<const RTCSessionDescription> sdp) = 0;
+		virtual void SetRemoteDescription(std::shared_ptr<const RTCSessionDescription> sdp, std::function<void(std::shared_ptr<Error>)> callback = nullptr) = 0;
 
 		/// \sa https://developer.mozilla.org/en-US/docs/Web/API/RTCPeerConnection/close
 
 		virtual void Close() = 0;
 
+		/// Closes the connection without blocking the caller. Transports, decoders and the webrtc factory are released on a
+		/// background thread, callback runs on the connection's loop once they are gone. The connection stays alive until then.
+		/// Only the first call does anything, afterwards the connection reports itself closed and its methods do nothing.
+
+		virtual void CloseAsync(std::function<void()> callback = nullptr) = 0;
+
 		virtual RTCSessionDescription CurrentLocalDescription() = 0;
 		virtual RTCSessionDescription CurrentRemoteDescription() = 0;
 		virtual RTCSessionDescription LocalDescription() = 0;
@@ -834,20 +1401,236 @@ namespace crtc {
 		virtual bool BypassVideoDecoder() = 0;
 		virtual bool BypassAudioDecoder() = 0;
 
-		virtual void onRawVideo(std::function<void(const unsigned char* data, size_t length, bool isKeyFrame, int64_t renderTimeMs)> callback) = 0;
-		virtual void onRawAudio(std::function<void(const unsigned char* data, size_t length)> callback) = 0;
-		virtual void onAddTrack(std::function<void(const std::shared_ptr<MediaStreamTrack>)> callback) = 0;
-		virtual void onRemoveTrack(std::function<void(const std::shared_ptr<MediaStreamTrack>)> callback) = 0;
-		virtual void onAddStream(std::function<void(const std::shared_ptr<MediaStream>)> callback) = 0;
-		virtual void onRemoveStream(std::function<void(const std::shared_ptr<MediaStream>)> callback) = 0;
-		virtual void onDataChannel(std::function<void(const std::shared_ptr<RTCDataChannel>)> callback) = 0;
-		virtual void onIceCandidate(std::function<void(const std::shared_ptr<RTCIceCandidate>)> callback) = 0;
-		virtual void onNegotiationNeeded(std::function<void()> callback) = 0;
-		virtual void onsignalingstatechange(std::function<void()> callback) = 0;
-		virtual void onIceGatheringStateChange(std::function<void()> callback) = 0;
-		virtual void onIceConnectionStateChange(std::function<void()> callback) = 0;
-		virtual void onIceCandidatesRemoved(std::function<void()> callback) = 0;
+		virtual void onRawVideo(std::function<void(const unsigned char* data, size_t length, bool isKeyFrame, int64_t renderTimeMs)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onRawAudio(std::function<void(const unsigned char* data, size_t length)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onAddTrack(std::function<void(const std::shared_ptr<MediaStreamTrack>)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onRemoveTrack(std::function<void(const std::shared_ptr<MediaStreamTrack>)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onAddStream(std::function<void(const std::shared_ptr<MediaStream>)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onRemoveStream(std::function<void(const std::shared_ptr<MediaStream>)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onDataChannel(std::function<void(const std::shared_ptr<RTCDataChannel>)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onIceCandidate(std::function<void(const std::shared_ptr<RTCIceCandidate>)> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onNegotiationNeeded(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onsignalingstatechange(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onIceGatheringStateChange(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onIceConnectionStateChange(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+		virtual void onIceCandidatesRemoved(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) = 0;
+	};
+
+	/// Owns the network, worker and signaling threads shared by every RTCPeerConnection created through it.
+	/// RTCPeerConnection::New() uses the process-wide Default() instance.
+	///
+	/// With Options::shards > 1 the factory runs that many network/worker thread pairs and places each
+	/// new connection on one of them, so packet processing of different connections can use different cores.
+
+	class CRTC_EXPORT RTCPeerConnectionFactory {
+		RTCPeerConnectionFactory(const RTCPeerConnectionFactory&) = delete;
+		RTCPeerConnectionFactory& operator=(const RTCPeerConnectionFactory&) = delete;
+
+	public:
+		enum Placement {
+			kRoundRobin,
+			kLeastLoaded,
+		};
+
+		struct CRTC_EXPORT Options {
+			Options() :
+				shards(1),
+				placement(kRoundRobin)
+			{ }
+
+			size_t shards;
+			Placement placement;
+		};
+
+		struct CRTC_EXPORT ShardStats {
+			size_t connections;     // connections currently placed on the shard
+			uint64_t placed;        // connections placed on the shard since it was started
+			uint64_t networkTasks;  // tasks posted to the shard network thread
+			uint64_t workerTasks;   // tasks posted to the shard worker thread
+		};
+
+		explicit RTCPeerConnectionFactory();
+		virtual ~RTCPeerConnectionFactory();
+
+		static std::shared_ptr<RTCPeerConnectionFactory> New(const Options& options = Options());
+		static std::shared_ptr<RTCPeerConnectionFactory> Default();
+
+		virtual std::shared_ptr<RTCPeerConnection> CreatePeerConnection(const RTCPeerConnection::RTCConfiguration& config = RTCPeerConnection::RTCConfiguration(), const std::shared_ptr<EventLoop>& loop = nullptr) = 0;
+
+		/// Places the connection on shard (key % shards), connections sharing a key share a network thread.
+
+		virtual std::shared_ptr<RTCPeerConnection> CreatePeerConnection(const RTCPeerConnection::RTCConfiguration& config, uint64_t key, const std::shared_ptr<EventLoop>& loop = nullptr) = 0;
+
+		virtual std::vector<ShardStats> Shards() const = 0;
+	};
+
+	/// Keeps up to size fully initialised connections (factory, DTLS certificate and webrtc peer connection)
+	/// ready for every RTCConfiguration passed to Warm() or Acquire(). Used connections are replaced on a
+	/// background thread, so Acquire() only builds a connection synchronously when the pool is empty.
+
+	class CRTC_EXPORT RTCPeerConnectionPool {
+		RTCPeerConnectionPool(const RTCPeerConnectionPool&) = delete;
+		RTCPeerConnectionPool& operator=(const RTCPeerConnectionPool&) = delete;
+
+	public:
+		struct CRTC_EXPORT Stats {
+			uint64_t hits;              // Acquire() served from the pool
+			uint64_t misses;            // Acquire() that had to create the connection itself
+			size_t ready;               // idle connections over all profiles
+			uint64_t refills;           // connections created by the background thread
+			int64_t lastRefillUs;
+			int64_t maxRefillUs;
+			int64_t averageRefillUs;
+		};
+
+		explicit RTCPeerConnectionPool();
+		virtual ~RTCPeerConnectionPool();
+
+		static std::shared_ptr<RTCPeerConnectionPool> New(size_t size, const std::shared_ptr<RTCPeerConnectionFactory>& factory = RTCPeerConnectionFactory::Default());
+
+		/// Starts filling the pool for config without taking a connection.
+
+		virtual void Warm(const RTCPeerConnection::RTCConfiguration& config = RTCPeerConnection::RTCConfiguration()) = 0;
+
+		virtual std::shared_ptr<RTCPeerConnection> Acquire(const RTCPeerConnection::RTCConfiguration& config = RTCPeerConnection::RTCConfiguration(), const std::shared_ptr<EventLoop>& loop = nullptr) = 0;
+
+		virtual Stats GetStats() const = 0;
+	};
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+	/// Result of co_await on an Awaitable, error is nullptr when value is set.
+
+	template <typename T> struct Awaited {
+		std::shared_ptr<Error> error;
+		T value;
+	};
+
+	/// Adapts a callback based call for co_await. start receives the completion and is called once the coroutine
+	/// suspended, the coroutine resumes on whatever thread the completion runs on (the connection's loop).
+
+	template <typename T> class Awaitable {
+	public:
+		typedef std::function<void(std::function<void(std::shared_ptr<Error>, T)>)> Start;
+
+		explicit Awaitable(Start start) : _start(std::move(start)) { }
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(std::coroutine_handle<> handle) {
+			Start start(std::move(_start));
+
+			start([this, handle](std::shared_ptr<Error> error, T value) {
+				_result.error = std::move(error);
+				_result.value = std::move(value);
+				handle.resume();
+			});
+		}
+
+		Awaited<T> await_resume() { return std::move(_result); }
+
+	private:
+		Start _start;
+		Awaited<T> _result;
 	};
+
+	template <> class Awaitable<void> {
+	public:
+		typedef std::function<void(std::function<void(std::shared_ptr<Error>)>)> Start;
+
+		explicit Awaitable(Start start) : _start(std::move(start)) { }
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(std::coroutine_handle<> handle) {
+			Start start(std::move(_start));
+
+			start([this, handle](std::shared_ptr<Error> error) {
+				_error = std::move(error);
+				handle.resume();
+			});
+		}
+
+		std::shared_ptr<Error> await_resume() { return std::move(_error); }
+
+	private:
+		Start _start;
+		std::shared_ptr<Error> _error;
+	};
+
+	/// Fire and forget coroutine, the frame is destroyed when the body returns. An exception leaving the body calls
+	/// std::terminate(): nobody awaits a Task, and rethrowing would unwind the loop or signaling callback that resumed
+	/// it, so catch inside the body whatever should not end the process.
+
+	struct Task {
+		struct promise_type {
+			Task get_return_object() noexcept { return Task(); }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() noexcept { }
+			void unhandled_exception() noexcept { std::terminate(); }
+		};
+	};
+
+	/// co_await adapters for the signaling calls, e.g.
+	///
+	///   auto offer = co_await Await::CreateOffer(pc);
+	///   auto error = co_await Await::SetLocalDescription(pc, offer.value);
+
+	class Await {
+	public:
+		static Awaitable<RTCPeerConnection::RTCSessionDescription> CreateOffer(std::shared_ptr<RTCPeerConnection> pc, const RTCPeerConnection::RTCOfferOptions& options = RTCPeerConnection::RTCOfferOptions()) {
+			return Awaitable<RTCPeerConnection::RTCSessionDescription>([pc, options](std::function<void(std::shared_ptr<Error>, RTCPeerConnection::RTCSessionDescription)> done) {
+				pc->CreateOffer([done](RTCPeerConnection::RTCSessionDescription* desc) {
+					done(nullptr, *desc);
+				}, options, [done](std::shared_ptr<Error> error) {
+					done(error, RTCPeerConnection::RTCSessionDescription());
+				});
+			});
+		}
+
+		static Awaitable<RTCPeerConnection::RTCSessionDescription> CreateAnswer(std::shared_ptr<RTCPeerConnection> pc, const RTCPeerConnection::RTCAnswerOptions& options = RTCPeerConnection::RTCAnswerOptions()) {
+			return Awaitable<RTCPeerConnection::RTCSessionDescription>([pc, options](std::function<void(std::shared_ptr<Error>, RTCPeerConnection::RTCSessionDescription)> done) {
+				pc->CreateAnswer([done](RTCPeerConnection::RTCSessionDescription* desc) {
+					done(nullptr, *desc);
+				}, options, [done](std::shared_ptr<Error> error) {
+					done(error, RTCPeerConnection::RTCSessionDescription());
+				});
+			});
+		}
+
+		static Awaitable<void> SetLocalDescription(std::shared_ptr<RTCPeerConnection> pc, const RTCPeerConnection::RTCSessionDescription& sdp) {
+			auto desc = std::make_shared<const RTCPeerConnection::RTCSessionDescription>(sdp);
+
+			return Awaitable<void>([pc, desc](std::function<void(std::shared_ptr<Error>)> done) {
+				pc->SetLocalDescription(desc, done);
+			});
+		}
+
+		static Awaitable<void> SetRemoteDescription(std::shared_ptr<RTCPeerConnection> pc, const RTCPeerConnection::RTCSessionDescription& sdp) {
+			auto desc = std::make_shared<const RTCPeerConnection::RTCSessionDescription>(sdp);
+
+			return Awaitable<void>([pc, desc](std::function<void(std::shared_ptr<Error>)> done) {
+				pc->SetRemoteDescription(desc, done);
+			});
+		}
+
+		static Awaitable<void> AddIceCandidate(std::shared_ptr<RTCPeerConnection> pc, const RTCPeerConnection::RTCIceCandidate& candidate) {
+			return Awaitable<void>([pc, candidate](std::function<void(std::shared_ptr<Error>)> done) {
+				pc->AddIceCandidate(candidate, done);
+			});
+		}
+
+		/// Waits until a writer whose Write() returned false may continue:
+		///
+		///   if (!writer->Write(chunk) && co_await Await::Ready(writer)) { /* channel closed */ }
+
+		static Awaitable<void> Ready(std::shared_ptr<RTCDataChannelWriter> writer) {
+			return Awaitable<void>([writer](std::function<void(std::shared_ptr<Error>)> done) {
+				writer->Ready(done);
+			});
+		}
+	};
+#endif
 } // namespace crtc
 
 #endif // INCLUDE_CRTC_H_
\ No newline at end of file
@@ -25,6 +25,8 @@
 
 #include "crtc.h"
 #include <cstring>
+#include <mutex>
+#include <new>
 
 #include "arraybuffer.h"
 
@@ -42,6 +44,20 @@ std::shared_ptr<ArrayBuffer> ArrayBuffer::New(const uint8_t *data, size_t byteLe
   return std::make_shared<ArrayBufferInternal>(data, byteLength);
 }
 
+std::shared_ptr<ArrayBuffer> ArrayBuffer::NewZeroCopy(size_t byteLength) {
+  rtc::CopyOnWriteBuffer buffer(byteLength);
+
+  if (byteLength) {
+    std::memset(buffer.MutableData(), 0, byteLength);
+  }
+
+  return std::make_shared<WrapRtcBuffer>(std::move(buffer));
+}
+
+std::shared_ptr<ArrayBuffer> ArrayBuffer::Adopt(uint8_t *data, size_t byteLength, std::function<void(uint8_t*)> deleter) {
+  return std::make_shared<AdoptedArrayBuffer>(data, byteLength, std::move(deleter));
+}
+
 ArrayBufferInternal::ArrayBufferInternal(const uint8_t *data, size_t byteLength) : 
   _alloc(false),
   _data(nullptr),
@@ -102,4 +118,186 @@ const uint8_t *ArrayBufferInternal::Data() const {
 
 String ArrayBufferInternal::ToString() const {
   return String(reinterpret_cast<const char *>(_data), _byteLength);
-}
\ No newline at end of file
+}
+
+WrapRtcBuffer::WrapRtcBuffer(rtc::CopyOnWriteBuffer buffer) : _data(std::move(buffer)) {
+
+}
+
+WrapRtcBuffer::~WrapRtcBuffer() {
+
+}
+
+size_t WrapRtcBuffer::ByteLength() const {
+  return _data.size();
+}
+
+std::shared_ptr<ArrayBuffer> WrapRtcBuffer::Slice(size_t begin, size_t end) const {
+  if (begin <= end && end <= _data.size()) {
+    return std::make_shared<WrapRtcBuffer>(_data.Slice(begin, ((!end) ? _data.size() : end - begin)));
+  }
+
+  return nullptr;
+}
+
+uint8_t *WrapRtcBuffer::Data() {
+  return _data.MutableData();
+}
+
+const uint8_t *WrapRtcBuffer::Data() const {
+  return _data.data();
+}
+
+String WrapRtcBuffer::ToString() const {
+  return String(reinterpret_cast<const char *>(_data.data()), _data.size());
+}
+
+struct WrapRtcBufferPool::State {
+  struct Block {
+    Block *next;
+  };
+
+  explicit State(size_t capacity) :
+    free(nullptr),
+    cached(0),
+    capacity(capacity),
+    blockSize(0),
+    allocated(0)
+  { }
+
+  ~State() {
+    while (free) {
+      Block *block = free;
+      free = block->next;
+      ::operator delete(block);
+    }
+  }
+
+  // allocate_shared asks for one size only, the control block with the WrapRtcBuffer in it.
+  void *Acquire(size_t size) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      if (!blockSize) {
+        blockSize = size;
+      }
+
+      if (size == blockSize && free) {
+        Block *block = free;
+        free = block->next;
+        cached--;
+        return block;
+      }
+
+      allocated++;
+    }
+
+    return ::operator new(size);
+  }
+
+  void Release(void *ptr, size_t size) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      if (size == blockSize && cached < capacity) {
+        Block *block = static_cast<Block*>(ptr);
+        block->next = free;
+        free = block;
+        cached++;
+        return;
+      }
+    }
+
+    ::operator delete(ptr);
+  }
+
+  std::mutex mutex;
+  Block *free;
+  size_t cached;
+  size_t capacity;
+  size_t blockSize;
+  size_t allocated;
+};
+
+namespace {
+  template <typename T> class PoolAllocator {
+  public:
+    typedef T value_type;
+
+    explicit PoolAllocator(const std::shared_ptr<WrapRtcBufferPool::State> &state) : state(state) { }
+    template <typename U> PoolAllocator(const PoolAllocator<U> &other) : state(other.state) { }
+
+    T *allocate(size_t count) {
+      return static_cast<T*>(state->Acquire(sizeof(T) * count));
+    }
+
+    void deallocate(T *ptr, size_t count) {
+      state->Release(ptr, sizeof(T) * count);
+    }
+
+    template <typename U> bool operator==(const PoolAllocator<U> &other) const {
+      return state == other.state;
+    }
+
+    template <typename U> bool operator!=(const PoolAllocator<U> &other) const {
+      return state != other.state;
+    }
+
+    std::shared_ptr<WrapRtcBufferPool::State> state;
+  };
+}
+
+WrapRtcBufferPool::WrapRtcBufferPool(size_t capacity) : _state(std::make_shared<State>(capacity)) {
+
+}
+
+WrapRtcBufferPool::~WrapRtcBufferPool() {
+
+}
+
+std::shared_ptr<ArrayBuffer> WrapRtcBufferPool::Wrap(rtc::CopyOnWriteBuffer buffer) {
+  return std::allocate_shared<WrapRtcBuffer>(PoolAllocator<WrapRtcBuffer>(_state), std::move(buffer));
+}
+
+size_t WrapRtcBufferPool::Allocated() const {
+  std::lock_guard<std::mutex> lock(_state->mutex);
+  return _state->allocated;
+}
+
+AdoptedArrayBuffer::AdoptedArrayBuffer(uint8_t *data, size_t byteLength, std::function<void(uint8_t*)> deleter) :
+  _data(data),
+  _byteLength(data ? byteLength : 0),
+  _deleter(std::move(deleter))
+{
+
+}
+
+AdoptedArrayBuffer::~AdoptedArrayBuffer() {
+  if (_deleter && _data) {
+    _deleter(_data);
+  }
+}
+
+size_t AdoptedArrayBuffer::ByteLength() const {
+  return _byteLength;
+}
+
+std::shared_ptr<ArrayBuffer> AdoptedArrayBuffer::Slice(size_t begin, size_t end) const {
+  if (begin <= end && end <= _byteLength) {
+    return ArrayBuffer::New(_data + begin, ((!end) ? _byteLength : end - begin));
+  }
+
+  return nullptr;
+}
+
+uint8_t *AdoptedArrayBuffer::Data() {
+  return _data;
+}
+
+const uint8_t *AdoptedArrayBuffer::Data() const {
+  return _data;
+}
+
+String AdoptedArrayBuffer::ToString() const {
+  return String(reinterpret_cast<const char *>(_data), _byteLength);
+}
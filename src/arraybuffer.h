@@ -56,6 +56,72 @@ namespace crtc {
         uint8_t* _data;
         size_t _byteLength;
     };
+
+    // ArrayBuffer over an rtc::CopyOnWriteBuffer. RTCDataChannel sends and receives these by reference, Data() detaches
+    // from a buffer that a pending send still shares before it hands out a writable pointer.
+    class WrapRtcBuffer : public ArrayBuffer {
+
+    public:
+        explicit WrapRtcBuffer(rtc::CopyOnWriteBuffer buffer);
+        virtual ~WrapRtcBuffer();
+
+        size_t ByteLength() const override;
+
+        std::shared_ptr<ArrayBuffer> Slice(size_t begin = 0, size_t end = 0) const override;
+
+        uint8_t* Data() override;
+        const uint8_t* Data() const override;
+
+        String ToString() const override;
+
+        inline const rtc::CopyOnWriteBuffer& Buffer() const {
+            return _data;
+        }
+
+    protected:
+        rtc::CopyOnWriteBuffer _data;
+    };
+
+    // Hands out WrapRtcBuffers whose object and control block come from a free list, so receiving a message does not
+    // touch the heap once the pool has warmed up. Buffers may be released on any thread and keep the free list alive,
+    // at most capacity blocks are kept for reuse.
+    class WrapRtcBufferPool {
+
+    public:
+        explicit WrapRtcBufferPool(size_t capacity = 1024);
+        ~WrapRtcBufferPool();
+
+        std::shared_ptr<ArrayBuffer> Wrap(rtc::CopyOnWriteBuffer buffer);
+
+        // Blocks that had to come from the heap since the pool was created.
+        size_t Allocated() const;
+
+        struct State;
+
+    private:
+        std::shared_ptr<State> _state;
+    };
+
+    class AdoptedArrayBuffer : public ArrayBuffer {
+
+    public:
+        explicit AdoptedArrayBuffer(uint8_t* data, size_t byteLength, std::function<void(uint8_t*)> deleter);
+        virtual ~AdoptedArrayBuffer();
+
+        size_t ByteLength() const override;
+
+        std::shared_ptr<ArrayBuffer> Slice(size_t begin = 0, size_t end = 0) const override;
+
+        uint8_t* Data() override;
+        const uint8_t* Data() const override;
+
+        String ToString() const override;
+
+    protected:
+        uint8_t* _data;
+        size_t _byteLength;
+        std::function<void(uint8_t*)> _deleter;
+    };
 }
 
 #endif
\ No newline at end of file
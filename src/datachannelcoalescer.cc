@@ -0,0 +1,193 @@
+#include "datachannelcoalescer.h"
+#include "datachannelprotocol.h"
+#include "rtcdatachannel.h"
+#include "api/units/time_delta.h"
+#include <algorithm>
+
+using namespace crtc;
+
+const char DataChannelCoalescer::kProtocol[] = "crtc-coalesce";
+
+static const uint8_t kBinary = 0x01;
+
+// Flags byte plus the longest varint of a 64 bit length.
+static const size_t kMaxRecordHeader = 11;
+
+DataChannelCoalescer::DataChannelCoalescer(RTCDataChannelInternal* owner, rtc::Thread* network, int delay, size_t maxSize) :
+	_owner(owner),
+	_network(network),
+	_delay(std::max(delay, 0)),
+	_maxSize(std::max<size_t>(maxSize, 1)),
+	_original(0),
+	_records(0),
+	_generation(0),
+	_scheduled(false)
+{
+
+}
+
+DataChannelCoalescer::~DataChannelCoalescer() {
+
+}
+
+std::string DataChannelCoalescer::Negotiate(const std::string& protocol) {
+	return DataChannelProtocol::Append(protocol, kProtocol);
+}
+
+bool DataChannelCoalescer::Negotiated(const std::string& protocol) {
+	return DataChannelProtocol::Has(protocol, kProtocol);
+}
+
+std::string DataChannelCoalescer::Strip(const std::string& protocol) {
+	return DataChannelProtocol::Strip(protocol, kProtocol);
+}
+
+void DataChannelCoalescer::Configure(int delay, size_t maxSize) {
+	_delay.store(std::max(delay, 0));
+	_maxSize.store(std::max<size_t>(maxSize, 1));
+}
+
+void DataChannelCoalescer::Send(webrtc::DataBuffer buffer) {
+	size_t maxSize = _maxSize.load();
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+
+	// Whatever is pending goes first, a message never overtakes the bundle before it.
+	if (_records && _bundle.size() + kMaxRecordHeader + buffer.size() > maxSize) {
+		Flush();
+	}
+
+	Append(buffer);
+
+	if (_bundle.size() >= maxSize || !_network) {
+		Flush();
+		return;
+	}
+
+	if (_scheduled) {
+		return;
+	}
+
+	int delay = _delay.load();
+	auto task = [self = shared_from_this(), generation = _generation]() {
+		self->OnTimer(generation);
+	};
+
+	_scheduled = true;
+
+	if (delay) {
+		_network->PostDelayedTask(std::move(task), webrtc::TimeDelta::Millis(delay));
+	}
+	else {
+		_network->PostTask(std::move(task));
+	}
+}
+
+bool DataChannelCoalescer::Split(const webrtc::DataBuffer& buffer, const std::function<void(webrtc::DataBuffer)>& message) {
+	const uint8_t* data = buffer.data.data();
+	size_t size = buffer.size();
+	size_t position = 0;
+	uint64_t records = 0;
+	bool valid = true;
+
+	while (position < size) {
+		uint8_t flags = data[position++];
+		uint64_t length = 0;
+		bool complete = false;
+
+		for (unsigned shift = 0; position < size && shift < 64; shift += 7) {
+			uint8_t byte = data[position++];
+
+			length |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+			if (!(byte & 0x80)) {
+				complete = true;
+				break;
+			}
+		}
+
+		if (!complete || length > size - position) {
+			valid = false;
+			break;
+		}
+
+		// Records are slices of the received buffer, nothing is copied.
+		message(webrtc::DataBuffer(buffer.data.Slice(position, static_cast<size_t>(length)), (flags & kBinary) != 0));
+		position += static_cast<size_t>(length);
+		records++;
+	}
+
+	std::lock_guard<std::mutex> lock(_statsMutex);
+
+	_stats.messagesReceived += records;
+	_stats.wireMessagesReceived++;
+	return valid;
+}
+
+void DataChannelCoalescer::Detach() {
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	_owner = nullptr;
+}
+
+RTCDataChannel::CoalescingStats DataChannelCoalescer::GetStats() {
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	return _stats;
+}
+
+void DataChannelCoalescer::Append(const webrtc::DataBuffer& buffer) {
+	uint8_t header[kMaxRecordHeader];
+	size_t length = 0;
+	uint64_t size = buffer.size();
+
+	header[length++] = buffer.binary ? kBinary : 0;
+
+	do {
+		header[length] = static_cast<uint8_t>(size & 0x7F);
+		size >>= 7;
+		header[length++] |= size ? 0x80 : 0;
+	} while (size);
+
+	// Reserved once per bundle, records are appended in place.
+	if (!_records) {
+		_bundle = rtc::CopyOnWriteBuffer(0, std::max(_maxSize.load(), length + buffer.size()));
+	}
+
+	_bundle.AppendData(header, length);
+	_bundle.AppendData(buffer.data.data(), buffer.size());
+	_original += buffer.size();
+	_records++;
+}
+
+void DataChannelCoalescer::Flush() {
+	if (!_records) {
+		return;
+	}
+
+	webrtc::DataBuffer bundle(_bundle, true);
+	uint64_t original = _original;
+	uint64_t records = _records;
+
+	_bundle = rtc::CopyOnWriteBuffer();
+	_original = 0;
+	_records = 0;
+	_generation++;
+	_scheduled = false;
+
+	{
+		std::lock_guard<std::mutex> lock(_statsMutex);
+
+		_stats.messagesSent += records;
+		_stats.wireMessagesSent++;
+	}
+
+	if (_owner) {
+		_owner->OnCoalesced(std::move(bundle), original);
+	}
+}
+
+void DataChannelCoalescer::OnTimer(uint64_t generation) {
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+
+	if (_scheduled && generation == _generation) {
+		Flush();
+	}
+}
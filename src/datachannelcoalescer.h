@@ -0,0 +1,72 @@
+#ifndef CRTC_DATACHANNELCOALESCER_H
+#define CRTC_DATACHANNELCOALESCER_H
+
+#include "crtc.h"
+#include <api/data_channel_interface.h>
+#include "rtc_base/thread.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace crtc {
+	class RTCDataChannelInternal;
+
+	// Bundles small messages of one data channel, announced by kProtocol in front of the compression marker. Every
+	// wire message is a sequence of records: a flags byte (kBinary), the length as a little endian base 128 varint and
+	// the payload. A message is held until the bundle reaches maxSize or the first message in it waited delay
+	// milliseconds, the flush is timed on the network thread. Messages that do not fit a bundle go out alone as the
+	// only record of theirs.
+	class DataChannelCoalescer : public std::enable_shared_from_this<DataChannelCoalescer> {
+	public:
+		static const char kProtocol[];
+
+		explicit DataChannelCoalescer(RTCDataChannelInternal* owner, rtc::Thread* network, int delay, size_t maxSize);
+		~DataChannelCoalescer();
+
+		// protocol is the channel's protocol without DataChannelCompressor's marker.
+		static std::string Negotiate(const std::string& protocol);
+		static bool Negotiated(const std::string& protocol);
+		static std::string Strip(const std::string& protocol);
+
+		void Configure(int delay, size_t maxSize);
+
+		// Bundles go to the owner's OnCoalesced() in the order the messages were sent.
+		void Send(webrtc::DataBuffer buffer);
+
+		// Calls message for every record of a received wire message, false when it is malformed.
+		bool Split(const webrtc::DataBuffer& buffer, const std::function<void(webrtc::DataBuffer)>& message);
+
+		// Stops calls into the owner, waits for one in progress.
+		void Detach();
+
+		RTCDataChannel::CoalescingStats GetStats();
+
+	private:
+		// Called with _mutex held, Flush() resets the bundle before it calls the owner.
+		void Append(const webrtc::DataBuffer& buffer);
+		void Flush();
+
+		void OnTimer(uint64_t generation);
+
+		// Recursive: the owner's send path can finish inline and flow back into Send() while a bundle is flushed.
+		std::recursive_mutex _mutex;
+		RTCDataChannelInternal* _owner;
+		rtc::Thread* _network;
+
+		std::atomic<int> _delay;
+		std::atomic<size_t> _maxSize;
+
+		rtc::CopyOnWriteBuffer _bundle;
+		uint64_t _original;
+		uint64_t _records;
+		uint64_t _generation;
+		bool _scheduled;
+
+		std::mutex _statsMutex;
+		RTCDataChannel::CoalescingStats _stats;
+	};
+}
+
+#endif
@@ -0,0 +1,321 @@
+#include "datachannelcompressor.h"
+#include "datachannelprotocol.h"
+#include "rtcdatachannel.h"
+#include "third_party/zlib/zlib.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#if defined(WEBRTC_POSIX)
+#include <time.h>
+#endif
+
+using namespace crtc;
+
+const char DataChannelCompressor::kProtocol[] = "crtc-deflate";
+
+static const uint8_t kRaw = 0;
+static const uint8_t kDeflated = 1;
+static const size_t kDeflatedHeader = 5;
+
+// Largest message a peer may announce, inflating never allocates more than this up front.
+static const uint32_t kMaxInflated = 64 * 1024 * 1024;
+
+static int64_t CpuMicros() {
+#if defined(WEBRTC_POSIX)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+		return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+	}
+#endif
+
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+DataChannelCompressor::DataChannelCompressor(RTCDataChannelInternal* owner, size_t threshold, int level) :
+	_owner(owner),
+	_threshold(std::max<size_t>(threshold, 1)),
+	_level(level),
+	_deflate(nullptr),
+	_deflateLevel(0),
+	_inflate(nullptr)
+{
+	_send.running = false;
+	_receive.running = false;
+}
+
+DataChannelCompressor::~DataChannelCompressor() {
+	if (_deflate) {
+		deflateEnd(_deflate);
+		delete _deflate;
+	}
+
+	if (_inflate) {
+		inflateEnd(_inflate);
+		delete _inflate;
+	}
+}
+
+std::string DataChannelCompressor::Negotiate(const std::string& protocol) {
+	return DataChannelProtocol::Append(protocol, kProtocol);
+}
+
+bool DataChannelCompressor::Negotiated(const std::string& protocol) {
+	return DataChannelProtocol::Has(protocol, kProtocol);
+}
+
+std::string DataChannelCompressor::Strip(const std::string& protocol) {
+	return DataChannelProtocol::Strip(protocol, kProtocol);
+}
+
+void DataChannelCompressor::Configure(size_t threshold, int level) {
+	_threshold.store(std::max<size_t>(threshold, 1));
+	_level.store(level);
+}
+
+void DataChannelCompressor::Send(webrtc::DataBuffer buffer) {
+	Schedule(&_send, std::move(buffer));
+}
+
+void DataChannelCompressor::Receive(webrtc::DataBuffer buffer) {
+	Schedule(&_receive, std::move(buffer));
+}
+
+void DataChannelCompressor::Detach() {
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	_owner = nullptr;
+}
+
+RTCDataChannel::CompressionStats DataChannelCompressor::GetStats() {
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	return _stats;
+}
+
+void DataChannelCompressor::Schedule(Strand* strand, webrtc::DataBuffer buffer) {
+	{
+		std::lock_guard<std::mutex> lock(strand->mutex);
+
+		strand->buffers.push_back(std::move(buffer));
+
+		if (strand->running) {
+			return;
+		}
+
+		strand->running = true;
+	}
+
+	Pool()->Execute([self = shared_from_this(), strand]() {
+		self->Drain(strand);
+	});
+}
+
+void DataChannelCompressor::Drain(Strand* strand) {
+	while (true) {
+		std::unique_lock<std::mutex> lock(strand->mutex);
+
+		if (strand->buffers.empty()) {
+			strand->running = false;
+			return;
+		}
+
+		webrtc::DataBuffer buffer = std::move(strand->buffers.front());
+
+		strand->buffers.pop_front();
+		lock.unlock();
+
+		if (strand == &_send) {
+			Compress(std::move(buffer));
+		}
+		else {
+			Decompress(std::move(buffer));
+		}
+	}
+}
+
+void DataChannelCompressor::Compress(webrtc::DataBuffer buffer) {
+	const rtc::CopyOnWriteBuffer& input = buffer.data;
+	uint64_t original = input.size();
+	rtc::CopyOnWriteBuffer output;
+	bool compressed = false;
+	int64_t elapsed = 0;
+
+	// Messages that deflate to more than their raw form go out as is.
+	if (original >= _threshold.load()) {
+		int64_t begin = CpuMicros();
+
+		compressed = Deflate(input, &output) && output.size() < original + 1;
+		elapsed = CpuMicros() - begin;
+	}
+
+	if (!compressed) {
+		output = rtc::CopyOnWriteBuffer(original + 1);
+
+		uint8_t* data = output.MutableData();
+
+		data[0] = kRaw;
+
+		if (original) {
+			std::memcpy(data + 1, input.data(), original);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_statsMutex);
+
+		_stats.messagesSent++;
+		_stats.messagesCompressed += compressed ? 1 : 0;
+		_stats.bytesIn += original;
+		_stats.bytesOut += output.size();
+		_stats.compressMicros += elapsed;
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+
+	if (_owner) {
+		_owner->OnCompressed(webrtc::DataBuffer(output, buffer.binary), original);
+	}
+}
+
+void DataChannelCompressor::Decompress(webrtc::DataBuffer buffer) {
+	rtc::CopyOnWriteBuffer output;
+	int64_t begin = CpuMicros();
+	auto error = Inflate(buffer.data, &output);
+	int64_t elapsed = CpuMicros() - begin;
+
+	{
+		std::lock_guard<std::mutex> lock(_statsMutex);
+
+		_stats.messagesReceived++;
+		_stats.bytesReceived += buffer.size();
+		_stats.bytesInflated += output.size();
+		_stats.decompressMicros += elapsed;
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+
+	if (!_owner) {
+		return;
+	}
+
+	if (error) {
+		_owner->OnCompressionError(error);
+	}
+	else {
+		_owner->Dispatch(webrtc::DataBuffer(output, buffer.binary));
+	}
+}
+
+bool DataChannelCompressor::Deflate(const rtc::CopyOnWriteBuffer& input, rtc::CopyOnWriteBuffer* output) {
+	int level = _level.load();
+
+	if (input.size() > std::numeric_limits<uint32_t>::max()) {
+		return false;
+	}
+
+	if (_deflate && _deflateLevel != level) {
+		deflateEnd(_deflate);
+		delete _deflate;
+		_deflate = nullptr;
+	}
+
+	if (!_deflate) {
+		_deflate = new z_stream();
+
+		if (deflateInit2(_deflate, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			delete _deflate;
+			_deflate = nullptr;
+			return false;
+		}
+
+		_deflateLevel = level;
+	}
+	else {
+		deflateReset(_deflate);
+	}
+
+	uLong bound = deflateBound(_deflate, static_cast<uLong>(input.size()));
+
+	output->SetSize(kDeflatedHeader + bound);
+
+	uint8_t* data = output->MutableData();
+	uint32_t length = static_cast<uint32_t>(input.size());
+
+	data[0] = kDeflated;
+
+	for (size_t index = 0; index < 4; index++) {
+		data[1 + index] = static_cast<uint8_t>(length >> (index * 8));
+	}
+
+	_deflate->next_in = const_cast<Bytef*>(input.data());
+	_deflate->avail_in = static_cast<uInt>(input.size());
+	_deflate->next_out = data + kDeflatedHeader;
+	_deflate->avail_out = static_cast<uInt>(bound);
+
+	if (deflate(_deflate, Z_FINISH) != Z_STREAM_END) {
+		return false;
+	}
+
+	output->SetSize(kDeflatedHeader + _deflate->total_out);
+	return true;
+}
+
+std::shared_ptr<Error> DataChannelCompressor::Inflate(const rtc::CopyOnWriteBuffer& input, rtc::CopyOnWriteBuffer* output) {
+	const uint8_t* data = input.data();
+	size_t size = input.size();
+
+	if (size && data[0] == kRaw) {
+		*output = input.Slice(1, size - 1);
+		return nullptr;
+	}
+
+	if (size < kDeflatedHeader || data[0] != kDeflated) {
+		return Error::New("Invalid compressed message.", __FILE__, __LINE__);
+	}
+
+	uint32_t length = 0;
+
+	for (size_t index = 0; index < 4; index++) {
+		length |= static_cast<uint32_t>(data[1 + index]) << (index * 8);
+	}
+
+	if (length > kMaxInflated) {
+		return Error::New("Compressed message is too large.", __FILE__, __LINE__);
+	}
+
+	if (!_inflate) {
+		_inflate = new z_stream();
+
+		if (inflateInit2(_inflate, -MAX_WBITS) != Z_OK) {
+			delete _inflate;
+			_inflate = nullptr;
+			return Error::New("Unable to initialize zlib.", __FILE__, __LINE__);
+		}
+	}
+	else {
+		inflateReset(_inflate);
+	}
+
+	rtc::CopyOnWriteBuffer result(length);
+	uint8_t byte = 0;
+
+	_inflate->next_in = const_cast<Bytef*>(data + kDeflatedHeader);
+	_inflate->avail_in = static_cast<uInt>(size - kDeflatedHeader);
+	_inflate->next_out = length ? result.MutableData() : &byte;
+	_inflate->avail_out = length;
+
+	if (inflate(_inflate, Z_FINISH) != Z_STREAM_END || _inflate->total_out != length) {
+		return Error::New("Invalid compressed message.", __FILE__, __LINE__);
+	}
+
+	*output = std::move(result);
+	return nullptr;
+}
+
+ExecutorInternal* DataChannelCompressor::Pool() {
+	// Shared by every channel and never destroyed, so a strand still draining at exit does not race its teardown.
+	static PoolExecutor* pool = new PoolExecutor(std::max<unsigned>(std::thread::hardware_concurrency() / 2, 1), 0);
+	return pool;
+}
@@ -0,0 +1,81 @@
+#ifndef CRTC_DATACHANNELCOMPRESSOR_H
+#define CRTC_DATACHANNELCOMPRESSOR_H
+
+#include "crtc.h"
+#include "executor.h"
+#include <api/data_channel_interface.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+struct z_stream_s;
+
+namespace crtc {
+	class RTCDataChannelInternal;
+
+	// Per message deflate for one data channel, announced by kProtocol at the end of the channel's protocol. Every
+	// message gets a one byte prefix: kRaw for payloads sent as is, kDeflated for raw deflate data behind the original
+	// length (uint32, little endian). Sends and receives each run in order on their own strand of a shared worker
+	// pool, zlib never runs on webrtc's threads.
+	class DataChannelCompressor : public std::enable_shared_from_this<DataChannelCompressor> {
+	public:
+		static const char kProtocol[];
+
+		explicit DataChannelCompressor(RTCDataChannelInternal* owner, size_t threshold, int level);
+		~DataChannelCompressor();
+
+		static std::string Negotiate(const std::string& protocol);
+		static bool Negotiated(const std::string& protocol);
+		static std::string Strip(const std::string& protocol);
+
+		void Configure(size_t threshold, int level);
+
+		// Results go to the owner's OnCompressed() and Dispatch(), in the order the buffers were queued.
+		void Send(webrtc::DataBuffer buffer);
+		void Receive(webrtc::DataBuffer buffer);
+
+		// Stops calls into the owner, waits for one in progress.
+		void Detach();
+
+		RTCDataChannel::CompressionStats GetStats();
+
+	private:
+		struct Strand {
+			std::mutex mutex;
+			std::deque<webrtc::DataBuffer> buffers;
+			bool running;
+		};
+
+		void Schedule(Strand* strand, webrtc::DataBuffer buffer);
+		void Drain(Strand* strand);
+
+		void Compress(webrtc::DataBuffer buffer);
+		void Decompress(webrtc::DataBuffer buffer);
+
+		// Only called on their strand.
+		bool Deflate(const rtc::CopyOnWriteBuffer& input, rtc::CopyOnWriteBuffer* output);
+		std::shared_ptr<Error> Inflate(const rtc::CopyOnWriteBuffer& input, rtc::CopyOnWriteBuffer* output);
+
+		static ExecutorInternal* Pool();
+
+		std::recursive_mutex _mutex;
+		RTCDataChannelInternal* _owner;
+
+		std::atomic<size_t> _threshold;
+		std::atomic<int> _level;
+
+		Strand _send;
+		Strand _receive;
+
+		z_stream_s* _deflate;
+		int _deflateLevel;
+		z_stream_s* _inflate;
+
+		std::mutex _statsMutex;
+		RTCDataChannel::CompressionStats _stats;
+	};
+}
+
+#endif
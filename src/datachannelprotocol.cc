@@ -0,0 +1,31 @@
+#include "datachannelprotocol.h"
+#include <cstring>
+
+using namespace crtc;
+
+std::string DataChannelProtocol::Append(const std::string& protocol, const char* token) {
+	if (Has(protocol, token)) {
+		return protocol;
+	}
+
+	return protocol.empty() ? std::string(token) : protocol + ";" + token;
+}
+
+bool DataChannelProtocol::Has(const std::string& protocol, const char* token) {
+	size_t length = strlen(token);
+
+	if (protocol.size() < length || protocol.compare(protocol.size() - length, length, token) != 0) {
+		return false;
+	}
+
+	return protocol.size() == length || protocol[protocol.size() - length - 1] == ';';
+}
+
+std::string DataChannelProtocol::Strip(const std::string& protocol, const char* token) {
+	if (!Has(protocol, token)) {
+		return protocol;
+	}
+
+	size_t length = strlen(token);
+	return protocol.size() == length ? std::string() : protocol.substr(0, protocol.size() - length - 1);
+}
@@ -0,0 +1,17 @@
+#ifndef CRTC_DATACHANNELPROTOCOL_H
+#define CRTC_DATACHANNELPROTOCOL_H
+
+#include <string>
+
+namespace crtc {
+	// Extensions are announced as ";token" at the end of a data channel's protocol, the first one without the
+	// separator when the application's protocol is empty. The last token appended is the first one stripped.
+	class DataChannelProtocol {
+	public:
+		static std::string Append(const std::string& protocol, const char* token);
+		static bool Has(const std::string& protocol, const char* token);
+		static std::string Strip(const std::string& protocol, const char* token);
+	};
+}
+
+#endif
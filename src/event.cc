@@ -29,14 +29,16 @@
 
 using namespace crtc;
 
-std::shared_ptr<Event> Event::New() {
-  return std::make_shared<Event>();
+std::shared_ptr<Event> Event::New(volatile intptr_t* pending) {
+  return std::make_shared<Event>(pending);
 }
 
-Event::Event() {
-	base::subtle::NoBarrier_AtomicIncrement(&ModuleInternal::pending_events, 1);
+Event::Event(volatile intptr_t* pending) :
+	_pending(pending ? pending : &ModuleInternal::pending_events)
+{
+	base::subtle::NoBarrier_AtomicIncrement(_pending, 1);
 }
 
 Event::~Event() {
-	base::subtle::NoBarrier_AtomicIncrement(&ModuleInternal::pending_events, -1);
+	base::subtle::NoBarrier_AtomicIncrement(_pending, -1);
 }
@@ -9,10 +9,14 @@ namespace crtc {
 		Event& operator=(const Event&) = delete;
 
 	public:
-		explicit Event();
+		// Without a counter the event is counted in ModuleInternal::pending_events.
+		explicit Event(volatile intptr_t* pending = nullptr);
 		virtual ~Event();
 
-		static std::shared_ptr<Event> New();
+		static std::shared_ptr<Event> New(volatile intptr_t* pending = nullptr);
+
+	private:
+		volatile intptr_t* _pending;
 	};
 }
 
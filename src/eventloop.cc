@@ -0,0 +1,563 @@
+#include "eventloop.h"
+#include "module.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/null_socket_server.h"
+#include <base/atomicops.h>
+#include <chrono>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+using namespace crtc;
+
+static std::once_flag defaultLoopOnce;
+static std::shared_ptr<EventLoopInternal> defaultLoop;
+static thread_local EventLoopInternal* currentLoop = nullptr;
+
+static EventLoopInternal* DefaultLoop() {
+	std::call_once(defaultLoopOnce, []() {
+		defaultLoop = std::make_shared<EventLoopInternal>(&ModuleInternal::pending_events);
+	});
+
+	return defaultLoop.get();
+}
+
+// Makes the loop current on the dispatching thread, tasks that webrtc posts to rtc::Thread::Current()
+// from inside a callback then land on the same loop.
+class DispatchScope {
+public:
+	explicit DispatchScope(EventLoopInternal* loop) :
+		_manager(rtc::ThreadManager::Instance()),
+		_previous(_manager->CurrentThread()),
+		_previousLoop(currentLoop),
+		_thread(loop->GetThread())
+	{
+		if (_previous != _thread) {
+			_manager->SetCurrentThread(nullptr);
+			_manager->SetCurrentThread(_thread);
+		}
+
+		currentLoop = loop;
+	}
+
+	~DispatchScope() {
+		currentLoop = _previousLoop;
+
+		if (_previous != _thread) {
+			_manager->SetCurrentThread(nullptr);
+			_manager->SetCurrentThread(_previous);
+		}
+	}
+
+private:
+	rtc::ThreadManager* _manager;
+	rtc::Thread* _previous;
+	EventLoopInternal* _previousLoop;
+	rtc::Thread* _thread;
+};
+
+EventLoopThread::EventLoopThread(synchronized_callback<>* onpost) :
+	rtc::Thread(std::make_unique<rtc::NullSocketServer>()),
+	_onpost(onpost),
+	_head(nullptr),
+	_tail(nullptr),
+	_timers(Tick(Now())),
+	_free(nullptr),
+	_epollfd(-1),
+	_eventfd(-1),
+	_timerfd(-1)
+{
+#if defined(__linux__)
+	_epollfd = epoll_create1(EPOLL_CLOEXEC);
+	_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	_timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+	if (_epollfd < 0 || _eventfd < 0 || _timerfd < 0) {
+		RTC_LOG(LS_ERROR) << "EventLoop: unable to create wakeup descriptors, errno " << errno;
+	}
+	else {
+		struct epoll_event event = {};
+		event.events = EPOLLIN;
+
+		epoll_ctl(_epollfd, EPOLL_CTL_ADD, _eventfd, &event);
+		epoll_ctl(_epollfd, EPOLL_CTL_ADD, _timerfd, &event);
+	}
+#endif
+}
+
+EventLoopThread::~EventLoopThread() {
+	rtc::Thread::Stop();
+
+	if (rtc::ThreadManager::Instance()->CurrentThread() == this) {
+		rtc::ThreadManager::Instance()->SetCurrentThread(nullptr);
+	}
+
+	// Dropped captures may post again while the nodes are released, repeat until nothing is queued.
+	for (bool released = true; released;) {
+		released = false;
+
+		for (size_t index = 0; index < _chunks.size() * kChunkSize; index++) {
+			EventLoopTask* node = &_chunks[index / kChunkSize][index % kChunkSize];
+
+			if (node->state == EventLoopTask::kReady || node->state == EventLoopTask::kTimer) {
+				node->state = EventLoopTask::kRunning;
+				Release(node);
+				released = true;
+			}
+		}
+	}
+
+#if defined(__linux__)
+	if (_timerfd >= 0) close(_timerfd);
+	if (_eventfd >= 0) close(_eventfd);
+	if (_epollfd >= 0) close(_epollfd);
+#endif
+}
+
+bool EventLoopThread::RunTasks(size_t maxTasks, int64_t maxMicros) {
+	int64_t begin = Now();
+	size_t count = 0;
+
+#if defined(__linux__)
+	uint64_t value;
+
+	// Both descriptors are level triggered, drain them before running so the fd only stays readable for new work.
+	while (_eventfd >= 0 && read(_eventfd, &value, sizeof(value)) > 0) { }
+	while (_timerfd >= 0 && read(_timerfd, &value, sizeof(value)) > 0) { }
+#endif
+
+	// The node of the previous task goes back to the free list with the next lock, one lock per task.
+	EventLoopTask* done = nullptr;
+
+	while (!maxTasks || count < maxTasks) {
+		EventLoopTask* node;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			if (done) {
+				Recycle(done);
+				done = nullptr;
+			}
+
+			Promote(Now());
+
+			if (!_head) {
+				break;
+			}
+
+			node = _head;
+			_head = static_cast<EventLoopTask*>(node->next);
+			node->state = EventLoopTask::kRunning;
+
+			if (!_head) {
+				_tail = nullptr;
+			}
+		}
+
+		node->task();
+		Release(node);
+		done = node;
+		count++;
+
+		if (maxMicros > 0 && Now() - begin >= maxMicros) {
+			break;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (done) {
+		Recycle(done);
+	}
+
+	Promote(Now());
+	Rearm();
+
+	if (_head) {
+		Signal();
+		return true;
+	}
+
+	return false;
+}
+
+void EventLoopThread::Wait(int timeoutMs) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	int64_t deadline = Now() + static_cast<int64_t>(timeoutMs) * 1000;
+
+	while (true) {
+		int64_t now = Now();
+		Promote(now);
+
+		if (_head || now >= deadline) {
+			return;
+		}
+
+		int64_t until = deadline;
+		int64_t next = _timers.Next();
+
+		if (next != TimerWheel::kNever && next * 1000 < until) {
+			until = next * 1000;
+		}
+
+		_cond.wait_for(lock, std::chrono::microseconds(until - now));
+	}
+}
+
+int EventLoopThread::Fd() const {
+	return _epollfd;
+}
+
+uint64_t EventLoopThread::Post(AsyncTask callback, int64_t delayUs, volatile intptr_t* pending) {
+	if (pending) {
+		base::subtle::NoBarrier_AtomicIncrement(pending, 1);
+	}
+
+	(*_onpost)();
+	return Enqueue(std::move(callback), delayUs, pending);
+}
+
+bool EventLoopThread::Cancel(uint64_t id) {
+	uint32_t index = static_cast<uint32_t>(id);
+	uint32_t generation = static_cast<uint32_t>(id >> 32);
+	EventLoopTask* node;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (!generation || index >= _chunks.size() * kChunkSize) {
+			return false;
+		}
+
+		node = &_chunks[index / kChunkSize][index % kChunkSize];
+
+		if (node->generation != generation || node->state != EventLoopTask::kTimer) {
+			return false;
+		}
+
+		_timers.Remove(node);
+		node->state = EventLoopTask::kRunning;
+		Rearm();
+	}
+
+	Release(node);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	Recycle(node);
+	return true;
+}
+
+void EventLoopThread::PostTaskImpl(absl::AnyInvocable<void()&&> task,
+	const PostTaskTraits& traits,
+	const webrtc::Location& location)
+{
+	(void)traits;
+	(void)location;
+
+	(*_onpost)();
+	Enqueue([task = std::move(task)]() mutable { std::move(task)(); }, 0, nullptr);
+}
+
+void EventLoopThread::PostDelayedTaskImpl(absl::AnyInvocable<void()&&> task,
+	webrtc::TimeDelta delay,
+	const PostDelayedTaskTraits& traits,
+	const webrtc::Location& location)
+{
+	(void)traits;
+	(void)location;
+
+	(*_onpost)();
+	Enqueue([task = std::move(task)]() mutable { std::move(task)(); }, delay.us(), nullptr);
+}
+
+int64_t EventLoopThread::Now() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t EventLoopThread::Tick(int64_t us) {
+	return us / 1000;
+}
+
+EventLoopTask* EventLoopThread::Acquire() {
+	if (!_free) {
+		size_t base = _chunks.size() * kChunkSize;
+		std::unique_ptr<EventLoopTask[]> chunk(new EventLoopTask[kChunkSize]);
+
+		for (size_t offset = kChunkSize; offset-- > 0;) {
+			EventLoopTask* node = &chunk[offset];
+
+			node->index = static_cast<uint32_t>(base + offset);
+			node->generation = 1;
+			node->state = EventLoopTask::kFree;
+			node->pending = nullptr;
+			node->next = _free;
+			_free = node;
+		}
+
+		_chunks.push_back(std::move(chunk));
+	}
+
+	EventLoopTask* node = _free;
+
+	_free = static_cast<EventLoopTask*>(node->next);
+	return node;
+}
+
+void EventLoopThread::Recycle(EventLoopTask* node) {
+	if (!++node->generation) {
+		node->generation = 1;
+	}
+
+	node->state = EventLoopTask::kFree;
+	node->prev = nullptr;
+	node->next = _free;
+	_free = node;
+}
+
+void EventLoopThread::Release(EventLoopTask* node) {
+	// Captures are destroyed outside the lock, their destructors may post again.
+	node->task.Reset();
+
+	if (node->pending) {
+		base::subtle::NoBarrier_AtomicIncrement(node->pending, -1);
+		node->pending = nullptr;
+	}
+}
+
+void EventLoopThread::Append(EventLoopTask* node) {
+	node->state = EventLoopTask::kReady;
+	node->prev = nullptr;
+	node->next = nullptr;
+
+	if (_tail) {
+		_tail->next = node;
+	}
+	else {
+		_head = node;
+	}
+
+	_tail = node;
+}
+
+uint64_t EventLoopThread::Enqueue(AsyncTask task, int64_t delayUs, volatile intptr_t* pending) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	EventLoopTask* node = Acquire();
+
+	node->task = std::move(task);
+	node->pending = pending;
+
+	if (delayUs > 0) {
+		// Rounded up to the next tick, a timer never fires early.
+		int64_t deadline = Now() + delayUs;
+
+		node->expires = Tick(deadline + 999);
+		node->state = EventLoopTask::kTimer;
+
+		bool earliest = node->expires < _timers.Next();
+
+		_timers.Insert(node);
+
+		if (earliest) {
+			Rearm();
+			_cond.notify_all();
+		}
+
+		return (static_cast<uint64_t>(node->generation) << 32) | node->index;
+	}
+
+	bool wakeup = !_head;
+
+	Append(node);
+
+	// Only the empty -> non empty transition has to wake anyone, RunTasks() re-signals leftovers itself.
+	if (wakeup) {
+		Signal();
+		_cond.notify_all();
+	}
+
+	return 0;
+}
+
+void EventLoopThread::Promote(int64_t now) {
+	_timers.Advance(Tick(now), [this](TimerNode* node) {
+		Append(static_cast<EventLoopTask*>(node));
+	});
+}
+
+void EventLoopThread::Signal() {
+#if defined(__linux__)
+	uint64_t value = 1;
+
+	if (_eventfd >= 0 && write(_eventfd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+		RTC_LOG(LS_ERROR) << "EventLoop: eventfd write failed, errno " << errno;
+	}
+#endif
+}
+
+void EventLoopThread::Rearm() {
+#if defined(__linux__)
+	struct itimerspec spec = {};
+
+	if (_timerfd < 0) {
+		return;
+	}
+
+	int64_t next = _timers.Next();
+
+	if (next != TimerWheel::kNever) {
+		// steady_clock is CLOCK_MONOTONIC, deadlines can be handed to the timer as absolute times.
+		int64_t deadline = next * 1000;
+
+		spec.it_value.tv_sec = static_cast<time_t>(deadline / 1000000);
+		spec.it_value.tv_nsec = static_cast<long>((deadline % 1000000) * 1000);
+
+		if (!spec.it_value.tv_sec && !spec.it_value.tv_nsec) {
+			spec.it_value.tv_nsec = 1;
+		}
+	}
+
+	timerfd_settime(_timerfd, TFD_TIMER_ABSTIME, &spec, nullptr);
+#endif
+}
+
+EventLoopInternal::EventLoopInternal(volatile intptr_t* pending) :
+	_events(0),
+	_pending(pending ? pending : &_events),
+	_thread(std::make_unique<EventLoopThread>(&_onpost))
+{
+}
+
+EventLoopInternal::~EventLoopInternal() {
+
+}
+
+bool EventLoopInternal::DispatchEvents(bool kForever) {
+	DispatchScope scope(this);
+	bool result = false;
+
+	do {
+		result = base::subtle::NoBarrier_Load(_pending) > 0;
+
+		if (result) {
+			_thread->RunTasks();
+
+			if (kForever && base::subtle::NoBarrier_Load(_pending) > 0) {
+				_thread->Wait(1000);
+			}
+		}
+	} while (kForever && result);
+
+	return result;
+}
+
+bool EventLoopInternal::DispatchEvents(size_t maxTasks, int64_t maxMicros) {
+	DispatchScope scope(this);
+	return _thread->RunTasks(maxTasks, maxMicros);
+}
+
+int EventLoopInternal::GetFd() const {
+	return _thread->Fd();
+}
+
+AsyncHandle EventLoopInternal::Post(AsyncTask callback, int delayMs) {
+	if (delayMs > 0) {
+		uint64_t id = _thread->Post(std::move(callback), static_cast<int64_t>(delayMs) * 1000, _pending);
+		return AsyncHandle(weak_from_this(), id);
+	}
+
+	_thread->Post(std::move(callback), 0, _pending);
+	return AsyncHandle();
+}
+
+bool EventLoopInternal::Cancel(uint64_t id) {
+	return _thread->Cancel(id);
+}
+
+std::shared_ptr<Event> EventLoopInternal::Hold() {
+	return Event::New(_pending);
+}
+
+void EventLoopInternal::OnPost(const std::function<void()>& callback) {
+	_onpost = callback;
+}
+
+rtc::Thread* EventLoopInternal::GetThread() const {
+	return _thread.get();
+}
+
+std::shared_ptr<EventLoopInternal> EventLoopInternal::Default() {
+	return DefaultLoop()->shared_from_this();
+}
+
+std::shared_ptr<EventLoopInternal> EventLoopInternal::Current() {
+	if (currentLoop) {
+		return currentLoop->shared_from_this();
+	}
+
+	return Default();
+}
+
+std::shared_ptr<EventLoopInternal> EventLoopInternal::From(const std::shared_ptr<EventLoop>& loop) {
+	auto internal = std::dynamic_pointer_cast<EventLoopInternal>(loop);
+
+	if (internal) {
+		return internal;
+	}
+
+	return Current();
+}
+
+EventLoopInternal* EventLoopInternal::Target(const std::shared_ptr<EventLoop>& loop) {
+	if (loop) {
+		if (auto internal = dynamic_cast<EventLoopInternal*>(loop.get())) {
+			return internal;
+		}
+	}
+
+	if (currentLoop) {
+		return currentLoop;
+	}
+
+	return DefaultLoop();
+}
+
+AsyncHandle::AsyncHandle() :
+	_id(0)
+{
+}
+
+AsyncHandle::AsyncHandle(const std::weak_ptr<EventLoop>& loop, uint64_t id) :
+	_loop(loop),
+	_id(id)
+{
+}
+
+bool AsyncHandle::Cancel() {
+	auto loop = std::static_pointer_cast<EventLoopInternal>(_loop.lock());
+	uint64_t id = _id;
+
+	_id = 0;
+	return loop && id && loop->Cancel(id);
+}
+
+std::shared_ptr<EventLoop> EventLoop::New() {
+	return std::make_shared<EventLoopInternal>();
+}
+
+std::shared_ptr<EventLoop> EventLoop::Default() {
+	return EventLoopInternal::Default();
+}
+
+EventLoop::EventLoop() {
+
+}
+
+EventLoop::~EventLoop() {
+
+}
@@ -0,0 +1,167 @@
+#ifndef CRTC_EVENTLOOP_H
+#define CRTC_EVENTLOOP_H
+
+#include "crtc.h"
+#include "event.h"
+#include "timerwheel.h"
+#include "utils.hpp"
+#include "rtc_base/thread.h"
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace crtc {
+	// Queued callback. Nodes live in chunks owned by the loop and are recycled, the callback is stored inline when it
+	// fits AsyncTask. The TimerNode links are used by the timer wheel, the ready list and the free list.
+	struct EventLoopTask : TimerNode {
+		enum State : uint8_t {
+			kFree,
+			kReady,
+			kTimer,
+			kRunning,
+		};
+
+		AsyncTask task;
+		volatile intptr_t* pending;
+		uint32_t index;
+		uint32_t generation; // bumped on recycle, stale handles stop matching
+		State state;
+	};
+
+	// rtc::Thread that is never started. Posted tasks are kept in its own queue so they can be run in bounded
+	// batches by whoever calls EventLoop::DispatchEvents(), on Linux the queue is also signalled through an epoll fd.
+	class EventLoopThread : public rtc::Thread {
+	public:
+		explicit EventLoopThread(synchronized_callback<>* onpost);
+		~EventLoopThread() override;
+
+		// Runs ready tasks until the queue is empty, maxTasks tasks ran or maxMicros passed (0 is unbounded).
+		// Returns true when ready tasks were left behind.
+		bool RunTasks(size_t maxTasks = 0, int64_t maxMicros = 0);
+
+		// Blocks until a task is ready or timeoutMs passed.
+		void Wait(int timeoutMs);
+
+		int Fd() const;
+
+		// Queues callback, pending (when set) is decremented once it ran or was dropped.
+		// Returns the id Cancel() takes, 0 for callbacks that were queued as ready.
+		uint64_t Post(AsyncTask callback, int64_t delayUs, volatile intptr_t* pending);
+
+		// Drops a delayed callback that did not become due yet.
+		bool Cancel(uint64_t id);
+
+	protected:
+		void PostTaskImpl(absl::AnyInvocable<void()&&> task,
+			const PostTaskTraits& traits,
+			const webrtc::Location& location) override;
+
+		void PostDelayedTaskImpl(absl::AnyInvocable<void()&&> task,
+			webrtc::TimeDelta delay,
+			const PostDelayedTaskTraits& traits,
+			const webrtc::Location& location) override;
+
+	private:
+		static int64_t Now();
+
+		// The wheel ticks in milliseconds, timers due within the same millisecond share one wakeup.
+		static int64_t Tick(int64_t us);
+
+		EventLoopTask* Acquire();
+		void Recycle(EventLoopTask* node);
+		void Release(EventLoopTask* node);
+		void Append(EventLoopTask* node);
+
+		uint64_t Enqueue(AsyncTask task, int64_t delayUs, volatile intptr_t* pending);
+		void Promote(int64_t now);
+		void Signal();
+		void Rearm();
+
+		synchronized_callback<>* _onpost;
+
+		std::mutex _mutex;
+		std::condition_variable _cond;
+		EventLoopTask* _head;
+		EventLoopTask* _tail;
+		TimerWheel _timers;
+
+		// Nodes are never freed before the loop is, handles address them by index. Memory follows the peak number
+		// of queued callbacks.
+		static constexpr size_t kChunkSize = 256;
+		std::vector<std::unique_ptr<EventLoopTask[]>> _chunks;
+		EventLoopTask* _free;
+
+		int _epollfd;
+		int _eventfd;
+		int _timerfd;
+	};
+
+	class EventLoopInternal : public EventLoop, public std::enable_shared_from_this<EventLoopInternal> {
+	public:
+		// pending is the counter that keeps DispatchEvents() returning true, the default loop shares ModuleInternal::pending_events.
+		explicit EventLoopInternal(volatile intptr_t* pending = nullptr);
+		virtual ~EventLoopInternal() override;
+
+		bool DispatchEvents(bool kForever = false) override;
+		bool DispatchEvents(size_t maxTasks, int64_t maxMicros) override;
+		int GetFd() const override;
+
+		AsyncHandle Post(AsyncTask callback, int delayMs = 0);
+		bool Cancel(uint64_t id);
+
+		// Keeps the loop alive (DispatchEvents() returning true) for as long as the event exists.
+		std::shared_ptr<Event> Hold();
+
+		void OnPost(const std::function<void()>& callback);
+
+		rtc::Thread* GetThread() const;
+
+		static std::shared_ptr<EventLoopInternal> Default();
+
+		// Loop dispatching on the calling thread, falls back to Default().
+		static std::shared_ptr<EventLoopInternal> Current();
+
+		// Resolves a public loop handle, nullptr resolves to Current().
+		static std::shared_ptr<EventLoopInternal> From(const std::shared_ptr<EventLoop>& loop);
+
+		// Same as From() without the reference count traffic, for posting.
+		static EventLoopInternal* Target(const std::shared_ptr<EventLoop>& loop);
+
+	private:
+		intptr_t _events;
+		volatile intptr_t* _pending;
+		synchronized_callback<> _onpost;
+		std::unique_ptr<EventLoopThread> _thread;
+	};
+
+	template <typename T> struct event_loop_arg { typedef T type; };
+
+	// Calls the callback on loop when the owner is bound to one, inline on the calling thread otherwise.
+	// The callback is copied so the posted call does not depend on the owner still being alive.
+	template <typename... Args> inline void Emit(const std::shared_ptr<EventLoopInternal>& loop, const synchronized_callback<Args...>& callback, typename event_loop_arg<Args>::type... args) {
+		if (!loop) {
+			callback(std::move(args)...);
+		}
+		else if (callback) {
+			synchronized_callback<Args...> target(callback);
+
+			loop->Post([target, args...]() {
+				target(args...);
+			});
+		}
+	}
+
+	// Same for the lock free callbacks on the media and data paths, the posted call runs a snapshot of the function.
+	template <typename... Args> inline void Emit(const std::shared_ptr<EventLoopInternal>& loop, const atomic_callback<Args...>& callback, typename event_loop_arg<Args>::type... args) {
+		if (!loop) {
+			callback(std::move(args)...);
+		}
+		else if (auto target = callback.load()) {
+			loop->Post([target = std::move(target), args...]() {
+				target(args...);
+			});
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,202 @@
+#include "executor.h"
+
+using namespace crtc;
+
+ExecutorInternal::ExecutorInternal(size_t maxQueued) :
+	_maxQueued(maxQueued),
+	_executed(0),
+	_dropped(0),
+	_queued(0),
+	_peakQueued(0)
+{
+}
+
+ExecutorInternal::~ExecutorInternal() {
+
+}
+
+bool ExecutorInternal::IsInline() const {
+	return false;
+}
+
+Executor::Stats ExecutorInternal::GetStats() const {
+	Stats stats;
+
+	stats.executed = _executed.load();
+	stats.dropped = _dropped.load();
+	stats.queued = _queued.load();
+	stats.peakQueued = _peakQueued.load();
+
+	return stats;
+}
+
+std::shared_ptr<ExecutorInternal> ExecutorInternal::From(const std::shared_ptr<Executor>& executor) {
+	return std::dynamic_pointer_cast<ExecutorInternal>(executor);
+}
+
+bool ExecutorInternal::Enter() {
+	size_t queued = _queued.fetch_add(1) + 1;
+
+	if (_maxQueued && queued > _maxQueued) {
+		_queued.fetch_sub(1);
+		_dropped.fetch_add(1);
+		return false;
+	}
+
+	size_t peak = _peakQueued.load();
+
+	while (queued > peak && !_peakQueued.compare_exchange_weak(peak, queued)) { }
+
+	return true;
+}
+
+void ExecutorInternal::Leave() {
+	_queued.fetch_sub(1);
+	_executed.fetch_add(1);
+}
+
+InlineExecutor::InlineExecutor() :
+	ExecutorInternal(0)
+{
+}
+
+bool InlineExecutor::Execute(AsyncTask task) {
+	task();
+	_executed.fetch_add(1);
+	return true;
+}
+
+bool InlineExecutor::IsInline() const {
+	return true;
+}
+
+LoopExecutor::LoopExecutor(const std::shared_ptr<EventLoopInternal>& loop, size_t maxQueued) :
+	ExecutorInternal(maxQueued),
+	_loop(loop)
+{
+}
+
+bool LoopExecutor::Execute(AsyncTask task) {
+	if (!Enter()) {
+		return false;
+	}
+
+	_loop->Post([self = shared_from_this(), task = std::move(task)]() mutable {
+		self->Leave();
+		task();
+	});
+
+	return true;
+}
+
+PoolExecutor::PoolExecutor(size_t threads, size_t maxQueued) :
+	ExecutorInternal(maxQueued),
+	_state(std::make_shared<State>())
+{
+	_state->owner = this;
+	_state->stop = false;
+
+	for (size_t index = 0; index < (threads ? threads : 1); index++) {
+		_threads.emplace_back([state = _state]() {
+			Run(state);
+		});
+	}
+}
+
+PoolExecutor::~PoolExecutor() {
+	{
+		std::lock_guard<std::mutex> lock(_state->mutex);
+		_state->stop = true;
+	}
+
+	_state->cond.notify_all();
+
+	// Joined workers run what is still queued before they exit. The last reference can go away inside a task,
+	// that worker is detached and finishes on its own.
+	for (auto& thread : _threads) {
+		if (thread.get_id() == std::this_thread::get_id()) {
+			thread.detach();
+		}
+		else {
+			thread.join();
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(_state->mutex);
+	_state->owner = nullptr;
+}
+
+bool PoolExecutor::Execute(AsyncTask task) {
+	if (!Enter()) {
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_state->mutex);
+		_state->tasks.push_back(std::move(task));
+	}
+
+	_state->cond.notify_one();
+	return true;
+}
+
+void PoolExecutor::Run(const std::shared_ptr<State>& state) {
+	std::unique_lock<std::mutex> lock(state->mutex);
+
+	while (true) {
+		state->cond.wait(lock, [&state]() {
+			return state->stop || !state->owner || !state->tasks.empty();
+		});
+
+		// Only a detached worker can find tasks without an owner, they are dropped.
+		if (!state->owner) {
+			while (!state->tasks.empty()) {
+				AsyncTask task = std::move(state->tasks.front());
+
+				state->tasks.pop_front();
+				lock.unlock();
+				task.Reset();
+				lock.lock();
+			}
+
+			return;
+		}
+
+		if (state->tasks.empty()) {
+			return;
+		}
+
+		AsyncTask task = std::move(state->tasks.front());
+
+		state->tasks.pop_front();
+
+		// Queue depth counts waiting tasks, the executor is not touched once the task started.
+		state->owner->Leave();
+
+		lock.unlock();
+		task();
+		task.Reset();
+		lock.lock();
+	}
+}
+
+std::shared_ptr<Executor> Executor::Inline() {
+	static std::shared_ptr<Executor> executor = std::make_shared<InlineExecutor>();
+	return executor;
+}
+
+std::shared_ptr<Executor> Executor::Loop(const std::shared_ptr<EventLoop>& loop, size_t maxQueued) {
+	return std::make_shared<LoopExecutor>(EventLoopInternal::From(loop), maxQueued);
+}
+
+std::shared_ptr<Executor> Executor::Pool(size_t threads, size_t maxQueued) {
+	return std::make_shared<PoolExecutor>(threads, maxQueued);
+}
+
+Executor::Executor() {
+
+}
+
+Executor::~Executor() {
+
+}
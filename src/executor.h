@@ -0,0 +1,133 @@
+#ifndef CRTC_EXECUTOR_H
+#define CRTC_EXECUTOR_H
+
+#include "crtc.h"
+#include "eventloop.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace crtc {
+	class ExecutorInternal : public Executor {
+	public:
+		explicit ExecutorInternal(size_t maxQueued);
+		~ExecutorInternal() override;
+
+		// Runs or queues task, false when the queue was full and the task was dropped.
+		virtual bool Execute(AsyncTask task) = 0;
+
+		// Inline executors run the task before Execute() returns, borrowed arguments stay valid.
+		virtual bool IsInline() const;
+
+		Stats GetStats() const override;
+
+		// nullptr for executors that were not created by Executor::Inline/Loop/Pool.
+		static std::shared_ptr<ExecutorInternal> From(const std::shared_ptr<Executor>& executor);
+
+	protected:
+		// Counts a task in the queue, false (and counted as dropped) when maxQueued is reached.
+		bool Enter();
+		void Leave();
+
+		size_t _maxQueued;
+		std::atomic<uint64_t> _executed;
+		std::atomic<uint64_t> _dropped;
+		std::atomic<size_t> _queued;
+		std::atomic<size_t> _peakQueued;
+	};
+
+	class InlineExecutor : public ExecutorInternal {
+	public:
+		explicit InlineExecutor();
+
+		bool Execute(AsyncTask task) override;
+		bool IsInline() const override;
+	};
+
+	class LoopExecutor : public ExecutorInternal, public std::enable_shared_from_this<LoopExecutor> {
+	public:
+		explicit LoopExecutor(const std::shared_ptr<EventLoopInternal>& loop, size_t maxQueued);
+
+		bool Execute(AsyncTask task) override;
+
+	private:
+		std::shared_ptr<EventLoopInternal> _loop;
+	};
+
+	class PoolExecutor : public ExecutorInternal {
+	public:
+		explicit PoolExecutor(size_t threads, size_t maxQueued);
+		~PoolExecutor() override;
+
+		bool Execute(AsyncTask task) override;
+
+	private:
+		// Shared with the workers, a worker that drops the last reference from inside a task outlives the executor.
+		struct State {
+			std::mutex mutex;
+			std::condition_variable cond;
+			std::deque<AsyncTask> tasks;
+			PoolExecutor* owner;
+			bool stop;
+		};
+
+		static void Run(const std::shared_ptr<State>& state);
+
+		std::shared_ptr<State> _state;
+		std::vector<std::thread> _threads;
+	};
+
+	// on* callback cell that remembers whether its registration picked an executor. Routed functions already hand
+	// each call to their executor and are called inline, the others follow the owner's loop through Emit().
+	// The function is stored before the flag is raised and the flag is cleared before a plain function is stored:
+	// a call racing a registration may take one extra hop, a loop bound callback never runs on the webrtc thread.
+	template <template <typename...> class Cell, typename... Args> class routed_callback : public Cell<Args...> {
+	public:
+		using Cell<Args...>::operator=;
+
+		routed_callback() : _routed(false) { }
+
+		void Set(std::function<void(Args...)> func, const std::shared_ptr<Executor>& executor) {
+			auto target = ExecutorInternal::From(executor);
+
+			if (!target || !func) {
+				_routed = false;
+				Cell<Args...>::operator=(std::move(func));
+			}
+			else {
+				SetRouted([target, func](Args... args) {
+					target->Execute([func, args...]() {
+						func(args...);
+					});
+				});
+			}
+		}
+
+		// func hands calls to an executor itself, for callbacks whose arguments have to be copied first.
+		void SetRouted(std::function<void(Args...)> func) {
+			Cell<Args...>::operator=(std::move(func));
+			_routed = true;
+		}
+
+		bool Routed() const {
+			return _routed.load();
+		}
+
+	private:
+		std::atomic<bool> _routed;
+	};
+
+	template <template <typename...> class Cell, typename... Args> inline void Emit(const std::shared_ptr<EventLoopInternal>& loop, const routed_callback<Cell, Args...>& callback, typename event_loop_arg<Args>::type... args) {
+		if (callback.Routed()) {
+			callback(std::move(args)...);
+		}
+		else {
+			Emit(loop, static_cast<const Cell<Args...>&>(callback), std::move(args)...);
+		}
+	}
+}
+
+#endif
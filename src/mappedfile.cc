@@ -0,0 +1,232 @@
+#include "mappedfile.h"
+#include <algorithm>
+#include <limits>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace crtc;
+
+static std::shared_ptr<Error> FileError(const char* message, const std::string& path) {
+	return Error::New((std::string(message) + " " + path).c_str(), __FILE__, __LINE__);
+}
+
+MappedFile::MappedFile() :
+	_data(nullptr),
+	_size(0),
+	_base(nullptr),
+	_mapped(0),
+#if defined(_WIN32)
+	_file(nullptr),
+	_mapping(nullptr)
+#else
+	_fd(-1)
+#endif
+{
+
+}
+
+MappedFile::~MappedFile() {
+#if defined(_WIN32)
+	if (_base) {
+		UnmapViewOfFile(_base);
+	}
+
+	if (_mapping) {
+		CloseHandle(_mapping);
+	}
+
+	if (_file) {
+		CloseHandle(_file);
+	}
+#else
+	if (_base) {
+		munmap(_base, static_cast<size_t>(_mapped));
+	}
+
+	if (_fd >= 0) {
+		close(_fd);
+	}
+#endif
+}
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& path, uint64_t offset, uint64_t length, std::shared_ptr<Error>* error) {
+	std::shared_ptr<MappedFile> file(new MappedFile());
+	uint64_t size = 0;
+
+#if defined(_WIN32)
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	LARGE_INTEGER fileSize;
+
+	if (handle == INVALID_HANDLE_VALUE) {
+		*error = FileError("Unable to open", path);
+		return nullptr;
+	}
+
+	file->_file = handle;
+
+	if (!GetFileSizeEx(handle, &fileSize)) {
+		*error = FileError("Unable to read the size of", path);
+		return nullptr;
+	}
+
+	size = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+	struct stat info;
+
+	file->_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (file->_fd < 0) {
+		*error = FileError("Unable to open", path);
+		return nullptr;
+	}
+
+	if (fstat(file->_fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+		*error = FileError("Unable to read the size of", path);
+		return nullptr;
+	}
+
+	size = static_cast<uint64_t>(info.st_size);
+#endif
+
+	if (offset > size || length > size - offset) {
+		*error = FileError("Range exceeds the end of", path);
+		return nullptr;
+	}
+
+	if (!file->Map(offset, length ? length : size - offset, false, error)) {
+		return nullptr;
+	}
+
+	return file;
+}
+
+std::shared_ptr<MappedFile> MappedFile::Create(const std::string& path, uint64_t size, std::shared_ptr<Error>* error) {
+	std::shared_ptr<MappedFile> file(new MappedFile());
+
+#if defined(_WIN32)
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER end;
+
+	if (handle == INVALID_HANDLE_VALUE) {
+		*error = FileError("Unable to create", path);
+		return nullptr;
+	}
+
+	file->_file = handle;
+	end.QuadPart = static_cast<LONGLONG>(size);
+
+	if (!SetFilePointerEx(handle, end, nullptr, FILE_BEGIN) || !SetEndOfFile(handle)) {
+		*error = FileError("Unable to resize", path);
+		return nullptr;
+	}
+#else
+	file->_fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if (file->_fd < 0) {
+		*error = FileError("Unable to create", path);
+		return nullptr;
+	}
+
+	if (ftruncate(file->_fd, static_cast<off_t>(size)) != 0) {
+		*error = FileError("Unable to resize", path);
+		return nullptr;
+	}
+
+#if defined(__linux__)
+	// Reserves the blocks up front, a full disk then fails here instead of faulting a write to the mapping later.
+	// Filesystems without support for it get a sparse file.
+	int result = posix_fallocate(file->_fd, 0, static_cast<off_t>(size));
+
+	if (result != 0 && result != EOPNOTSUPP && result != EINVAL) {
+		*error = FileError(result == ENOSPC || result == EFBIG ? "Not enough space for" : "Unable to allocate", path);
+		unlink(path.c_str());
+		return nullptr;
+	}
+#endif
+#endif
+
+	if (!file->Map(0, size, true, error)) {
+		return nullptr;
+	}
+
+	return file;
+}
+
+bool MappedFile::Map(uint64_t offset, uint64_t length, bool writable, std::shared_ptr<Error>* error) {
+	if (!length) {
+		return true;
+	}
+
+#if defined(_WIN32)
+	SYSTEM_INFO system;
+
+	GetSystemInfo(&system);
+
+	uint64_t aligned = offset - offset % system.dwAllocationGranularity;
+#else
+	uint64_t aligned = offset - offset % static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+
+	uint64_t mapped = length + (offset - aligned);
+
+	if (mapped > std::numeric_limits<size_t>::max()) {
+		*error = Error::New("File range does not fit in the address space.", __FILE__, __LINE__);
+		return false;
+	}
+
+#if defined(_WIN32)
+	_mapping = CreateFileMappingA(_file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+
+	if (!_mapping) {
+		*error = Error::New("Unable to map file.", __FILE__, __LINE__);
+		return false;
+	}
+
+	_base = MapViewOfFile(_mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, static_cast<DWORD>(aligned >> 32), static_cast<DWORD>(aligned), static_cast<SIZE_T>(mapped));
+
+	if (!_base) {
+		*error = Error::New("Unable to map file.", __FILE__, __LINE__);
+		return false;
+	}
+#else
+	void* base = mmap(nullptr, static_cast<size_t>(mapped), writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, _fd, static_cast<off_t>(aligned));
+
+	if (base == MAP_FAILED) {
+		*error = Error::New("Unable to map file.", __FILE__, __LINE__);
+		return false;
+	}
+
+	_base = base;
+
+	if (!writable) {
+		madvise(_base, static_cast<size_t>(mapped), MADV_SEQUENTIAL);
+	}
+#endif
+
+	_mapped = mapped;
+	_data = static_cast<uint8_t*>(_base) + (offset - aligned);
+	_size = length;
+	return true;
+}
+
+void MappedFile::Prefetch(uint64_t offset, uint64_t length) {
+#if !defined(_WIN32)
+	if (offset >= _size || !length) {
+		return;
+	}
+
+	uint64_t start = static_cast<uint64_t>(_data - static_cast<uint8_t*>(_base)) + offset;
+	uint64_t aligned = start - start % static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+	uint64_t end = std::min<uint64_t>(start + length, _mapped);
+
+	madvise(static_cast<uint8_t*>(_base) + aligned, static_cast<size_t>(end - aligned), MADV_WILLNEED);
+#endif
+}
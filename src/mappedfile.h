@@ -0,0 +1,53 @@
+#ifndef CRTC_MAPPEDFILE_H
+#define CRTC_MAPPEDFILE_H
+
+#include "crtc.h"
+#include <memory>
+#include <string>
+
+namespace crtc {
+	// A range of a file mapped into memory, unmapped when the last reference is gone. Open() maps an existing file
+	// read only for sequential reading, Create() makes (or truncates) a file of size bytes and maps it writable.
+	// Empty ranges are not mapped, Data() is nullptr for them.
+	class MappedFile {
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+	public:
+		~MappedFile();
+
+		// length 0 maps everything from offset to the end of the file.
+		static std::shared_ptr<MappedFile> Open(const std::string& path, uint64_t offset, uint64_t length, std::shared_ptr<Error>* error);
+		static std::shared_ptr<MappedFile> Create(const std::string& path, uint64_t size, std::shared_ptr<Error>* error);
+
+		inline uint8_t* Data() const {
+			return _data;
+		}
+
+		inline uint64_t Size() const {
+			return _size;
+		}
+
+		// Asks the kernel to start reading [offset, offset + length) so a later access does not wait for the disk, does
+		// nothing on Windows.
+		void Prefetch(uint64_t offset, uint64_t length);
+
+	private:
+		explicit MappedFile();
+
+		bool Map(uint64_t offset, uint64_t length, bool writable, std::shared_ptr<Error>* error);
+
+		uint8_t* _data;
+		uint64_t _size;
+		void* _base;
+		uint64_t _mapped;
+#if defined(_WIN32)
+		void* _file;
+		void* _mapping;
+#else
+		int _fd;
+#endif
+	};
+}
+
+#endif
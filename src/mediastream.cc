@@ -29,34 +29,36 @@
 
 using namespace crtc;
 
-std::shared_ptr<MediaStreamInternal> MediaStreamInternal::New(webrtc::MediaStreamInterface* stream) {
+std::shared_ptr<MediaStreamInternal> MediaStreamInternal::New(webrtc::MediaStreamInterface* stream, const std::shared_ptr<EventLoopInternal>& loop) {
 	if (stream) {
-		return std::make_shared<MediaStreamInternal>(stream);
+		return std::make_shared<MediaStreamInternal>(stream, loop);
 	}
 
 	return nullptr;
 }
 
-std::shared_ptr<MediaStreamInternal> MediaStreamInternal::New(rtc::scoped_refptr<webrtc::MediaStreamInterface> stream) {
+std::shared_ptr<MediaStreamInternal> MediaStreamInternal::New(rtc::scoped_refptr<webrtc::MediaStreamInterface> stream, const std::shared_ptr<EventLoopInternal>& loop) {
 	if (stream.get()) {
-		return std::make_shared<MediaStreamInternal>(stream);
+		return std::make_shared<MediaStreamInternal>(stream, loop);
 	}
 
 	return nullptr;
 }
 
-MediaStreamInternal::MediaStreamInternal(webrtc::MediaStreamInterface* stream) :
+MediaStreamInternal::MediaStreamInternal(webrtc::MediaStreamInterface* stream, const std::shared_ptr<EventLoopInternal>& loop) :
+	_loop(loop),
 	_stream(stream)
 {
 	OnChanged();
-	Async::Call([this]() { _stream->RegisterObserver(this); });
+	Async::Call([this]() { _stream->RegisterObserver(this); }, 0, _loop);
 }
 
-MediaStreamInternal::MediaStreamInternal(rtc::scoped_refptr<webrtc::MediaStreamInterface> stream) :
+MediaStreamInternal::MediaStreamInternal(rtc::scoped_refptr<webrtc::MediaStreamInterface> stream, const std::shared_ptr<EventLoopInternal>& loop) :
+	_loop(loop),
 	_stream(stream)
 {
 	OnChanged();
-	Async::Call([this]() { _stream->RegisterObserver(this); });
+	Async::Call([this]() { _stream->RegisterObserver(this); }, 0, _loop);
 }
 
 MediaStreamInternal::~MediaStreamInternal() {
@@ -164,7 +166,7 @@ MediaStreamTracks MediaStreamInternal::GetAudioTracks() const {
 	auto audio_tracks(_stream->GetAudioTracks());
 
 	for (const auto& track : audio_tracks) {
-		tracks.push_back(std::make_shared<MediaStreamTrackInternal>(track.get()));
+		tracks.push_back(std::make_shared<MediaStreamTrackInternal>(track.get(), _loop));
 	}
 
 	return tracks;
@@ -176,19 +178,19 @@ MediaStreamTracks MediaStreamInternal::GetVideoTracks() const {
 	auto video_tracks(_stream->GetVideoTracks());
 
 	for (const auto& track : video_tracks) {
-		tracks.push_back(std::make_shared<MediaStreamTrackInternal>(track.get()));
+		tracks.push_back(std::make_shared<MediaStreamTrackInternal>(track.get(), _loop));
 	}
 
 	return tracks;
 }
 
 std::shared_ptr<MediaStream> MediaStreamInternal::Clone() {
-	return std::make_shared<MediaStreamInternal>(_stream);
+	return std::make_shared<MediaStreamInternal>(_stream, _loop);
 }
 
 void crtc::MediaStreamInternal::ClearObserver()
 {
-	Async::Call([this]() { _stream->UnregisterObserver(this); });
+	Async::Call([this]() { _stream->UnregisterObserver(this); }, 0, _loop);
 
 	for (const auto& audio_track : _audio_tracks) {
 		audio_track->ClearObserver();
@@ -221,7 +223,7 @@ void MediaStreamInternal::OnChanged() {
 			});
 
 		if (it == _audio_tracks.end()) {
-			new_audio_tracks.emplace_back(std::make_shared<MediaStreamTrackInternal>(new_track.get()));
+			new_audio_tracks.emplace_back(std::make_shared<MediaStreamTrackInternal>(new_track.get(), _loop));
 			_onaddtrack(new_audio_tracks.back());
 		}
 	}
@@ -242,7 +244,7 @@ void MediaStreamInternal::OnChanged() {
 			});
 
 		if (it == _video_tracks.end()) {
-			new_video_tracks.emplace_back(std::make_shared<MediaStreamTrackInternal>(new_track.get()));
+			new_video_tracks.emplace_back(std::make_shared<MediaStreamTrackInternal>(new_track.get(), _loop));
 			_onaddtrack(new_video_tracks.back());
 		}
 	}
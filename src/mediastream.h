@@ -35,12 +35,12 @@ namespace crtc {
 	class MediaStreamInternal : public MediaStream, public webrtc::ObserverInterface {
 
 	public:
-		explicit MediaStreamInternal(webrtc::MediaStreamInterface* stream);
-		explicit MediaStreamInternal(rtc::scoped_refptr<webrtc::MediaStreamInterface> stream = nullptr);
+		explicit MediaStreamInternal(webrtc::MediaStreamInterface* stream, const std::shared_ptr<EventLoopInternal>& loop = nullptr);
+		explicit MediaStreamInternal(rtc::scoped_refptr<webrtc::MediaStreamInterface> stream = nullptr, const std::shared_ptr<EventLoopInternal>& loop = nullptr);
 		virtual ~MediaStreamInternal() override;
 
-		static std::shared_ptr<MediaStreamInternal> New(webrtc::MediaStreamInterface* stream);
-		static std::shared_ptr<MediaStreamInternal> New(rtc::scoped_refptr<webrtc::MediaStreamInterface> stream);
+		static std::shared_ptr<MediaStreamInternal> New(webrtc::MediaStreamInterface* stream, const std::shared_ptr<EventLoopInternal>& loop = nullptr);
+		static std::shared_ptr<MediaStreamInternal> New(rtc::scoped_refptr<webrtc::MediaStreamInterface> stream, const std::shared_ptr<EventLoopInternal>& loop = nullptr);
 
 		String Id() const override;
 		std::string IdString() const;
@@ -63,6 +63,7 @@ namespace crtc {
 		void OnChanged() override;
 
 	protected:
+		std::shared_ptr<EventLoopInternal> _loop;
 		rtc::scoped_refptr<webrtc::MediaStreamInterface> _stream;
 		std::vector<std::shared_ptr<MediaStreamTrackInternal>> _audio_tracks;
 		std::vector<std::shared_ptr<MediaStreamTrackInternal>> _video_tracks;
@@ -74,7 +74,8 @@ webrtc::MediaStreamTrackInterface* MediaStreamTrackInternal::New(const std::shar
 }
 */
 
-MediaStreamTrackInternal::MediaStreamTrackInternal(webrtc::MediaStreamTrackInterface* track) :
+MediaStreamTrackInternal::MediaStreamTrackInternal(webrtc::MediaStreamTrackInterface* track, const std::shared_ptr<EventLoopInternal>& loop) :
+	_loop(loop),
 	_track(track)
 {
 	_kind = track->kind() == webrtc::MediaStreamTrackInterface::kAudioKind ? MediaStreamTrack::kAudio : MediaStreamTrack::kVideo;
@@ -84,7 +85,7 @@ MediaStreamTrackInternal::MediaStreamTrackInternal(webrtc::MediaStreamTrackInter
 		webrtc::AudioTrackInterface* audio = static_cast<webrtc::AudioTrackInterface*>(track);
 		Async::Call([=]() {
 			track->RegisterObserver(this);
-		});
+		}, 0, _loop);
 		_state = audio->GetSource()->state();
 		audio->AddSink(this);
 	}
@@ -94,7 +95,7 @@ MediaStreamTrackInternal::MediaStreamTrackInternal(webrtc::MediaStreamTrackInter
 
 		Async::Call([=]() {
 			track->RegisterObserver(this);
-		});
+		}, 0, _loop);
 		_state = video->GetSource()->state();
 		rtc::VideoSinkWants wants;
 		video->AddOrUpdateSink(this, wants);
@@ -120,15 +121,26 @@ MediaStreamTrackInternal::~MediaStreamTrackInternal() {
 
 void MediaStreamTrackInternal::OnData(const void* audio_data, int bits_per_sample, int sample_rate, size_t number_of_channels, size_t number_of_frames)
 {
-	_onAudio(audio_data, bits_per_sample, sample_rate, number_of_channels, number_of_frames);
+	if (!_loop || _onAudio.Routed()) {
+		_onAudio(audio_data, bits_per_sample, sample_rate, number_of_channels, number_of_frames);
+	}
+	else if (auto callback = _onAudio.load()) {
+		// audio_data is only valid during this call, the loop gets a copy of the samples.
+		const uint8_t* begin = static_cast<const uint8_t*>(audio_data);
+		auto samples = std::make_shared<std::vector<uint8_t>>(begin, begin + (bits_per_sample / 8) * number_of_channels * number_of_frames);
+
+		_loop->Post([=]() {
+			callback(samples->data(), bits_per_sample, sample_rate, number_of_channels, number_of_frames);
+		});
+	}
 }
 
 void MediaStreamTrackInternal::OnFrame(const webrtc::VideoFrame& frame) {
-	_onVideo(std::make_shared<VideoFrameInternal>(frame));
+	Emit(_loop, _onVideo, std::make_shared<VideoFrameInternal>(frame));
 }
 
 void MediaStreamTrackInternal::OnDiscardedFrame() {
-	_onFrameDrop();
+	Emit(_loop, _onFrameDrop);
 }
 
 void MediaStreamTrackInternal::OnConstraintsChanged(const webrtc::VideoTrackSourceConstraints& constraints) {
@@ -136,19 +148,19 @@ void MediaStreamTrackInternal::OnConstraintsChanged(const webrtc::VideoTrackSour
 }
 
 void MediaStreamTrackInternal::OnStarted() {
-	_onstarted();
+	Emit(_loop, _onstarted);
 }
 
 void MediaStreamTrackInternal::OnUnMute() {
-	_onunmute();
+	Emit(_loop, _onunmute);
 }
 
 void MediaStreamTrackInternal::OnMute() {
-	_onmute();
+	Emit(_loop, _onmute);
 }
 
 void MediaStreamTrackInternal::OnEnded() {
-	_onended();
+	Emit(_loop, _onended);
 }
 
 bool MediaStreamTrackInternal::Enabled() const {
@@ -186,39 +198,54 @@ MediaStreamTrack::State MediaStreamTrackInternal::ReadyState() const {
 	return MediaStreamTrack::kLive;
 }
 
-void crtc::MediaStreamTrackInternal::onStarted(std::function<void()> callback)
+void crtc::MediaStreamTrackInternal::onStarted(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onstarted = callback;
+	_onstarted.Set(callback, executor);
 }
 
-void crtc::MediaStreamTrackInternal::onEnded(std::function<void()> callback)
+void crtc::MediaStreamTrackInternal::onEnded(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onended = callback;
+	_onended.Set(callback, executor);
 }
 
-void crtc::MediaStreamTrackInternal::onMute(std::function<void()> callback)
+void crtc::MediaStreamTrackInternal::onMute(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onmute = callback;
+	_onmute.Set(callback, executor);
 }
 
-void crtc::MediaStreamTrackInternal::onUnmute(std::function<void()> callback)
+void crtc::MediaStreamTrackInternal::onUnmute(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onunmute = callback;
+	_onunmute.Set(callback, executor);
 }
 
-void crtc::MediaStreamTrackInternal::onAudio(std::function<void(const void*, int, int, size_t, size_t)> callback)
+void crtc::MediaStreamTrackInternal::onAudio(std::function<void(const void*, int, int, size_t, size_t)> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onAudio = callback;
+	auto target = ExecutorInternal::From(executor);
+
+	if (!target || target->IsInline() || !callback) {
+		_onAudio.Set(callback, executor);
+		return;
+	}
+
+	// audio_data is only valid during the call, the executor gets a copy of the samples.
+	_onAudio.SetRouted([target, callback](const void* audio_data, int bits_per_sample, int sample_rate, size_t number_of_channels, size_t number_of_frames) {
+		const uint8_t* begin = static_cast<const uint8_t*>(audio_data);
+		auto samples = std::make_shared<std::vector<uint8_t>>(begin, begin + (bits_per_sample / 8) * number_of_channels * number_of_frames);
+
+		target->Execute([=]() {
+			callback(samples->data(), bits_per_sample, sample_rate, number_of_channels, number_of_frames);
+		});
+	});
 }
 
-void crtc::MediaStreamTrackInternal::onVideo(std::function<void(std::shared_ptr<VideoFrame>)> callback)
+void crtc::MediaStreamTrackInternal::onVideo(std::function<void(std::shared_ptr<VideoFrame>)> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onVideo = callback;
+	_onVideo.Set(callback, executor);
 }
 
-void crtc::MediaStreamTrackInternal::onFrameDrop(std::function<void()> callback)
+void crtc::MediaStreamTrackInternal::onFrameDrop(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onFrameDrop = callback;
+	_onFrameDrop.Set(callback, executor);
 }
 
 rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> MediaStreamTrackInternal::GetTrack() const {
@@ -239,7 +266,7 @@ void crtc::MediaStreamTrackInternal::ClearObserver()
 {
 	auto source = GetSource();
 	if(source)
-		Async::Call([=]() { _track->UnregisterObserver(this); });
+		Async::Call([=]() { _track->UnregisterObserver(this); }, 0, _loop);
 }
 
 MediaStreamTrack::MediaStreamTrack() {
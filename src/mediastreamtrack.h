@@ -29,6 +29,8 @@
 
 #include "crtc.h"
 #include "utils.hpp"
+#include "eventloop.h"
+#include "executor.h"
 #include <api/media_stream_interface.h>
 
 namespace crtc {
@@ -36,7 +38,7 @@ namespace crtc {
 		webrtc::AudioTrackSinkInterface, rtc::VideoSinkInterface<webrtc::VideoFrame> {
 
 	public:
-		MediaStreamTrackInternal(webrtc::MediaStreamTrackInterface* track);
+		MediaStreamTrackInternal(webrtc::MediaStreamTrackInterface* track, const std::shared_ptr<EventLoopInternal>& loop = nullptr);
 		virtual ~MediaStreamTrackInternal() override;
 
 		bool Enabled() const override;
@@ -47,13 +49,13 @@ namespace crtc {
 		MediaStreamTrack::Type Kind() const override;
 		MediaStreamTrack::State ReadyState() const override;
 
-		void onStarted(std::function<void()> callback) override;
-		void onEnded(std::function<void()> callback) override;
-		void onMute(std::function<void()> callback) override;
-		void onUnmute(std::function<void()> callback) override;
-		void onAudio(std::function<void(const void*, int, int, size_t, size_t)> callback) override;
-		void onVideo(std::function<void(std::shared_ptr<VideoFrame>)> callback) override;
-		void onFrameDrop(std::function<void()> callback) override;
+		void onStarted(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onEnded(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onMute(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onUnmute(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onAudio(std::function<void(const void*, int, int, size_t, size_t)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onVideo(std::function<void(std::shared_ptr<VideoFrame>)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onFrameDrop(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
 
 		rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> GetTrack() const;
 		webrtc::MediaSourceInterface* GetSource() const;
@@ -74,18 +76,19 @@ namespace crtc {
 		virtual void OnEnded();
 
 		MediaStreamTrack::Type _kind;
+		std::shared_ptr<EventLoopInternal> _loop;
 		rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> _track;
 		//rtc::scoped_refptr<webrtc::MediaSourceInterface> _source;
 		webrtc::MediaSourceInterface::SourceState _state;
 
-		synchronized_callback<> _onstarted;
-		synchronized_callback<> _onended;
-		synchronized_callback<> _onmute;
-		synchronized_callback<> _onunmute;
+		routed_callback<synchronized_callback> _onstarted;
+		routed_callback<synchronized_callback> _onended;
+		routed_callback<synchronized_callback> _onmute;
+		routed_callback<synchronized_callback> _onunmute;
 
-		synchronized_callback<const void*, int, int, size_t, size_t> _onAudio;
-		synchronized_callback<std::shared_ptr<VideoFrame>> _onVideo;
-		synchronized_callback<> _onFrameDrop;
+		routed_callback<atomic_callback, const void*, int, int, size_t, size_t> _onAudio;
+		routed_callback<atomic_callback, std::shared_ptr<VideoFrame>> _onVideo;
+		routed_callback<atomic_callback> _onFrameDrop;
 	};
 }
 
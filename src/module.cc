@@ -25,11 +25,11 @@
 
 #include "crtc.h"
 #include "module.h"
+#include "eventloop.h"
 #include "rtcpeerconnection.h"
+#include "rtcpeerconnectionfactory.h"
 #include "rtc_base/thread.h"
 #include "rtc_base/ssl_adapter.h"
-#include "rtc_base/physical_socket_server.h"
-#include <base/atomicops.h>
 
 #if defined(_MSC_VER)
     #include "rtc_base/win32_socket_init.h"
@@ -38,39 +38,9 @@
 using namespace crtc;
 
 volatile intptr_t ModuleInternal::pending_events = 0;
-synchronized_callback<> asyncCallback;
-
-class Thread : public rtc::AutoThread {
-public:
-    Thread() : rtc::AutoThread() {
-    }
-
-    ~Thread() {
-        rtc::Thread::Stop();
-    }
-
-    virtual void PostTaskImpl(absl::AnyInvocable<void()&&> task,
-        const PostTaskTraits& traits,
-        const webrtc::Location& location) override
-    {
-        asyncCallback();
-        rtc::Thread::PostTaskImpl(std::move(task), traits, location);
-    }
-
-    virtual void PostDelayedTaskImpl(absl::AnyInvocable<void()&&> task,
-        webrtc::TimeDelta delay,
-        const PostDelayedTaskTraits& traits,
-        const webrtc::Location& location) override
-    {
-        asyncCallback();
-        rtc::Thread::PostDelayedTaskImpl(std::move(task), delay, traits, location);
-    }
-};
-
-Thread currentThread;
 
 void Module::Init() {
-    rtc::ThreadManager::Instance()->SetCurrentThread(&currentThread);
+    rtc::ThreadManager::Instance()->SetCurrentThread(EventLoopInternal::Default()->GetThread());
 //#ifdef NDEBUG
 //    rtc::LogMessage::LogToDebug(rtc::LS_ERROR);
 //#else
@@ -80,35 +50,30 @@ void Module::Init() {
 }
 
 void Module::Dispose() {
+	RTCPeerConnectionFactoryInternal::Dispose();
 	rtc::CleanupSSL();
 }
 
 bool Module::DispatchEvents(bool kForever) {
-	bool result = false;
-	//rtc::Thread* thread = rtc::ThreadManager::Instance()->CurrentThread();
+	return EventLoopInternal::Default()->DispatchEvents(kForever);
+}
 
-	do {
-		result = (base::subtle::NoBarrier_Load(&ModuleInternal::pending_events) > 0 && currentThread.ProcessMessages(kForever ? 1000 : 0));
-	} while (kForever && result);
+bool Module::DispatchEvents(size_t maxTasks, int64_t maxMicros) {
+	return EventLoopInternal::Default()->DispatchEvents(maxTasks, maxMicros);
+}
 
-	return result;
+int Module::GetFd() {
+	return EventLoopInternal::Default()->GetFd();
 }
 
 void Module::RegisterAsyncCallback(const std::function<void()>& callback) {
-    asyncCallback = callback;
+    EventLoopInternal::Default()->OnPost(callback);
 }
 
 void Module::UnregisterAsyncCallback() {
-    asyncCallback = nullptr;
+    EventLoopInternal::Default()->OnPost(nullptr);
 }
 
-void Async::Call(std::function<void()> callback, int delayMs) {
-    //rtc::Thread* target = rtc::ThreadManager::Instance()->CurrentThread();
-    auto event = Event::New();
-    if (delayMs > 0) {
-        currentThread.PostDelayedTask([callback, event]() { callback(); }, webrtc::TimeDelta::Millis(delayMs));
-    }
-    else {
-        currentThread.PostTask([callback, event]() { callback(); });
-    }
+AsyncHandle Async::Call(AsyncTask callback, int delayMs, const std::shared_ptr<EventLoop>& loop) {
+    return EventLoopInternal::Target(loop)->Post(std::move(callback), delayMs);
 }
@@ -1,108 +1,217 @@
 #ifndef CRTC_PROMISE_H
 #define CRTC_PROMISE_H
 
+#include <functional>
 #include <memory>
-#include <condition_variable>
 #include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 namespace crtc {
+	// Callback list that keeps the first entry inline, promise chains rarely register more than one per kind.
+	template <typename... Args> class PromiseCallbacks {
+	public:
+		template <typename F> inline void Add(F&& callback) {
+			if (!_first) {
+				_first = std::forward<F>(callback);
+			}
+			else {
+				_more.emplace_back(std::forward<F>(callback));
+			}
+		}
+
+		inline void Call(const Args&... args) const {
+			if (_first) {
+				_first(args...);
+			}
+
+			for (const auto& callback : _more) {
+				callback(args...);
+			}
+		}
+
+		inline void Swap(PromiseCallbacks<Args...>& other) {
+			_first.swap(other._first);
+			_more.swap(other._more);
+		}
+
+	private:
+		std::function<void(Args...)> _first;
+		std::vector<std::function<void(Args...)>> _more;
+	};
+
 	/// \sa https://developer.mozilla.org/en/docs/Web/JavaScript/Reference/Global_Objects/Promise
+	///
+	/// One allocation per promise: resolve and reject are small handles on the shared state instead of std::function
+	/// wrappers, continuations are stored inline and Then/Catch/Finally after settling run immediately.
 
 	template <typename... Args> class Promise {
-		Promise<Args...>(const Promise<Args...>&) = delete;
-		Promise<Args...>& operator=(const Promise<Args...>&) = delete;
+		Promise(const Promise&) = delete;
+		Promise& operator=(const Promise&) = delete;
 
 	public:
-		typedef std::function<void(Args...)> FullFilledCallback;
+		class FullFilledCallback {
+		public:
+			explicit FullFilledCallback(const std::shared_ptr<Promise<Args...>>& promise = nullptr) : _promise(promise) { }
+
+			inline void operator()(Args... args) const {
+				if (_promise) {
+					_promise->Resolve(std::move(args)...);
+				}
+			}
+
+		private:
+			std::shared_ptr<Promise<Args...>> _promise;
+		};
+
+		class RejectedCallback {
+		public:
+			explicit RejectedCallback(const std::shared_ptr<Promise<Args...>>& promise = nullptr) : _promise(promise) { }
+
+			inline void operator()(const std::shared_ptr<Error>& error) const {
+				if (_promise) {
+					_promise->Reject(error);
+				}
+			}
+
+		private:
+			std::shared_ptr<Promise<Args...>> _promise;
+		};
+
 		typedef std::function<void()> FinallyCallback;
-		typedef std::function<void(std::shared_ptr<Error>)> RejectedCallback;
 		typedef std::function<void(const FullFilledCallback&, const RejectedCallback&)> ExecutorCallback;
 
-		explicit Promise() { }
+		explicit Promise() : _state(kPending) { }
 		virtual ~Promise() { }
 
-		inline static std::shared_ptr<Promise<Args...>> New(const ExecutorCallback& executor) {
+		template <typename Executor> inline static std::shared_ptr<Promise<Args...>> New(Executor&& executor, const std::shared_ptr<EventLoop>& loop = nullptr) {
 			auto self = std::make_shared<Promise<Args...>>();
+			FullFilledCallback resolve(self);
+			RejectedCallback reject(self);
 
-			RejectedCallback reject([=](const std::shared_ptr<Error>& error) {
-				if (self) {
-					for (const auto& callback : self->_onreject) {
-						callback(error);
-					}
+			if (IsValid(executor)) {
+				Async::Call([resolve, reject, executor = std::forward<Executor>(executor)]() { executor(resolve, reject); }, 0, loop);
+			}
+			else {
+				Async::Call([reject]() { reject(Error::New("Invalid Executor Callback.", __FILE__, __LINE__)); }, 0, loop);
+			}
 
-					for (const auto& callback : self->_onfinally) {
-						callback();
-					}
+			return self;
+		}
 
-					self->_completed = true;
-					self->_onfinally.clear();
-					self->_onreject.clear();
-					self->_onresolve.clear();
+		template <typename F> inline Promise<Args...>* Then(F&& callback) {
+			std::unique_lock<std::mutex> lock(_mutex);
 
-                    self->_cnd.notify_all();
-				}
-			});
+			if (_state == kPending) {
+				_onresolve.Add(std::forward<F>(callback));
+			}
+			else if (_state == kResolved) {
+				lock.unlock();
+				std::apply(callback, *_value);
+			}
 
-			FullFilledCallback resolve([=](Args... args) {
-				if (self) {
-					for (const auto& callback : self->_onresolve) {
-						callback(std::move(args)...);
-					}
+			return this;
+		}
 
-					for (const auto& callback : self->_onfinally) {
-						callback();
-					}
+		template <typename F> inline Promise<Args...>* Catch(F&& callback) {
+			std::unique_lock<std::mutex> lock(_mutex);
 
-					self->_completed = true;
+			if (_state == kPending) {
+				_onreject.Add(std::forward<F>(callback));
+			}
+			else if (_state == kRejected) {
+				lock.unlock();
+				callback(_error);
+			}
 
-					self->_onfinally.clear();
-					self->_onreject.clear();
-					self->_onresolve.clear();
-                    self->_cnd.notify_all();
-				}
-			});
+			return this;
+		}
 
+		template <typename F> inline Promise<Args...>* Finally(F&& callback) {
+			std::unique_lock<std::mutex> lock(_mutex);
 
-			if (executor) {
-				Async::Call([=]() { executor(resolve, reject); });
+			if (_state == kPending) {
+				_onfinally.Add(std::forward<F>(callback));
 			}
 			else {
-				Async::Call([=]() { reject(Error::New("Invalid Executor Callback.", __FILE__, __LINE__)); });
+				lock.unlock();
+				callback();
 			}
 
-			return self;
-		}
-
-		inline Promise<Args...>* Then(const FullFilledCallback& callback) {
-			_onresolve.push_back(callback);
 			return this;
 		}
 
-		inline Promise<Args...>* Catch(const RejectedCallback& callback) {
-			_onreject.push_back(callback);
-			return this;
+	private:
+		enum State {
+			kPending,
+			kResolved,
+			kRejected,
+		};
+
+		template <typename F> inline static bool IsValid(const F& executor) {
+			if constexpr (std::is_constructible<bool, const F&>::value) {
+				return static_cast<bool>(executor);
+			}
+			else {
+				return true;
+			}
 		}
 
-		inline Promise<Args...>* Finally(const FinallyCallback& callback) {
-			_onfinally.push_back(callback);
-			return this;
+		inline void Resolve(Args... args) {
+			PromiseCallbacks<Args...> onresolve;
+			PromiseCallbacks<> onfinally;
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+
+				if (_state != kPending) {
+					return;
+				}
+
+				_state = kResolved;
+				_value.emplace(std::move(args)...);
+				onresolve.Swap(_onresolve);
+				onfinally.Swap(_onfinally);
+				_onreject = PromiseCallbacks<std::shared_ptr<Error>>();
+			}
+
+			std::apply([&onresolve](const Args&... values) { onresolve.Call(values...); }, *_value);
+			onfinally.Call();
 		}
 
-		inline Promise<Args...>* WaitForResult() {
-			std::unique_lock<std::mutex> lk(_mtx);
-			_cnd.wait(lk, [=] { return _completed; });
-			return this;
+		inline void Reject(const std::shared_ptr<Error>& error) {
+			PromiseCallbacks<std::shared_ptr<Error>> onreject;
+			PromiseCallbacks<> onfinally;
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+
+				if (_state != kPending) {
+					return;
+				}
+
+				_state = kRejected;
+				_error = error;
+				onreject.Swap(_onreject);
+				onfinally.Swap(_onfinally);
+				_onresolve = PromiseCallbacks<Args...>();
+			}
+
+			onreject.Call(error);
+			onfinally.Call();
 		}
 
-	private:
-		std::condition_variable _cnd;
-		std::mutex _mtx;
-		bool _completed;
+		std::mutex _mutex;
+		State _state;
+		std::optional<std::tuple<Args...>> _value;
+		std::shared_ptr<Error> _error;
 
-		std::vector<FullFilledCallback> _onresolve;
-		std::vector<RejectedCallback> _onreject;
-		std::vector<FinallyCallback> _onfinally;
+		PromiseCallbacks<Args...> _onresolve;
+		PromiseCallbacks<std::shared_ptr<Error>> _onreject;
+		PromiseCallbacks<> _onfinally;
 	};
 }
 
-#endif
\ No newline at end of file
+#endif
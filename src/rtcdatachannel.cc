@@ -25,24 +25,165 @@
 
 #include "crtc.h"
 #include "rtcdatachannel.h"
-#include "arraybuffer.h"
+#include "rtc_base/time_utils.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
 
 using namespace crtc;
 
-RTCDataChannelInternal::RTCDataChannelInternal(const rtc::scoped_refptr<webrtc::DataChannelInterface>& channel) :
+// Framed mode chunk header, little endian: magic, flags, 2 reserved bytes, message id, offset and total length.
+static const size_t kFrameHeader = 24;
+static const uint8_t kFrameMagic = 0xCF;
+static const uint8_t kFrameBinary = 0x01;
+
+// Messages one drain task delivers before it yields the loop to other tasks.
+static const size_t kDrainBatch = 64;
+
+static void WriteFrameHeader(uint8_t* header, uint32_t id, uint64_t offset, uint64_t total, bool binary) {
+	header[0] = kFrameMagic;
+	header[1] = binary ? kFrameBinary : 0;
+	header[2] = 0;
+	header[3] = 0;
+
+	for (size_t index = 0; index < 4; index++) {
+		header[4 + index] = static_cast<uint8_t>(id >> (index * 8));
+	}
+
+	for (size_t index = 0; index < 8; index++) {
+		header[8 + index] = static_cast<uint8_t>(offset >> (index * 8));
+		header[16 + index] = static_cast<uint8_t>(total >> (index * 8));
+	}
+}
+
+static bool ReadFrameHeader(const uint8_t* header, size_t size, uint32_t* id, uint64_t* offset, uint64_t* total, bool* binary) {
+	if (size < kFrameHeader || header[0] != kFrameMagic) {
+		return false;
+	}
+
+	*id = 0;
+	*offset = 0;
+	*total = 0;
+	*binary = (header[1] & kFrameBinary) != 0;
+
+	for (size_t index = 0; index < 4; index++) {
+		*id |= static_cast<uint32_t>(header[4 + index]) << (index * 8);
+	}
+
+	for (size_t index = 0; index < 8; index++) {
+		*offset |= static_cast<uint64_t>(header[8 + index]) << (index * 8);
+		*total |= static_cast<uint64_t>(header[16 + index]) << (index * 8);
+	}
+
+	return *offset <= *total && size - kFrameHeader <= *total - *offset;
+}
+
+// Records [begin, end) in ranges, false when it overlaps a span that was already received.
+static bool AddRange(std::map<uint64_t, uint64_t>* ranges, uint64_t begin, uint64_t end) {
+	auto next = ranges->lower_bound(begin);
+
+	if (next != ranges->end() && next->first < end) {
+		return false;
+	}
+
+	auto previous = next == ranges->begin() ? ranges->end() : std::prev(next);
+
+	if (previous != ranges->end() && previous->second > begin) {
+		return false;
+	}
+
+	if (previous != ranges->end() && previous->second == begin) {
+		previous->second = end;
+	}
+	else {
+		previous = ranges->emplace_hint(next, begin, end);
+	}
+
+	if (next != ranges->end() && next->first == end) {
+		previous->second = next->second;
+		ranges->erase(next);
+	}
+
+	return true;
+}
+
+RTCDataChannelInternal::RTCDataChannelInternal(const rtc::scoped_refptr<webrtc::DataChannelInterface>& channel, const std::shared_ptr<EventLoopInternal>& loop, rtc::Thread* network) :
 	_threshold(0),
-	_channel(channel)
+	_observed(0),
+	_state(webrtc::DataChannelInterface::kConnecting),
+	_wire(0),
+	_framedPending(0),
+	_maxReassembly(0),
+	_reassemblyTimeout(0),
+	_framed(false),
+	_receiveControl(false),
+	_overflowed(false),
+	_receiveHighWaterMark(kDefaultReceiveHighWaterMark),
+	_network(network),
+	_queue(std::make_shared<SendQueue>()),
+	_receive(std::make_shared<ReceiveQueue>()),
+	_loop(loop),
+	_channel(channel),
+	_nextFrameId(0),
+	_assembled(0),
+	_nextExpiry(0),
+	_flowToken(0)
 {
+	_queue->owner = this;
+	_queue->queued = 0;
+	_queue->sent = [this]() {
+		OnFlow();
+	};
+
+	_receive->owner = this;
+	_receive->amount = 0;
+	_receive->paused = false;
+	_receive->draining = false;
+
+	_state.store(_channel->state());
+
+	std::string protocol = _channel->protocol();
+	RTCPeerConnection::RTCDataChannelInit defaults;
+
+	if (DataChannelCompressor::Negotiated(protocol)) {
+		_compressor = std::make_shared<DataChannelCompressor>(this, defaults.compressionThreshold, defaults.compressionLevel);
+	}
+
+	if (DataChannelCoalescer::Negotiated(DataChannelCompressor::Strip(protocol))) {
+		_coalescer = std::make_shared<DataChannelCoalescer>(this, _network, defaults.coalescingDelay, defaults.coalescingMaxSize);
+	}
+
 	_channel->RegisterObserver(this);
 
 	if (_channel->state() == webrtc::DataChannelInterface::kOpen ||
 		_channel->state() == webrtc::DataChannelInterface::kConnecting)
 	{
-		_event = Event::New();
+		_event = _loop ? _loop->Hold() : Event::New();
 	}
 }
 
 RTCDataChannelInternal::~RTCDataChannelInternal() {
+	if (_coalescer) {
+		_coalescer->Detach();
+	}
+
+	if (_compressor) {
+		_compressor->Detach();
+	}
+
+	_queue->sent = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock(_queue->mutex);
+		_queue->owner = nullptr;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_receive->mutex);
+		_receive->owner = nullptr;
+		_receive->messages.clear();
+	}
+
 	_channel->UnregisterObserver();
 }
 
@@ -55,15 +196,56 @@ String RTCDataChannelInternal::Label() {
 }
 
 uint64_t RTCDataChannelInternal::BufferedAmount() {
-	return _channel->buffered_amount();
+	return _channel->buffered_amount() + _queue->queued.load() + _framedPending.load();
 }
 
 uint64_t RTCDataChannelInternal::BufferedAmountLowThreshold() {
-	return _threshold;
+	return _threshold.load();
 }
 
 void RTCDataChannelInternal::SetBufferedAmountLowThreshold(uint64_t threshold) {
-	_threshold = threshold;
+	_threshold.store(threshold);
+}
+
+void RTCDataChannelInternal::Pause() {
+	_receiveControl.store(true);
+
+	std::lock_guard<std::mutex> lock(_receive->mutex);
+	_receive->paused = true;
+}
+
+void RTCDataChannelInternal::Resume() {
+	{
+		std::lock_guard<std::mutex> lock(_receive->mutex);
+
+		_receive->paused = false;
+
+		if (_receive->draining || _receive->messages.empty()) {
+			return;
+		}
+
+		_receive->draining = true;
+	}
+
+	ScheduleDrain();
+}
+
+bool RTCDataChannelInternal::Paused() {
+	std::lock_guard<std::mutex> lock(_receive->mutex);
+	return _receive->paused;
+}
+
+uint64_t RTCDataChannelInternal::ReceivedAmount() {
+	return _receive->amount.load();
+}
+
+uint64_t RTCDataChannelInternal::ReceiveHighWaterMark() {
+	return _receiveHighWaterMark.load();
+}
+
+void RTCDataChannelInternal::SetReceiveHighWaterMark(uint64_t highWaterMark) {
+	_receiveHighWaterMark.store(highWaterMark);
+	_receiveControl.store(true);
 }
 
 uint16_t RTCDataChannelInternal::MaxPacketLifeTime() {
@@ -83,7 +265,7 @@ bool RTCDataChannelInternal::Ordered() {
 }
 
 String RTCDataChannelInternal::Protocol() {
-	return String(_channel->protocol().c_str());
+	return String(DataChannelCoalescer::Strip(DataChannelCompressor::Strip(_channel->protocol())).c_str());
 }
 
 RTCDataChannel::State RTCDataChannelInternal::ReadyState() {
@@ -105,130 +287,965 @@ void RTCDataChannelInternal::Close() {
 }
 
 void RTCDataChannelInternal::Send(const std::shared_ptr<ArrayBuffer>& data, bool binary) {
-	rtc::CopyOnWriteBuffer buffer(data->Data(), data->ByteLength());
-	webrtc::DataBuffer dataBuffer(buffer, binary);
+	if (!_framed.load()) {
+		Enqueue(webrtc::DataBuffer(ToRtcBuffer(data), binary));
+		return;
+	}
 
-	if (!_channel->Send(dataBuffer)) {
-		switch (_channel->state()) {
-		case webrtc::DataChannelInterface::kConnecting:
-			_onerror(Error::New("Unable to send arraybuffer. DataChannel is connecting", __FILE__, __LINE__));
-			break;
-		case webrtc::DataChannelInterface::kOpen:
-			_onerror(Error::New("Unable to send arraybuffer.", __FILE__, __LINE__));
-			break;
-		case webrtc::DataChannelInterface::kClosing:
-			_onerror(Error::New("Unable to send arraybuffer. DataChannel is closing", __FILE__, __LINE__));
-			break;
-		case webrtc::DataChannelInterface::kClosed:
-			_onerror(Error::New("Unable to send arraybuffer. DataChannel is closed", __FILE__, __LINE__));
-			break;
-		}
+	FramedSend message;
+
+	// Chunks are copied out of the ArrayBuffer as they go, there is no whole message copy up front.
+	if (auto wrapped = dynamic_cast<const WrapRtcBuffer*>(data.get())) {
+		message.buffer = wrapped->Buffer();
 	}
+	else {
+		message.data = data;
+	}
+
+	message.size = data->ByteLength();
+	message.binary = binary;
+	QueueFramed(std::move(message));
 }
 
 void RTCDataChannelInternal::Send(const unsigned char* data, size_t length, bool binary) {
-	rtc::CopyOnWriteBuffer buffer(data, length);
-	webrtc::DataBuffer dataBuffer(buffer, binary);
+	Enqueue(webrtc::DataBuffer(rtc::CopyOnWriteBuffer(data, length), binary));
+}
+
+void RTCDataChannelInternal::Send(const std::vector<RTCDataChannel::Fragment>& fragments, bool binary) {
+	size_t length = 0;
+
+	for (const auto& fragment : fragments) {
+		length += fragment.length;
+	}
+
+	rtc::CopyOnWriteBuffer buffer(length);
+	uint8_t* data = buffer.MutableData();
+
+	for (const auto& fragment : fragments) {
+		if (fragment.length) {
+			std::memcpy(data, fragment.data, fragment.length);
+			data += fragment.length;
+		}
+	}
+
+	Enqueue(webrtc::DataBuffer(buffer, binary));
+}
+
+void RTCDataChannelInternal::SendBatch(const std::vector<std::shared_ptr<ArrayBuffer>>& buffers, bool binary) {
+	if (_framed.load() || _coalescer || _compressor) {
+		for (const auto& data : buffers) {
+			if (data) {
+				Send(data, binary);
+			}
+		}
+
+		return;
+	}
+
+	std::vector<webrtc::DataBuffer> batch;
+
+	batch.reserve(buffers.size());
+
+	for (const auto& data : buffers) {
+		if (data) {
+			batch.emplace_back(ToRtcBuffer(data), binary);
+		}
+	}
+
+	if (batch.empty()) {
+		return;
+	}
+
+	uint64_t bytes = 0;
+
+	for (const auto& buffer : batch) {
+		bytes += buffer.size();
+	}
+
+	_queue->queued.fetch_add(bytes);
+	_wire.fetch_add(bytes);
+	_observed.fetch_add(bytes);
+
+	auto task = [queue = _queue, batch = std::move(batch)]() mutable {
+		std::lock_guard<std::mutex> lock(queue->mutex);
+
+		for (auto& buffer : batch) {
+			SendAsync(queue, std::move(buffer));
+		}
+	};
+
+	if (_network) {
+		_network->PostTask(std::move(task));
+	}
+	else {
+		task();
+	}
+}
+
+void RTCDataChannelInternal::Enqueue(webrtc::DataBuffer buffer) {
+	if (_framed.load()) {
+		FramedSend message;
+
+		message.buffer = std::move(buffer.data);
+		message.size = message.buffer.size();
+		message.binary = buffer.binary;
+		QueueFramed(std::move(message));
+		return;
+	}
+
+	_observed.fetch_add(buffer.size());
+	Post(std::move(buffer));
+}
+
+void RTCDataChannelInternal::Post(webrtc::DataBuffer buffer) {
+	_queue->queued.fetch_add(buffer.size());
+	_wire.fetch_add(buffer.size());
+
+	if (_coalescer) {
+		_coalescer->Send(std::move(buffer));
+		return;
+	}
+
+	Forward(std::move(buffer));
+}
+
+void RTCDataChannelInternal::Forward(webrtc::DataBuffer buffer) {
+	if (_compressor) {
+		_compressor->Send(std::move(buffer));
+		return;
+	}
+
+	auto task = [queue = _queue, buffer = std::move(buffer)]() mutable {
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		SendAsync(queue, std::move(buffer));
+	};
+
+	if (_network) {
+		_network->PostTask(std::move(task));
+	}
+	else {
+		task();
+	}
+}
+
+void RTCDataChannelInternal::SendAsync(const std::shared_ptr<SendQueue>& queue, webrtc::DataBuffer buffer) {
+	uint64_t size = buffer.size();
+
+	if (!queue->owner) {
+		queue->queued.fetch_sub(size);
+		return;
+	}
+
+	queue->owner->_channel->SendAsync(std::move(buffer), [queue, size](webrtc::RTCError error) {
+		queue->queued.fetch_sub(size);
+
+		if (error.ok()) {
+			queue->sent();
+			return;
+		}
+
+		std::shared_ptr<EventLoopInternal> loop;
+		synchronized_callback<std::shared_ptr<Error>> onerror;
+		std::shared_ptr<Error> reason;
+
+		{
+			std::lock_guard<std::mutex> lock(queue->mutex);
+
+			if (!queue->owner) {
+				return;
+			}
+
+			loop = queue->owner->_loop;
+			onerror = queue->owner->_onerror;
+			reason = queue->owner->SendError();
+		}
+
+		Emit(loop, onerror, reason);
+	});
+}
+
+std::vector<RTCDataChannel::BroadcastResult> RTCDataChannel::Broadcast(const std::shared_ptr<ArrayBuffer>& data, const std::vector<std::shared_ptr<RTCDataChannel>>& channels, bool binary, uint64_t maxBufferedAmount) {
+	std::vector<BroadcastResult> results(channels.size(), kBroadcastClosed);
+
+	if (!data) {
+		return results;
+	}
+
+	rtc::CopyOnWriteBuffer buffer = RTCDataChannelInternal::ToRtcBuffer(data);
+
+	for (size_t index = 0; index < channels.size(); index++) {
+		auto internal = dynamic_cast<RTCDataChannelInternal*>(channels[index].get());
+
+		if (internal) {
+			results[index] = internal->Share(buffer, binary, maxBufferedAmount);
+		}
+	}
+
+	return results;
+}
+
+RTCDataChannel::BroadcastResult RTCDataChannelInternal::Share(const rtc::CopyOnWriteBuffer& buffer, bool binary, uint64_t maxBufferedAmount) {
+	if (_state.load() != webrtc::DataChannelInterface::kOpen) {
+		return RTCDataChannel::kBroadcastClosed;
+	}
+
+	// _observed is BufferedAmount() as of the last flow call plus everything queued since, without a proxy call.
+	if (maxBufferedAmount && _observed.load() >= maxBufferedAmount) {
+		return RTCDataChannel::kBroadcastBuffered;
+	}
+
+	Enqueue(webrtc::DataBuffer(buffer, binary));
+	return RTCDataChannel::kBroadcastSent;
+}
+
+void RTCDataChannelInternal::OnCoalesced(webrtc::DataBuffer buffer, uint64_t original) {
+	// queued switches from the bundled messages' sizes to the bundle's.
+	_queue->queued.fetch_add(buffer.size());
+	_queue->queued.fetch_sub(original);
+
+	Forward(std::move(buffer));
+}
+
+void RTCDataChannelInternal::ConfigureCoalescing(int delay, size_t maxSize) {
+	if (_coalescer) {
+		_coalescer->Configure(delay, maxSize);
+	}
+}
+
+bool RTCDataChannelInternal::Coalesced() {
+	return _coalescer != nullptr;
+}
+
+RTCDataChannel::CoalescingStats RTCDataChannelInternal::GetCoalescingStats() {
+	return _coalescer ? _coalescer->GetStats() : RTCDataChannel::CoalescingStats();
+}
+
+void RTCDataChannelInternal::OnCompressed(webrtc::DataBuffer buffer, uint64_t original) {
+	// Sent from the compressor's strand in order, queued switches from the message's size to the compressed one.
+	_queue->queued.fetch_add(buffer.size());
+	_queue->queued.fetch_sub(original);
+
+	std::lock_guard<std::mutex> lock(_queue->mutex);
+	SendAsync(_queue, std::move(buffer));
+}
+
+void RTCDataChannelInternal::OnCompressionError(const std::shared_ptr<Error>& error) {
+	Emit(_loop, _onerror, error);
+}
+
+void RTCDataChannelInternal::ConfigureCompression(size_t threshold, int level) {
+	if (_compressor) {
+		_compressor->Configure(threshold, level);
+	}
+}
+
+bool RTCDataChannelInternal::Compressed() {
+	return _compressor != nullptr;
+}
+
+RTCDataChannel::CompressionStats RTCDataChannelInternal::GetCompressionStats() {
+	return _compressor ? _compressor->GetStats() : RTCDataChannel::CompressionStats();
+}
+
+void RTCDataChannelInternal::SetFramed(bool framed, const RTCDataChannel::FramedOptions& options) {
+	{
+		std::lock_guard<std::mutex> lock(_framedMutex);
+
+		_framedOptions = options;
+		_framedOptions.chunkSize = std::max<size_t>(options.chunkSize, 1);
+		_maxReassembly.store(options.maxReassembly);
+		_reassemblyTimeout.store(std::max(options.reassemblyTimeout, 0));
+	}
+
+	_framed.store(framed);
+}
+
+bool RTCDataChannelInternal::Framed() {
+	return _framed.load();
+}
+
+void RTCDataChannelInternal::QueueFramed(FramedSend message) {
+	{
+		std::lock_guard<std::mutex> lock(_framedMutex);
+
+		message.id = _nextFrameId++;
+		message.offset = 0;
+
+		_framedPending.fetch_add(message.size);
+		_observed.fetch_add(message.size);
+		_framedQueue.push_back(std::move(message));
+	}
+
+	PumpFramed();
+}
+
+void RTCDataChannelInternal::PumpFramed() {
+	std::vector<AsyncTask> notifications;
+
+	{
+		// Runs on the sending thread and from OnFlow() on webrtc threads, so nothing in here may block on the channel:
+		// _wire is the last BufferedAmount() seen by OnFlow() plus whatever was posted since.
+		std::lock_guard<std::mutex> lock(_framedMutex);
+
+		while (!_framedQueue.empty() && _wire.load() < _framedOptions.highWaterMark) {
+			FramedSend& message = _framedQueue.front();
+			uint64_t length = std::min<uint64_t>(_framedOptions.chunkSize, message.size - message.offset);
+			const uint8_t* source = message.file ? message.file->Data() : message.data ? message.data->Data() : message.buffer.data();
+
+			rtc::CopyOnWriteBuffer chunk(kFrameHeader + length);
+			uint8_t* data = chunk.MutableData();
+
+			WriteFrameHeader(data, message.id, message.offset, message.size, message.binary);
+
+			if (length) {
+				std::memcpy(data + kFrameHeader, source + message.offset, length);
+			}
+
+			message.offset += length;
+			_framedPending.fetch_sub(length);
+			_observed.fetch_add(kFrameHeader);
 
-	if (!_channel->Send(dataBuffer)) {
-		switch (_channel->state()) {
-		case webrtc::DataChannelInterface::kConnecting:
-			_onerror(Error::New("Unable to send arraybuffer. DataChannel is connecting", __FILE__, __LINE__));
-			break;
-		case webrtc::DataChannelInterface::kOpen:
-			_onerror(Error::New("Unable to send arraybuffer.", __FILE__, __LINE__));
-			break;
-		case webrtc::DataChannelInterface::kClosing:
-			_onerror(Error::New("Unable to send arraybuffer. DataChannel is closing", __FILE__, __LINE__));
-			break;
-		case webrtc::DataChannelInterface::kClosed:
-			_onerror(Error::New("Unable to send arraybuffer. DataChannel is closed", __FILE__, __LINE__));
-			break;
+			if (message.file) {
+				// Keeps the disk a window ahead of the copies, the next chunks are paged in while these drain.
+				message.file->Prefetch(message.offset, _framedOptions.highWaterMark);
+			}
+
+			if (message.progress) {
+				notifications.emplace_back([progress = message.progress, sent = message.offset, total = message.size]() {
+					progress(sent, total);
+				});
+			}
+
+			if (message.offset >= message.size) {
+				if (message.callback) {
+					notifications.emplace_back([callback = std::move(message.callback)]() {
+						callback(nullptr);
+					});
+				}
+
+				_framedQueue.pop_front();
+			}
+
+			Post(webrtc::DataBuffer(chunk, true));
+		}
+	}
+
+	for (auto& notification : notifications) {
+		Notify(std::move(notification));
+	}
+}
+
+void RTCDataChannelInternal::DropFramed() {
+	std::vector<std::function<void(std::shared_ptr<Error>)>> callbacks;
+
+	{
+		std::lock_guard<std::mutex> lock(_framedMutex);
+
+		for (auto& message : _framedQueue) {
+			_framedPending.fetch_sub(message.size - message.offset);
+
+			if (message.callback) {
+				callbacks.push_back(std::move(message.callback));
+			}
+		}
+
+		_framedQueue.clear();
+	}
+
+	if (callbacks.empty()) {
+		return;
+	}
+
+	auto error = Error::New("Unable to send file. DataChannel is closing", __FILE__, __LINE__);
+
+	for (auto& callback : callbacks) {
+		Notify([callback = std::move(callback), error]() {
+			callback(error);
+		});
+	}
+}
+
+void RTCDataChannelInternal::SendFile(const String& path, const RTCDataChannel::FileOptions& options, std::function<void(std::shared_ptr<Error>)> callback, std::function<void(uint64_t, uint64_t)> progress) {
+	std::shared_ptr<MappedFile> file;
+	std::shared_ptr<Error> error;
+
+	if (!_framed.load()) {
+		error = Error::New("Unable to send file. SendFile() needs framed mode", __FILE__, __LINE__);
+	}
+	else {
+		file = MappedFile::Open(std::string(path.c_str()), options.offset, options.length, &error);
+	}
+
+	if (error) {
+		if (callback) {
+			Notify([callback = std::move(callback), error]() {
+				callback(error);
+			});
 		}
+
+		return;
 	}
+
+	FramedSend message;
+
+	message.file = std::move(file);
+	message.size = message.file->Size();
+	message.binary = options.binary;
+	message.progress = std::move(progress);
+	message.callback = std::move(callback);
+	QueueFramed(std::move(message));
 }
 
-void crtc::RTCDataChannelInternal::onBufferedAmountLow(std::function<void()> callback)
+void RTCDataChannelInternal::ReceiveFile(const String& path, const FileOptions& options, std::function<void(std::shared_ptr<Error>)> callback, std::function<void(uint64_t, uint64_t)> progress) {
+	FileReceive receive;
+
+	receive.path = path.c_str();
+	receive.progress = std::move(progress);
+	receive.callback = std::move(callback);
+	receive.id = 0;
+	receive.maxSize = options.maxSize;
+	receive.total = 0;
+	receive.received = 0;
+	receive.started = false;
+	receive.failed = false;
+
+	std::lock_guard<std::mutex> lock(_fileMutex);
+	_fileReceives.push_back(std::move(receive));
+}
+
+bool RTCDataChannelInternal::ReceiveToFile(const webrtc::DataBuffer& buffer, uint32_t id, uint64_t offset, uint64_t total) {
+	std::vector<AsyncTask> notifications;
+	uint64_t length = buffer.size() - kFrameHeader;
+
+	{
+		std::lock_guard<std::mutex> lock(_fileMutex);
+
+		if (_fileReceives.empty()) {
+			return false;
+		}
+
+		FileReceive& receive = _fileReceives.front();
+
+		if (!receive.started) {
+			// Messages that were already being reassembled before the ReceiveFile() keep going to onMessage, so do
+			// the ones it would join halfway.
+			if (offset) {
+				return false;
+			}
+
+			{
+				std::lock_guard<std::mutex> assembly(_assemblyMutex);
+
+				if (_assembling.count(id)) {
+					return false;
+				}
+			}
+
+			std::shared_ptr<Error> error;
+
+			receive.id = id;
+			receive.total = total;
+			receive.started = true;
+			// total comes from the remote end, the file is only created once it is known to be acceptable.
+			if (total > receive.maxSize) {
+				error = Error::New("Framed message exceeds the file size limit.", __FILE__, __LINE__);
+			}
+			else {
+				receive.file = MappedFile::Create(receive.path, total, &error);
+			}
+
+			receive.failed = error != nullptr;
+
+			if (error && receive.callback) {
+				notifications.emplace_back([callback = std::move(receive.callback), error]() {
+					callback(error);
+				});
+			}
+		}
+		else if (receive.id != id) {
+			return false;
+		}
+
+		// The file was mapped at the first chunk's total, a chunk that disagrees or lands on bytes already written
+		// would write past the mapping or complete a file with holes. The receive fails, the chunk is consumed.
+		if (total != receive.total || offset + length > receive.total || (length && !AddRange(&receive.ranges, offset, offset + length))) {
+			if (!receive.failed && receive.callback) {
+				notifications.emplace_back([callback = std::move(receive.callback)]() {
+					callback(Error::New("Invalid frame received.", __FILE__, __LINE__));
+				});
+			}
+
+			_fileReceives.pop_front();
+		}
+		else {
+			if (!receive.failed) {
+				if (length) {
+					std::memcpy(receive.file->Data() + offset, buffer.data.data() + kFrameHeader, length);
+				}
+
+				if (receive.progress) {
+					notifications.emplace_back([progress = receive.progress, received = receive.received + length, total]() {
+						progress(received, total);
+					});
+				}
+			}
+
+			receive.received += length;
+
+			// The rest of a message whose file could not be created is consumed and dropped.
+			if (receive.received >= total) {
+				if (!receive.failed && receive.callback) {
+					notifications.emplace_back([callback = std::move(receive.callback)]() {
+						callback(nullptr);
+					});
+				}
+
+				_fileReceives.pop_front();
+			}
+		}
+	}
+
+	for (auto& notification : notifications) {
+		Notify(std::move(notification));
+	}
+
+	return true;
+}
+
+void RTCDataChannelInternal::DropFiles() {
+	std::deque<FileReceive> receives;
+
+	{
+		std::lock_guard<std::mutex> lock(_fileMutex);
+		receives.swap(_fileReceives);
+	}
+
+	if (receives.empty()) {
+		return;
+	}
+
+	auto error = Error::New("Unable to receive file. DataChannel is closed", __FILE__, __LINE__);
+
+	for (auto& receive : receives) {
+		if (!receive.failed && receive.callback) {
+			Notify([callback = std::move(receive.callback), error]() {
+				callback(error);
+			});
+		}
+	}
+}
+
+void RTCDataChannelInternal::Notify(AsyncTask task) {
+	if (_loop) {
+		_loop->Post(std::move(task));
+	}
+	else {
+		task();
+	}
+}
+
+std::shared_ptr<Error> RTCDataChannelInternal::SendError() {
+	switch (_channel->state()) {
+	case webrtc::DataChannelInterface::kConnecting:
+		return Error::New("Unable to send arraybuffer. DataChannel is connecting", __FILE__, __LINE__);
+	case webrtc::DataChannelInterface::kClosing:
+		return Error::New("Unable to send arraybuffer. DataChannel is closing", __FILE__, __LINE__);
+	case webrtc::DataChannelInterface::kClosed:
+		return Error::New("Unable to send arraybuffer. DataChannel is closed", __FILE__, __LINE__);
+	case webrtc::DataChannelInterface::kOpen:
+	default:
+		return Error::New("Unable to send arraybuffer.", __FILE__, __LINE__);
+	}
+}
+
+rtc::CopyOnWriteBuffer RTCDataChannelInternal::ToRtcBuffer(const std::shared_ptr<ArrayBuffer>& data) {
+	// Buffers that already live in a CopyOnWriteBuffer (NewZeroCopy(), received messages and their slices) are shared.
+	auto wrapped = dynamic_cast<const WrapRtcBuffer*>(data.get());
+
+	if (wrapped) {
+		return wrapped->Buffer();
+	}
+
+	return rtc::CopyOnWriteBuffer(data->Data(), data->ByteLength());
+}
+
+void crtc::RTCDataChannelInternal::onBufferedAmountLow(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
+{
+	_onbufferedamountlow.Set(callback, executor);
+}
+
+void crtc::RTCDataChannelInternal::onOpen(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onbufferedamountlow = callback;
+	_onopen.Set(callback, executor);
 }
 
-void crtc::RTCDataChannelInternal::onOpen(std::function<void()> callback)
+void crtc::RTCDataChannelInternal::onClose(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onopen = callback;
+	_onclose.Set(callback, executor);
 }
 
-void crtc::RTCDataChannelInternal::onClose(std::function<void()> callback)
+void crtc::RTCDataChannelInternal::onMessage(std::function<void(std::shared_ptr<ArrayBuffer>, bool)> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onclose = callback;
+	_onmessage.Set(callback, executor);
 }
 
-void crtc::RTCDataChannelInternal::onMessage(std::function<void(std::shared_ptr<ArrayBuffer>, bool)> callback)
+void crtc::RTCDataChannelInternal::onChunk(std::function<void(std::shared_ptr<ArrayBuffer>, uint64_t, uint64_t, bool)> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onmessage = callback;
+	_onchunk.Set(callback, executor);
 }
 
-void crtc::RTCDataChannelInternal::onError(std::function<void(std::shared_ptr<Error>)> callback)
+uint64_t crtc::RTCDataChannelInternal::onFlow(std::function<void(uint64_t, bool)> callback)
 {
-	_onerror = callback;
+	std::lock_guard<std::mutex> lock(_flowMutex);
+
+	_onflow = std::move(callback);
+	return ++_flowToken;
+}
+
+void crtc::RTCDataChannelInternal::ClearFlow(uint64_t token)
+{
+	std::lock_guard<std::mutex> lock(_flowMutex);
+
+	if (token == _flowToken) {
+		_onflow = nullptr;
+	}
+}
+
+void crtc::RTCDataChannelInternal::onError(std::function<void(std::shared_ptr<Error>)> callback, const std::shared_ptr<Executor>& executor)
+{
+	_onerror.Set(callback, executor);
 }
 
 void RTCDataChannelInternal::OnStateChange() {
+	_state.store(_channel->state());
+
 	switch (_channel->state()) {
 	case webrtc::DataChannelInterface::kConnecting:
 		break;
 	case webrtc::DataChannelInterface::kOpen:
-		_onopen();
+		Emit(_loop, _onopen);
 		break;
 	case webrtc::DataChannelInterface::kClosing:
+		DropFramed();
+		OnFlow(true);
 		break;
 	case webrtc::DataChannelInterface::kClosed:
-		_onclose();
+		DropFramed();
+		DropFiles();
+
+		{
+			std::lock_guard<std::mutex> lock(_assemblyMutex);
+			DropAssembly();
+		}
+
+		OnFlow(true);
+		Emit(_loop, _onclose);
 		_event.reset();
 		break;
 	}
 }
 
 void RTCDataChannelInternal::OnMessage(const webrtc::DataBuffer& buffer) {
-	_onmessage(WrapRtcBuffer::New(buffer.data.data(), buffer.size()), buffer.binary);
+	if (_compressor) {
+		_compressor->Receive(buffer);
+		return;
+	}
+
+	Dispatch(buffer);
 }
 
-void RTCDataChannelInternal::OnBufferedAmountChange(uint64_t previous_amount) {
-	if (_threshold && previous_amount > _threshold && _channel->buffered_amount() < _threshold) {
-		_onbufferedamountlow();
+void RTCDataChannelInternal::Dispatch(const webrtc::DataBuffer& buffer) {
+	if (!_coalescer) {
+		Handle(buffer);
+		return;
+	}
+
+	bool valid = _coalescer->Split(buffer, [this](webrtc::DataBuffer message) {
+		Handle(message);
+	});
+
+	if (!valid) {
+		Emit(_loop, _onerror, Error::New("Invalid coalesced message received.", __FILE__, __LINE__));
 	}
 }
 
-WrapRtcBuffer::WrapRtcBuffer(const rtc::CopyOnWriteBuffer& buffer) : _data(buffer) {
+void RTCDataChannelInternal::Handle(const webrtc::DataBuffer& buffer) {
+	if (_framed.load()) {
+		OnFrame(buffer);
+		return;
+	}
 
+	Deliver(Received{ buffer.data, 0, 0, buffer.binary, false });
 }
 
-WrapRtcBuffer::~WrapRtcBuffer() {
+void RTCDataChannelInternal::Deliver(Received message) {
+	if (!_receiveControl.load()) {
+		if (message.chunk) {
+			Emit(_loop, _onchunk, _pool.Wrap(message.data), message.offset, message.total, message.binary);
+		}
+		else {
+			Emit(_loop, _onmessage, _pool.Wrap(message.data), message.binary);
+		}
+
+		return;
+	}
+
+	uint64_t size = message.data.size();
+	uint64_t highWaterMark = _receiveHighWaterMark.load();
+
+	// Messages arrive one at a time, only the drain tasks lower the amount concurrently.
+	if (_overflowed.load() || (highWaterMark && _receive->amount.load() + size > highWaterMark)) {
+		if (!_overflowed.exchange(true)) {
+			Emit(_loop, _onerror, Error::New("Receive queue exceeds its high water mark. Closing DataChannel", __FILE__, __LINE__));
+
+			if (_loop) {
+				_loop->Post([channel = _channel]() {
+					channel->Close();
+				});
+			}
+			else {
+				_channel->Close();
+			}
+		}
+
+		return;
+	}
+
+	_receive->amount.fetch_add(size);
+
+	{
+		std::lock_guard<std::mutex> lock(_receive->mutex);
+
+		_receive->messages.push_back(std::move(message));
+
+		if (_receive->paused || _receive->draining) {
+			return;
+		}
+
+		_receive->draining = true;
+	}
+
+	ScheduleDrain();
+}
+
+void RTCDataChannelInternal::ScheduleDrain() {
+	if (_loop) {
+		_loop->Post([queue = _receive]() {
+			Drain(queue);
+		});
+	}
+	else {
+		Drain(_receive);
+	}
+}
+
+void RTCDataChannelInternal::Drain(const std::shared_ptr<ReceiveQueue>& queue) {
+	for (size_t count = 0; ; count++) {
+		std::function<void(std::shared_ptr<ArrayBuffer>, bool)> onmessage;
+		std::function<void(std::shared_ptr<ArrayBuffer>, uint64_t, uint64_t, bool)> onchunk;
+		std::shared_ptr<EventLoopInternal> loop;
+		std::shared_ptr<ArrayBuffer> data;
+		Received message;
+
+		{
+			std::lock_guard<std::mutex> lock(queue->mutex);
+
+			if (!queue->owner || queue->paused || queue->messages.empty()) {
+				queue->draining = false;
+				return;
+			}
+
+			if (count == kDrainBatch && queue->owner->_loop) {
+				loop = queue->owner->_loop;
+			}
+			else {
+				message = std::move(queue->messages.front());
+				queue->messages.pop_front();
+				data = queue->owner->_pool.Wrap(message.data);
+
+				// Routed callbacks come out of load() already bound to their executor.
+				if (message.chunk) {
+					onchunk = queue->owner->_onchunk.load();
+				}
+				else {
+					onmessage = queue->owner->_onmessage.load();
+				}
+			}
+		}
+
+		if (loop) {
+			loop->Post([queue]() {
+				Drain(queue);
+			});
+
+			return;
+		}
+
+		if (onchunk) {
+			onchunk(data, message.offset, message.total, message.binary);
+		}
+		else if (onmessage) {
+			onmessage(data, message.binary);
+		}
 
+		queue->amount.fetch_sub(message.data.size());
+	}
 }
 
-size_t WrapRtcBuffer::ByteLength() const {
-	return _data.size();
+void RTCDataChannelInternal::OnFrame(const webrtc::DataBuffer& buffer) {
+	uint32_t id;
+	uint64_t offset, total;
+	bool binary;
+
+	if (!ReadFrameHeader(buffer.data.data(), buffer.size(), &id, &offset, &total, &binary)) {
+		Emit(_loop, _onerror, Error::New("Invalid frame received.", __FILE__, __LINE__));
+		return;
+	}
+
+	if (ReceiveToFile(buffer, id, offset, total)) {
+		return;
+	}
+
+	uint64_t length = buffer.size() - kFrameHeader;
+
+	// Chunks and single chunk messages are slices of the received buffer, only split messages are copied.
+	if (_onchunk) {
+		Deliver(Received{ buffer.data.Slice(kFrameHeader, length), offset, total, binary, true });
+		return;
+	}
+
+	if (!offset && length == total) {
+		Deliver(Received{ buffer.data.Slice(kFrameHeader, length), 0, 0, binary, false });
+		return;
+	}
+
+	std::shared_ptr<Error> error;
+	Received message;
+	bool complete = false;
+
+	{
+		std::lock_guard<std::mutex> lock(_assemblyMutex);
+		int64_t now = rtc::TimeMillis();
+
+		Expire(now);
+
+		auto it = _assembling.find(id);
+
+		if (it == _assembling.end()) {
+			Reassembly entry;
+
+			entry.total = total;
+			entry.received = 0;
+			entry.updated = now;
+			entry.binary = binary;
+			// total comes from the remote end, the sum could wrap.
+			uint64_t max = _maxReassembly.load();
+
+			entry.dropped = total > max || _assembled > max - total || total > std::numeric_limits<size_t>::max();
+
+			if (entry.dropped) {
+				error = Error::New("Framed message exceeds the reassembly limit.", __FILE__, __LINE__);
+			}
+			else {
+				entry.buffer = rtc::CopyOnWriteBuffer(static_cast<size_t>(total));
+				_assembled += total;
+			}
+
+			it = _assembling.emplace(id, std::move(entry)).first;
+		}
+
+		Reassembly& entry = it->second;
+
+		// The header was only checked against its own total, the buffer was sized for the first chunk's. A chunk that
+		// disagrees or lands on bytes already received would overrun the buffer or complete a message with holes.
+		if (total != entry.total || offset + length > entry.total || (length && !AddRange(&entry.ranges, offset, offset + length))) {
+			if (!entry.dropped) {
+				_assembled -= entry.total;
+			}
+
+			_assembling.erase(it);
+			error = Error::New("Invalid frame received.", __FILE__, __LINE__);
+		}
+		else {
+			if (!entry.dropped && length) {
+				std::memcpy(entry.buffer.MutableData() + offset, buffer.data.data() + kFrameHeader, length);
+			}
+
+			entry.received += length;
+			entry.updated = now;
+
+			if (entry.received >= entry.total) {
+				if (!entry.dropped) {
+					_assembled -= entry.total;
+					message = Received{ std::move(entry.buffer), 0, 0, entry.binary, false };
+					complete = true;
+				}
+
+				_assembling.erase(it);
+			}
+		}
+	}
+
+	if (error) {
+		Emit(_loop, _onerror, error);
+	}
+
+	if (complete) {
+		Deliver(std::move(message));
+	}
 }
 
-std::shared_ptr<ArrayBuffer> WrapRtcBuffer::Slice(size_t begin, size_t end) const {
-	if (begin <= end && end <= _data.size()) {
-		return std::make_shared<ArrayBufferInternal>(_data.data() + begin, ((!end) ? _data.size() : end - begin));
+void RTCDataChannelInternal::Expire(int64_t now) {
+	int timeout = _reassemblyTimeout.load();
+
+	if (!timeout || _assembling.empty() || now < _nextExpiry) {
+		return;
 	}
 
-	return nullptr;
+	// Checked at most once a second, a message is dropped between timeout and timeout plus a second after its last chunk.
+	_nextExpiry = now + 1000;
+
+	for (auto it = _assembling.begin(); it != _assembling.end();) {
+		if (now - it->second.updated < timeout) {
+			++it;
+			continue;
+		}
+
+		if (!it->second.dropped) {
+			_assembled -= it->second.total;
+		}
+
+		it = _assembling.erase(it);
+	}
 }
 
-uint8_t* WrapRtcBuffer::Data() {
-	return const_cast<uint8_t*>(_data.data());
+void RTCDataChannelInternal::DropAssembly() {
+	_assembling.clear();
+	_assembled = 0;
 }
 
-const uint8_t* WrapRtcBuffer::Data() const {
-	return _data.data();
+void RTCDataChannelInternal::OnBufferedAmountChange(uint64_t sent_data_size) {
+	OnFlow();
 }
 
-String WrapRtcBuffer::ToString() const {
-	return String(reinterpret_cast<const char*>(_data.data()), _data.size());
+void RTCDataChannelInternal::OnFlow(bool closing) {
+	// webrtc only reports its own buffer draining, messages that went out without being buffered and the ones still
+	// on the way to the network thread only show up here, so the edge is taken against the last amount seen.
+	_wire.store(_channel->buffered_amount() + _queue->queued.load());
+
+	if (!closing) {
+		PumpFramed();
+	}
+
+	uint64_t current = _wire.load() + _framedPending.load();
+	uint64_t previous = _observed.exchange(current);
+	uint64_t threshold = _threshold.load();
+
+	_onflow(current, closing);
+
+	if (previous > threshold && current <= threshold) {
+		Emit(_loop, _onbufferedamountlow);
+	}
 }
 
 RTCDataChannel::RTCDataChannel() {
@@ -28,14 +28,29 @@
 #define CRTC_RTCDATACHANNEL_H
 
 #include "crtc.h"
+#include "arraybuffer.h"
+#include "datachannelcoalescer.h"
+#include "datachannelcompressor.h"
 #include "event.h"
+#include "eventloop.h"
+#include "executor.h"
+#include "mappedfile.h"
 #include "utils.hpp"
 #include <api/data_channel_interface.h>
+#include "rtc_base/thread.h"
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
 
 namespace crtc {
 	class RTCDataChannelInternal : public RTCDataChannel, public webrtc::DataChannelObserver {
+		friend class DataChannelCoalescer;
+		friend class DataChannelCompressor;
+
 	public:
-		explicit RTCDataChannelInternal(const rtc::scoped_refptr<webrtc::DataChannelInterface>& channel);
+		// network is the thread sends are handed to, without one they are queued from the caller.
+		explicit RTCDataChannelInternal(const rtc::scoped_refptr<webrtc::DataChannelInterface>& channel, const std::shared_ptr<EventLoopInternal>& loop = nullptr, rtc::Thread* network = nullptr);
 		virtual ~RTCDataChannelInternal() override;
 
 		int Id() override;
@@ -43,6 +58,12 @@ namespace crtc {
 		uint64_t BufferedAmount() override;
 		uint64_t BufferedAmountLowThreshold() override;
 		void SetBufferedAmountLowThreshold(uint64_t threshold = 0) override;
+		void Pause() override;
+		void Resume() override;
+		bool Paused() override;
+		uint64_t ReceivedAmount() override;
+		uint64_t ReceiveHighWaterMark() override;
+		void SetReceiveHighWaterMark(uint64_t highWaterMark = kDefaultReceiveHighWaterMark) override;
 		uint16_t MaxPacketLifeTime() override;
 		uint16_t MaxRetransmits() override;
 		bool Negotiated() override;
@@ -52,45 +73,213 @@ namespace crtc {
 		void Close() override;
 		void Send(const std::shared_ptr<ArrayBuffer>& data, bool binary = true) override;
 		void Send(const unsigned char* data, size_t length, bool binary = true) override;
+		void Send(const std::vector<RTCDataChannel::Fragment>& fragments, bool binary = true) override;
+		void SendBatch(const std::vector<std::shared_ptr<ArrayBuffer>>& buffers, bool binary = true) override;
+		void SetFramed(bool framed, const RTCDataChannel::FramedOptions& options = RTCDataChannel::FramedOptions()) override;
+		bool Framed() override;
+		void SendFile(const String& path, const RTCDataChannel::FileOptions& options = RTCDataChannel::FileOptions(), std::function<void(std::shared_ptr<Error>)> callback = nullptr, std::function<void(uint64_t, uint64_t)> progress = nullptr) override;
+		void ReceiveFile(const String& path, const FileOptions& options = FileOptions(), std::function<void(std::shared_ptr<Error>)> callback = nullptr, std::function<void(uint64_t, uint64_t)> progress = nullptr) override;
+		bool Coalesced() override;
+		RTCDataChannel::CoalescingStats GetCoalescingStats() override;
+		bool Compressed() override;
+		RTCDataChannel::CompressionStats GetCompressionStats() override;
+
+		void onBufferedAmountLow(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onOpen(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onClose(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onMessage(std::function<void(std::shared_ptr<ArrayBuffer>, bool)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onChunk(std::function<void(std::shared_ptr<ArrayBuffer>, uint64_t, uint64_t, bool)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onError(std::function<void(std::shared_ptr<Error>)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+
+		// Hook for RTCDataChannelWriter and RTCDataChannelMux, called with BufferedAmount() and whether the channel is
+		// closing whenever the amount may have dropped. Runs on webrtc threads. A new hook replaces the previous one, the
+		// returned token lets ClearFlow() remove it only while it is still installed. Clearing waits for calls in progress.
+		uint64_t onFlow(std::function<void(uint64_t, bool)> callback);
+		void ClearFlow(uint64_t token);
+
+		inline const std::shared_ptr<EventLoopInternal>& Loop() const {
+			return _loop;
+		}
 
-		void onBufferedAmountLow(std::function<void()> callback) override;
-		void onOpen(std::function<void()> callback) override;
-		void onClose(std::function<void()> callback) override;
-		void onMessage(std::function<void(std::shared_ptr<ArrayBuffer>, bool)> callback) override;
-		void onError(std::function<void(std::shared_ptr<Error>)> callback) override;
+		// One channel of RTCDataChannel::Broadcast(), buffer is shared with the others.
+		RTCDataChannel::BroadcastResult Share(const rtc::CopyOnWriteBuffer& buffer, bool binary, uint64_t maxBufferedAmount);
+
+		static rtc::CopyOnWriteBuffer ToRtcBuffer(const std::shared_ptr<ArrayBuffer>& data);
+
+		// Settings of a channel created with RTCDataChannelInit::compression, channels that find the marker in their
+		// protocol compress with the defaults.
+		void ConfigureCompression(size_t threshold, int level);
+
+		// Same for RTCDataChannelInit::coalescing.
+		void ConfigureCoalescing(int delay, size_t maxSize);
 
 	protected:
+		// State shared with the network thread. Tasks there reach the channel through owner, which the destructor
+		// clears, and never hold the last reference to the webrtc proxy: its destructor blocks on the signaling thread.
+		struct SendQueue {
+			std::mutex mutex;
+			RTCDataChannelInternal* owner;
+			std::atomic<uint64_t> queued;
+			atomic_callback<> sent;
+		};
+
+		// A received message (or framed chunk) on its way to onMessage (onChunk).
+		struct Received {
+			rtc::CopyOnWriteBuffer data;
+			uint64_t offset;
+			uint64_t total;
+			bool binary;
+			bool chunk;
+		};
+
+		// Receive side flow control, shared with the drain tasks on the loop. They reach the channel through owner,
+		// which the destructor clears.
+		struct ReceiveQueue {
+			std::mutex mutex;
+			RTCDataChannelInternal* owner;
+			std::deque<Received> messages;
+			std::atomic<uint64_t> amount;
+			bool paused;
+			bool draining;
+		};
+
+		// A message waiting to be chunked, data is only kept for ArrayBuffers that are not backed by a CopyOnWriteBuffer
+		// and file for SendFile(), which also sets the callbacks.
+		struct FramedSend {
+			rtc::CopyOnWriteBuffer buffer;
+			std::shared_ptr<ArrayBuffer> data;
+			std::shared_ptr<MappedFile> file;
+			std::function<void(uint64_t, uint64_t)> progress;
+			std::function<void(std::shared_ptr<Error>)> callback;
+			uint32_t id;
+			uint64_t offset;
+			uint64_t size;
+			bool binary;
+		};
+
+		// A ReceiveFile() waiting for its message, id, total and file are set once the message's first chunk arrived.
+		struct FileReceive {
+			std::string path;
+			std::shared_ptr<MappedFile> file;
+			std::function<void(uint64_t, uint64_t)> progress;
+			std::function<void(std::shared_ptr<Error>)> callback;
+			std::map<uint64_t, uint64_t> ranges;
+			uint32_t id;
+			uint64_t maxSize;
+			uint64_t total;
+			uint64_t received;
+			bool started;
+			bool failed;
+		};
+
+		// ranges maps the start of every received span to its end, adjacent spans are merged.
+		struct Reassembly {
+			rtc::CopyOnWriteBuffer buffer;
+			std::map<uint64_t, uint64_t> ranges;
+			uint64_t total;
+			uint64_t received;
+			int64_t updated;
+			bool binary;
+			bool dropped;
+		};
+
+		// Every message goes through the network thread in order, a batch as a single task. Enqueue() counts the
+		// message towards onBufferedAmountLow, Post() only hands it over (to the coalescer first), Forward() takes it
+		// on to the compressor or the network thread.
+		void Enqueue(webrtc::DataBuffer buffer);
+		void Post(webrtc::DataBuffer buffer);
+		void Forward(webrtc::DataBuffer buffer);
+
+		// Framed mode, chunks are posted while the wire estimate is below the high water mark and again from OnFlow().
+		void QueueFramed(FramedSend message);
+		void PumpFramed();
+		void DropFramed();
+		void OnFrame(const webrtc::DataBuffer& buffer);
+
+		// Writes a chunk to the oldest ReceiveFile() when it belongs to its message, false leaves the chunk to OnFrame().
+		bool ReceiveToFile(const webrtc::DataBuffer& buffer, uint32_t id, uint64_t offset, uint64_t total);
+		void DropFiles();
+
+		// Called with _assemblyMutex held. Expire() drops the messages that timed out, DropAssembly() all of them.
+		void Expire(int64_t now);
+		void DropAssembly();
+
+		// Runs a SendFile() or ReceiveFile() callback on the loop, inline without one. Never called with a lock held.
+		void Notify(AsyncTask task);
+
+		// Delivers a received message that is not compressed (any more), Handle() every message of a bundle.
+		void Dispatch(const webrtc::DataBuffer& buffer);
+		void Handle(const webrtc::DataBuffer& buffer);
+
+		// Emits a message right away, or queues it once receive flow control is in use.
+		void Deliver(Received message);
+		void ScheduleDrain();
+		static void Drain(const std::shared_ptr<ReceiveQueue>& queue);
+
+		// Called by the coalescer under its lock, in order.
+		void OnCoalesced(webrtc::DataBuffer buffer, uint64_t original);
+
+		// Called by the compressor on its strands.
+		void OnCompressed(webrtc::DataBuffer buffer, uint64_t original);
+		void OnCompressionError(const std::shared_ptr<Error>& error);
+
+		std::shared_ptr<Error> SendError();
+
+		// Fires onBufferedAmountLow and the flow hook, after a send completed, webrtc drained its buffer or closed.
+		void OnFlow(bool closing = false);
+
+		// Called with queue->mutex held.
+		static void SendAsync(const std::shared_ptr<SendQueue>& queue, webrtc::DataBuffer buffer);
+
 		void OnStateChange() override;
 		void OnMessage(const webrtc::DataBuffer& buffer) override;
-		void OnBufferedAmountChange(uint64_t previous_amount) override;
+		void OnBufferedAmountChange(uint64_t sent_data_size) override;
 
-		uint64_t _threshold;
+		std::atomic<uint64_t> _threshold;
+		std::atomic<uint64_t> _observed;
+		std::atomic<int> _state;
+		std::atomic<uint64_t> _wire;
+		std::atomic<uint64_t> _framedPending;
+		std::atomic<uint64_t> _maxReassembly;
+		std::atomic<int> _reassemblyTimeout;
+		std::atomic<bool> _framed;
+		std::atomic<bool> _receiveControl;
+		std::atomic<bool> _overflowed;
+		std::atomic<uint64_t> _receiveHighWaterMark;
+		rtc::Thread* _network;
+		std::shared_ptr<SendQueue> _queue;
+		std::shared_ptr<ReceiveQueue> _receive;
+		std::shared_ptr<EventLoopInternal> _loop;
 		std::shared_ptr<Event> _event;
 		rtc::scoped_refptr<webrtc::DataChannelInterface> _channel;
+		WrapRtcBufferPool _pool;
+		std::shared_ptr<DataChannelCoalescer> _coalescer;
+		std::shared_ptr<DataChannelCompressor> _compressor;
 
-		synchronized_callback<> _onbufferedamountlow;
-		synchronized_callback<> _onclose;
-		synchronized_callback<std::shared_ptr<Error>> _onerror;
-		synchronized_callback<std::shared_ptr<ArrayBuffer>, bool> _onmessage;
-		synchronized_callback<> _onopen;
-	};
-
-	class WrapRtcBuffer : public ArrayBuffer {
+		std::mutex _framedMutex;
+		std::deque<FramedSend> _framedQueue;
+		RTCDataChannel::FramedOptions _framedOptions;
+		uint32_t _nextFrameId;
 
-	public:
-		size_t ByteLength() const override;
+		std::mutex _fileMutex;
+		std::deque<FileReceive> _fileReceives;
 
-		std::shared_ptr<ArrayBuffer> Slice(size_t begin = 0, size_t end = 0) const override;
-
-		uint8_t* Data() override;
-		const uint8_t* Data() const override;
-
-		String ToString() const override;
-	protected:
-		explicit WrapRtcBuffer(const rtc::CopyOnWriteBuffer& buffer);
-		~WrapRtcBuffer();
+		// Filled from Dispatch(), webrtc and the compressor's receive strand deliver messages one at a time. The lock
+		// is for the release on close, callbacks are never run with it held.
+		std::mutex _assemblyMutex;
+		std::map<uint32_t, Reassembly> _assembling;
+		uint64_t _assembled;
+		int64_t _nextExpiry;
 
-		rtc::CopyOnWriteBuffer _data;
+		routed_callback<synchronized_callback> _onbufferedamountlow;
+		routed_callback<synchronized_callback> _onclose;
+		routed_callback<synchronized_callback, std::shared_ptr<Error>> _onerror;
+		routed_callback<atomic_callback, std::shared_ptr<ArrayBuffer>, bool> _onmessage;
+		routed_callback<atomic_callback, std::shared_ptr<ArrayBuffer>, uint64_t, uint64_t, bool> _onchunk;
+		routed_callback<synchronized_callback> _onopen;
+		atomic_callback<uint64_t, bool> _onflow;
+		std::mutex _flowMutex;
+		uint64_t _flowToken;
 	};
 }
 
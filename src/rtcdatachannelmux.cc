@@ -0,0 +1,442 @@
+#include "rtcdatachannelmux.h"
+#include <algorithm>
+
+using namespace crtc;
+
+// Stream id in front of every message, little endian.
+static const size_t kStreamHeader = 4;
+
+// Bytes a stream of weight 1 may send per round before the next stream of the same priority gets its turn.
+static const uint64_t kQuantum = 16 * 1024;
+
+std::shared_ptr<RTCDataChannelMux> RTCDataChannelMux::New(const std::shared_ptr<RTCDataChannel>& channel, const Options& options) {
+	auto internal = std::dynamic_pointer_cast<RTCDataChannelInternal>(channel);
+
+	if (internal) {
+		auto mux = std::make_shared<RTCDataChannelMuxInternal>(internal, options);
+
+		mux->Attach();
+		return mux;
+	}
+
+	return nullptr;
+}
+
+RTCDataChannelMuxInternal::RTCDataChannelMuxInternal(const std::shared_ptr<RTCDataChannelInternal>& channel, const RTCDataChannelMux::Options& options) :
+	_channel(channel),
+	_options(options),
+	_closed(false),
+	_estimate(0),
+	_flow(0)
+{
+	if (_options.streamLowWaterMark > _options.streamHighWaterMark) {
+		_options.streamLowWaterMark = _options.streamHighWaterMark;
+	}
+
+	_fragments.resize(2);
+}
+
+RTCDataChannelMuxInternal::~RTCDataChannelMuxInternal() {
+	// Waits for a flow call in progress, messages already posted find the mux gone.
+	_channel->ClearFlow(_flow);
+	_channel->onMessage(nullptr);
+
+	ReadyCallbacks ready;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		for (auto& stream : _streams) {
+			Drop(stream.second.get(), &ready);
+			stream.second->_open = false;
+		}
+	}
+
+	Deliver(std::move(ready), Error::New("DataChannelMux is closed.", __FILE__, __LINE__));
+}
+
+void RTCDataChannelMuxInternal::Attach() {
+	std::weak_ptr<RTCDataChannelMuxInternal> self = shared_from_this();
+
+	_estimate = _channel->BufferedAmount();
+
+	_channel->onMessage([self](std::shared_ptr<ArrayBuffer> data, bool binary) {
+		if (auto mux = self.lock()) {
+			mux->OnMessage(data, binary);
+		}
+	});
+
+	_flow = _channel->onFlow([this](uint64_t amount, bool closing) {
+		OnFlow(amount, closing);
+	});
+}
+
+std::shared_ptr<RTCDataChannel> RTCDataChannelMuxInternal::Channel() const {
+	return _channel;
+}
+
+std::shared_ptr<RTCDataChannelMux::Stream> RTCDataChannelMuxInternal::CreateStream(uint32_t id, int priority, uint32_t weight) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto it = _streams.find(id);
+
+	if (it != _streams.end()) {
+		return it->second;
+	}
+
+	_closedIds.erase(id);
+	return Open(id, priority, weight);
+}
+
+void RTCDataChannelMuxInternal::onStream(std::function<void(std::shared_ptr<RTCDataChannelMux::Stream>)> callback) {
+	_onstream = callback;
+}
+
+void RTCDataChannelMuxInternal::OnFlow(uint64_t amount, bool closing) {
+	ReadyCallbacks ready;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_estimate = amount;
+
+		if (closing) {
+			_closed = true;
+
+			for (auto& stream : _streams) {
+				Drop(stream.second.get(), &ready);
+			}
+		}
+		else {
+			Schedule(&ready);
+		}
+	}
+
+	Deliver(std::move(ready), closing ? Error::New("DataChannel is closed.", __FILE__, __LINE__) : nullptr);
+}
+
+void RTCDataChannelMuxInternal::OnMessage(const std::shared_ptr<ArrayBuffer>& data, bool binary) {
+	if (!data || data->ByteLength() < kStreamHeader) {
+		return;
+	}
+
+	const uint8_t* header = static_cast<const ArrayBuffer&>(*data).Data();
+	uint32_t id = 0;
+
+	for (size_t index = 0; index < kStreamHeader; index++) {
+		id |= static_cast<uint32_t>(header[index]) << (index * 8);
+	}
+
+	std::shared_ptr<RTCDataChannelMuxStream> stream;
+	bool opened = false;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = _streams.find(id);
+
+		if (it != _streams.end()) {
+			stream = it->second;
+		}
+		else if (!_closed && _onstream && !_closedIds.count(id) && _streams.size() < _options.maxStreams) {
+			stream = Open(id, 0, 1);
+			opened = true;
+		}
+	}
+
+	if (!stream) {
+		return;
+	}
+
+	if (opened) {
+		_onstream(stream);
+	}
+
+	// Already on the channel's loop, routed callbacks hand the call to their executor themselves.
+	stream->_onmessage(data->Slice(kStreamHeader, data->ByteLength()), binary);
+}
+
+void RTCDataChannelMuxInternal::Schedule(ReadyCallbacks* ready) {
+	while (!_closed && !_active.empty() && _estimate < _options.highWaterMark) {
+		auto level = _active.begin();
+		RTCDataChannelMuxStream* stream = level->second.front();
+		const auto& next = stream->_pending.front();
+		const ArrayBuffer& payload = *next.data;
+		uint64_t size = payload.ByteLength();
+
+		// Deficit round robin: without budget for its next message the stream earns its quantum and goes to the back.
+		if (stream->_deficit < size) {
+			stream->_deficit += kQuantum * stream->_weight;
+			level->second.pop_front();
+			level->second.push_back(stream);
+			continue;
+		}
+
+		uint8_t header[kStreamHeader];
+
+		for (size_t index = 0; index < kStreamHeader; index++) {
+			header[index] = static_cast<uint8_t>(stream->_id >> (index * 8));
+		}
+
+		_fragments[0].data = header;
+		_fragments[0].length = kStreamHeader;
+		_fragments[1].data = payload.Data();
+		_fragments[1].length = size;
+
+		_channel->Send(_fragments, next.binary);
+
+		_estimate += kStreamHeader + size;
+		stream->_deficit -= size;
+		stream->_queued -= size;
+		stream->_pending.pop_front();
+
+		if (stream->_pending.empty()) {
+			Deactivate(stream);
+		}
+
+		if (!stream->_ready.empty() && stream->_queued <= _options.streamLowWaterMark) {
+			std::move(stream->_ready.begin(), stream->_ready.end(), std::back_inserter(*ready));
+			stream->_ready.clear();
+		}
+	}
+}
+
+void RTCDataChannelMuxInternal::Activate(RTCDataChannelMuxStream* stream) {
+	if (!stream->_active && !stream->_pending.empty()) {
+		_active[stream->_priority].push_back(stream);
+		stream->_active = true;
+	}
+}
+
+void RTCDataChannelMuxInternal::Deactivate(RTCDataChannelMuxStream* stream) {
+	if (!stream->_active) {
+		return;
+	}
+
+	auto level = _active.find(stream->_priority);
+
+	if (level != _active.end()) {
+		level->second.erase(std::remove(level->second.begin(), level->second.end(), stream), level->second.end());
+
+		if (level->second.empty()) {
+			_active.erase(level);
+		}
+	}
+
+	stream->_active = false;
+	stream->_deficit = 0;
+}
+
+void RTCDataChannelMuxInternal::Drop(RTCDataChannelMuxStream* stream, ReadyCallbacks* ready) {
+	Deactivate(stream);
+
+	stream->_pending.clear();
+	stream->_queued = 0;
+
+	std::move(stream->_ready.begin(), stream->_ready.end(), std::back_inserter(*ready));
+	stream->_ready.clear();
+}
+
+std::shared_ptr<RTCDataChannelMuxStream> RTCDataChannelMuxInternal::Open(uint32_t id, int priority, uint32_t weight) {
+	auto stream = std::make_shared<RTCDataChannelMuxStream>(shared_from_this(), id, priority, weight);
+
+	_streams[id] = stream;
+	return stream;
+}
+
+void RTCDataChannelMuxInternal::Deliver(ReadyCallbacks callbacks, const std::shared_ptr<Error>& error) {
+	const auto& loop = _channel->Loop();
+
+	for (auto& callback : callbacks) {
+		if (loop) {
+			loop->Post([callback = std::move(callback), error]() {
+				callback(error);
+			});
+		}
+		else {
+			callback(error);
+		}
+	}
+}
+
+RTCDataChannelMuxStream::RTCDataChannelMuxStream(const std::shared_ptr<RTCDataChannelMuxInternal>& mux, uint32_t id, int priority, uint32_t weight) :
+	_mux(mux),
+	_id(id),
+	_priority(priority),
+	_weight(std::max<uint32_t>(weight, 1)),
+	_deficit(0),
+	_queued(0),
+	_active(false),
+	_open(true)
+{
+
+}
+
+RTCDataChannelMuxStream::~RTCDataChannelMuxStream() {
+
+}
+
+uint32_t RTCDataChannelMuxStream::Id() const {
+	return _id;
+}
+
+int RTCDataChannelMuxStream::Priority() {
+	auto mux = _mux.lock();
+
+	if (!mux) {
+		return _priority;
+	}
+
+	std::lock_guard<std::mutex> lock(mux->_mutex);
+	return _priority;
+}
+
+uint32_t RTCDataChannelMuxStream::Weight() {
+	auto mux = _mux.lock();
+
+	if (!mux) {
+		return _weight;
+	}
+
+	std::lock_guard<std::mutex> lock(mux->_mutex);
+	return _weight;
+}
+
+void RTCDataChannelMuxStream::SetPriority(int priority, uint32_t weight) {
+	auto mux = _mux.lock();
+
+	if (!mux) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mux->_mutex);
+
+	mux->Deactivate(this);
+	_priority = priority;
+	_weight = std::max<uint32_t>(weight, 1);
+	mux->Activate(this);
+}
+
+uint64_t RTCDataChannelMuxStream::BufferedAmount() {
+	auto mux = _mux.lock();
+
+	if (!mux) {
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock(mux->_mutex);
+	return _queued;
+}
+
+bool RTCDataChannelMuxStream::Write(const std::shared_ptr<ArrayBuffer>& data, bool binary) {
+	auto mux = _mux.lock();
+
+	if (!mux || !data) {
+		return false;
+	}
+
+	RTCDataChannelMuxInternal::ReadyCallbacks ready;
+	bool writable;
+
+	{
+		std::lock_guard<std::mutex> lock(mux->_mutex);
+
+		if (!_open || mux->_closed) {
+			return false;
+		}
+
+		_pending.push_back(Pending{ data, binary });
+		_queued += data->ByteLength();
+
+		mux->Activate(this);
+		mux->Schedule(&ready);
+
+		writable = _queued < mux->_options.streamHighWaterMark;
+	}
+
+	mux->Deliver(std::move(ready), nullptr);
+	return writable;
+}
+
+void RTCDataChannelMuxStream::Ready(std::function<void(std::shared_ptr<Error>)> callback) {
+	if (!callback) {
+		return;
+	}
+
+	auto mux = _mux.lock();
+
+	if (!mux) {
+		return callback(Error::New("DataChannelMux is closed.", __FILE__, __LINE__));
+	}
+
+	RTCDataChannelMuxInternal::ReadyCallbacks ready;
+	std::shared_ptr<Error> error;
+
+	{
+		std::lock_guard<std::mutex> lock(mux->_mutex);
+
+		if (!_open || mux->_closed) {
+			error = Error::New("Stream is closed.", __FILE__, __LINE__);
+			ready.push_back(std::move(callback));
+		}
+		else if (_queued < mux->_options.streamHighWaterMark) {
+			ready.push_back(std::move(callback));
+		}
+		else {
+			_ready.push_back(std::move(callback));
+		}
+	}
+
+	mux->Deliver(std::move(ready), error);
+}
+
+void RTCDataChannelMuxStream::Close() {
+	auto mux = _mux.lock();
+
+	if (!mux) {
+		return;
+	}
+
+	// The mux may hold the last reference.
+	std::shared_ptr<RTCDataChannelMuxStream> self;
+	RTCDataChannelMuxInternal::ReadyCallbacks ready;
+
+	{
+		std::lock_guard<std::mutex> lock(mux->_mutex);
+
+		if (!_open) {
+			return;
+		}
+
+		mux->Drop(this, &ready);
+		_open = false;
+
+		auto it = mux->_streams.find(_id);
+
+		if (it != mux->_streams.end() && it->second.get() == this) {
+			self = std::move(it->second);
+			mux->_streams.erase(it);
+			mux->_closedIds.insert(_id);
+		}
+	}
+
+	mux->Deliver(std::move(ready), Error::New("Stream is closed.", __FILE__, __LINE__));
+}
+
+void RTCDataChannelMuxStream::onMessage(std::function<void(std::shared_ptr<ArrayBuffer>, bool)> callback, const std::shared_ptr<Executor>& executor) {
+	_onmessage.Set(callback, executor);
+}
+
+RTCDataChannelMux::Stream::Stream() {
+
+}
+
+RTCDataChannelMux::Stream::~Stream() {
+
+}
+
+RTCDataChannelMux::RTCDataChannelMux() {
+
+}
+
+RTCDataChannelMux::~RTCDataChannelMux() {
+
+}
@@ -0,0 +1,122 @@
+#ifndef CRTC_RTCDATACHANNELMUX_H
+#define CRTC_RTCDATACHANNELMUX_H
+
+#include "crtc.h"
+#include "rtcdatachannel.h"
+#include "executor.h"
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace crtc {
+	class RTCDataChannelMuxInternal;
+
+	class RTCDataChannelMuxStream : public RTCDataChannelMux::Stream {
+		friend class RTCDataChannelMuxInternal;
+
+	public:
+		explicit RTCDataChannelMuxStream(const std::shared_ptr<RTCDataChannelMuxInternal>& mux, uint32_t id, int priority, uint32_t weight);
+		virtual ~RTCDataChannelMuxStream() override;
+
+		uint32_t Id() const override;
+		int Priority() override;
+		uint32_t Weight() override;
+		void SetPriority(int priority, uint32_t weight = 1) override;
+
+		uint64_t BufferedAmount() override;
+
+		bool Write(const std::shared_ptr<ArrayBuffer>& data, bool binary = true) override;
+		void Ready(std::function<void(std::shared_ptr<Error>)> callback) override;
+		void Close() override;
+
+		void onMessage(std::function<void(std::shared_ptr<ArrayBuffer>, bool)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+
+	private:
+		struct Pending {
+			std::shared_ptr<ArrayBuffer> data;
+			bool binary;
+		};
+
+		std::weak_ptr<RTCDataChannelMuxInternal> _mux;
+		uint32_t _id;
+
+		// Guarded by the mux's mutex. _deficit is the byte budget left in the current round, it grows by weight
+		// quanta each time the stream comes up without enough budget for its next message.
+		int _priority;
+		uint32_t _weight;
+		uint64_t _deficit;
+		uint64_t _queued;
+		bool _active;
+		bool _open;
+		std::deque<Pending> _pending;
+		std::vector<std::function<void(std::shared_ptr<Error>)>> _ready;
+
+		routed_callback<synchronized_callback, std::shared_ptr<ArrayBuffer>, bool> _onmessage;
+	};
+
+	class RTCDataChannelMuxInternal : public RTCDataChannelMux, public std::enable_shared_from_this<RTCDataChannelMuxInternal> {
+		friend class RTCDataChannelMuxStream;
+
+	public:
+		explicit RTCDataChannelMuxInternal(const std::shared_ptr<RTCDataChannelInternal>& channel, const RTCDataChannelMux::Options& options);
+		virtual ~RTCDataChannelMuxInternal() override;
+
+		// Takes over the channel's onMessage and flow hook, needs shared_from_this().
+		void Attach();
+
+		std::shared_ptr<RTCDataChannel> Channel() const override;
+		std::shared_ptr<RTCDataChannelMux::Stream> CreateStream(uint32_t id, int priority = 0, uint32_t weight = 1) override;
+
+		void onStream(std::function<void(std::shared_ptr<RTCDataChannelMux::Stream>)> callback) override;
+
+	private:
+		typedef std::vector<std::function<void(std::shared_ptr<Error>)>> ReadyCallbacks;
+
+		// Called by the channel on webrtc threads.
+		void OnFlow(uint64_t amount, bool closing);
+
+		// Called on the channel's loop.
+		void OnMessage(const std::shared_ptr<ArrayBuffer>& data, bool binary);
+
+		// The rest is called with _mutex held. Schedule() hands queued writes to the channel while the estimate stays
+		// below highWaterMark and collects the Ready() callbacks of streams that drained to streamLowWaterMark.
+		void Schedule(ReadyCallbacks* ready);
+		void Activate(RTCDataChannelMuxStream* stream);
+		void Deactivate(RTCDataChannelMuxStream* stream);
+		void Drop(RTCDataChannelMuxStream* stream, ReadyCallbacks* ready);
+		std::shared_ptr<RTCDataChannelMuxStream> Open(uint32_t id, int priority, uint32_t weight);
+
+		void Deliver(ReadyCallbacks callbacks, const std::shared_ptr<Error>& error);
+
+		std::shared_ptr<RTCDataChannelInternal> _channel;
+		RTCDataChannelMux::Options _options;
+
+		std::mutex _mutex;
+		bool _closed;
+
+		// Upper bound of the channel's BufferedAmount(): the last amount it reported plus what was sent since.
+		uint64_t _estimate;
+
+		// Token of the channel's flow hook, see RTCDataChannelInternal::onFlow().
+		uint64_t _flow;
+
+		// Reused for every send, header and payload go out with one copy.
+		std::vector<RTCDataChannel::Fragment> _fragments;
+
+		std::map<uint32_t, std::shared_ptr<RTCDataChannelMuxStream>> _streams;
+
+		// Ids of streams closed here, the remote end does not get to reopen them.
+		std::set<uint32_t> _closedIds;
+
+		// Streams with queued writes, highest priority first and round robin within a priority.
+		std::map<int, std::deque<RTCDataChannelMuxStream*>, std::greater<int>> _active;
+
+		synchronized_callback<std::shared_ptr<RTCDataChannelMux::Stream>> _onstream;
+	};
+}
+
+#endif
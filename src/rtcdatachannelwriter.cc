@@ -0,0 +1,142 @@
+#include "rtcdatachannelwriter.h"
+
+using namespace crtc;
+
+std::shared_ptr<RTCDataChannelWriter> RTCDataChannelWriter::New(const std::shared_ptr<RTCDataChannel>& channel, const Options& options) {
+	auto internal = std::dynamic_pointer_cast<RTCDataChannelInternal>(channel);
+
+	if (internal) {
+		return std::make_shared<RTCDataChannelWriterInternal>(internal, options);
+	}
+
+	return nullptr;
+}
+
+RTCDataChannelWriterInternal::RTCDataChannelWriterInternal(const std::shared_ptr<RTCDataChannelInternal>& channel, const RTCDataChannelWriter::Options& options) :
+	_channel(channel),
+	_options(options),
+	_estimate(0),
+	_waiting(false),
+	_flow(0)
+{
+	if (_options.lowWaterMark > _options.highWaterMark) {
+		_options.lowWaterMark = _options.highWaterMark;
+	}
+
+	_estimate.store(_channel->BufferedAmount());
+
+	_flow = _channel->onFlow([this](uint64_t amount, bool closing) {
+		OnFlow(amount, closing);
+	});
+}
+
+RTCDataChannelWriterInternal::~RTCDataChannelWriterInternal() {
+	// Waits for a flow call in progress, nothing reaches this writer afterwards. A writer that replaced this one keeps
+	// its hook.
+	_channel->ClearFlow(_flow);
+}
+
+std::shared_ptr<RTCDataChannel> RTCDataChannelWriterInternal::Channel() const {
+	return _channel;
+}
+
+bool RTCDataChannelWriterInternal::Writable() {
+	return Account(0);
+}
+
+bool RTCDataChannelWriterInternal::Write(const std::shared_ptr<ArrayBuffer>& data, bool binary) {
+	if (!data) {
+		return Writable();
+	}
+
+	uint64_t bytes = data->ByteLength();
+
+	_channel->Send(data, binary);
+	return Account(bytes);
+}
+
+bool RTCDataChannelWriterInternal::Write(const std::vector<std::shared_ptr<ArrayBuffer>>& buffers, bool binary) {
+	uint64_t bytes = 0;
+
+	for (const auto& data : buffers) {
+		bytes += data ? data->ByteLength() : 0;
+	}
+
+	_channel->SendBatch(buffers, binary);
+	return Account(bytes);
+}
+
+void RTCDataChannelWriterInternal::Ready(std::function<void(std::shared_ptr<Error>)> callback) {
+	if (!callback) {
+		return;
+	}
+
+	if (Writable()) {
+		Deliver(std::move(callback), nullptr);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_ready.push_back(std::move(callback));
+		_waiting.store(true);
+	}
+
+	// The channel may have drained or closed between Writable() and the registration, no flow call would follow.
+	RTCDataChannel::State state = _channel->ReadyState();
+	OnFlow(_channel->BufferedAmount(), state == RTCDataChannel::kClosing || state == RTCDataChannel::kClosed);
+}
+
+void RTCDataChannelWriterInternal::OnFlow(uint64_t amount, bool closing) {
+	_estimate.store(amount);
+
+	if (!_waiting.load() || (!closing && amount > _options.lowWaterMark)) {
+		return;
+	}
+
+	std::vector<std::function<void(std::shared_ptr<Error>)>> ready;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		ready.swap(_ready);
+		_waiting.store(false);
+	}
+
+	auto error = closing ? Error::New("DataChannel is closed.", __FILE__, __LINE__) : nullptr;
+
+	for (auto& callback : ready) {
+		Deliver(std::move(callback), error);
+	}
+}
+
+void RTCDataChannelWriterInternal::Deliver(std::function<void(std::shared_ptr<Error>)> callback, const std::shared_ptr<Error>& error) {
+	const auto& loop = _channel->Loop();
+
+	if (loop) {
+		loop->Post([callback = std::move(callback), error]() {
+			callback(error);
+		});
+	}
+	else {
+		callback(error);
+	}
+}
+
+bool RTCDataChannelWriterInternal::Account(uint64_t bytes) {
+	if (_estimate.fetch_add(bytes) + bytes < _options.highWaterMark) {
+		return true;
+	}
+
+	uint64_t amount = _channel->BufferedAmount();
+
+	_estimate.store(amount);
+	return amount < _options.highWaterMark;
+}
+
+RTCDataChannelWriter::RTCDataChannelWriter() {
+
+}
+
+RTCDataChannelWriter::~RTCDataChannelWriter() {
+
+}
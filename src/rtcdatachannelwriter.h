@@ -0,0 +1,47 @@
+#ifndef CRTC_RTCDATACHANNELWRITER_H
+#define CRTC_RTCDATACHANNELWRITER_H
+
+#include "crtc.h"
+#include "rtcdatachannel.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace crtc {
+	class RTCDataChannelWriterInternal : public RTCDataChannelWriter {
+	public:
+		explicit RTCDataChannelWriterInternal(const std::shared_ptr<RTCDataChannelInternal>& channel, const RTCDataChannelWriter::Options& options);
+		virtual ~RTCDataChannelWriterInternal() override;
+
+		std::shared_ptr<RTCDataChannel> Channel() const override;
+
+		bool Writable() override;
+
+		bool Write(const std::shared_ptr<ArrayBuffer>& data, bool binary = true) override;
+		bool Write(const std::vector<std::shared_ptr<ArrayBuffer>>& buffers, bool binary = true) override;
+
+		void Ready(std::function<void(std::shared_ptr<Error>)> callback) override;
+
+	private:
+		// Called by the channel on webrtc threads.
+		void OnFlow(uint64_t amount, bool closing);
+
+		void Deliver(std::function<void(std::shared_ptr<Error>)> callback, const std::shared_ptr<Error>& error);
+
+		// Adds bytes to the estimate and asks the channel only when the estimate reached highWaterMark.
+		bool Account(uint64_t bytes);
+
+		std::shared_ptr<RTCDataChannelInternal> _channel;
+		RTCDataChannelWriter::Options _options;
+
+		// Upper bound of BufferedAmount(): the last amount the channel reported plus what was written since.
+		std::atomic<uint64_t> _estimate;
+		std::atomic<bool> _waiting;
+		uint64_t _flow;
+
+		std::mutex _mutex;
+		std::vector<std::function<void(std::shared_ptr<Error>)>> _ready;
+	};
+}
+
+#endif
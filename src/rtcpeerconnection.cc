@@ -26,72 +26,24 @@
 #include "rtcpeerconnection.h"
 #include "rtcdatachannel.h"
 #include "mediastream.h"
-#include "customaudiofactory.h"
-#include "customvideofactory.h"
 #include "api/audio_codecs/builtin_audio_decoder_factory.h"
-#include "api/audio_codecs/builtin_audio_encoder_factory.h"
 #include "api/video_codecs/video_decoder_factory.h"
 #include "api/video_codecs/video_decoder_factory_template.h"
 #include "api/video_codecs/video_decoder_factory_template_open_h264_adapter.h"
-#include "api/video_codecs/video_encoder_factory.h"
-#include "api/video_codecs/video_encoder_factory_template.h"
-#include "api/video_codecs/video_encoder_factory_template_open_h264_adapter.h"
 #include "rtc_base/logging.h"
-#include "fakeaudiodevice.h"
-#ifdef __ANDROID__
-#include <unistd.h>
-#endif
 
 using namespace crtc;
 
-RTCPeerConnectionInternal::RTCPeerConnectionInternal() {
-	webrtc::PeerConnectionInterface::RTCConfiguration cfg(webrtc::PeerConnectionInterface::RTCConfigurationType::kAggressive);
-
+RTCPeerConnectionInternal::RTCPeerConnectionInternal(const std::shared_ptr<RTCPeerConnectionFactoryInternal>& context, RTCPeerConnectionShard* shard, const std::shared_ptr<EventLoopInternal>& loop) :
+	_context(context),
+	_shard(shard),
+	_loop(loop),
+	_sctp(std::make_shared<SctpTuning>()),
+	_pending_candidates(std::make_shared<CandidateQueue>())
+{
 	_settingLocalDesc = _settingRemoteDesc = false;
-
-	_task_queue = webrtc::CreateDefaultTaskQueueFactory();
-
-	_network_thread = rtc::Thread::CreateWithSocketServer();
-	_network_thread->SetName("network", nullptr);
-
-	if (!_network_thread->Start()) {
-		rtc::webrtc_logging_impl::LogCall();
-	}
-
-	_signal_thread = rtc::Thread::CreateWithSocketServer();
-	_signal_thread->SetName("signal", nullptr);
-
-	if (!_signal_thread->Start()) {
-		rtc::webrtc_logging_impl::LogCall();
-	}
-
-	_worker_thread = rtc::Thread::Create();
-	_worker_thread->SetName("worker", nullptr);
-
-	if (!_worker_thread->Start()) {
-		rtc::webrtc_logging_impl::LogCall();
-	}
-
-	//auto audio_device = webrtc::AudioDeviceModule::Create(webrtc::AudioDeviceModule::kDummyAudio, _task_queue.get());
-	auto audio_device = FakeAudioDeviceModule::Create(); // new webrtc::FakeAudioDeviceModule();
-
-	//if (audio_device && !audio_device->Initialized()) {
-	//	audio_device->Init();
-	//}
-
-	_factory = webrtc::CreatePeerConnectionFactory(
-		_network_thread.get(),
-		_worker_thread.get(),
-		_signal_thread.get(),
-		audio_device,
-		webrtc::CreateBuiltinAudioEncoderFactory(),
-		rtc::make_ref_counted<CustomAudioFactory>(this),
-		std::make_unique<webrtc::VideoEncoderFactoryTemplate<webrtc::OpenH264EncoderTemplateAdapter>>(),
-		std::make_unique<CustomVideoFactory>(this),
-		nullptr, //rtc::scoped_refptr<AudioMixer> audio_mixer,
-		nullptr, //rtc::scoped_refptr<AudioProcessing> audio_processing,
-		nullptr, //std::unique_ptr<AudioFrameProcessor> owned_audio_frame_processor,
-		nullptr); //std::unique_ptr<FieldTrialsView> field_trials = nullptr)
+	_closed = false;
+	_factory = _context->CreateFactory(this, _shard, _sctp);
 }
 
 RTCPeerConnectionInternal::~RTCPeerConnectionInternal() {
@@ -104,16 +56,25 @@ RTCPeerConnectionInternal::~RTCPeerConnectionInternal() {
 		s->ClearObserver();
 	}
 
-	//Process any remaining events before we delete
-	while (Module::DispatchEvents(false) || _settingRemoteDesc || _settingRemoteDesc) {
-#ifdef __ANDROID__
-		sleep(1);
-#else
-		std::this_thread::sleep_for(std::chrono::milliseconds(1));
-#endif
+	_streams.clear();
+
+	// CloseAsync() released the shard already.
+	if (!_closed) {
+		_context->Release(_shard);
 	}
+}
 
-	_streams.clear();
+void RTCPeerConnectionInternal::Destroy(RTCPeerConnectionInternal* pc) {
+	std::unique_ptr<RTCPeerConnectionInternal> owned(pc);
+	auto loop = EventLoopInternal::From(pc->_loop);
+
+	if (loop->GetThread()->IsCurrent()) {
+		return;
+	}
+
+	loop->Post([owned = std::move(owned)]() mutable {
+		owned.reset();
+	});
 }
 
 std::shared_ptr<RTCDataChannel> RTCPeerConnectionInternal::CreateDataChannel(const String& label, const RTCDataChannelInit& options) {
@@ -122,69 +83,121 @@ std::shared_ptr<RTCDataChannel> RTCPeerConnectionInternal::CreateDataChannel(con
 	init.ordered = options.ordered;
 	init.maxRetransmitTime = options.maxPacketLifeTime;
 	init.maxRetransmits = options.maxRetransmits;
-	init.protocol = options.protocol;
+	init.protocol = options.coalescing ? DataChannelCoalescer::Negotiate(std::string(options.protocol)) : std::string(options.protocol);
+	init.protocol = options.compression ? DataChannelCompressor::Negotiate(init.protocol) : init.protocol;
 	init.negotiated = options.negotiated;
 	init.id = options.id;
 
-	if (_socket)
+	auto socket = Socket();
+
+	if (socket)
 	{
-		//rtc::scoped_refptr<webrtc::DataChannelInterface> channel = _socket->CreateDataChannel(label, &init);
-		auto error_or_datachannel = _socket->CreateDataChannelOrError(std::string(label), &init);
+		//rtc::scoped_refptr<webrtc::DataChannelInterface> channel = socket->CreateDataChannel(label, &init);
+		auto error_or_datachannel = socket->CreateDataChannelOrError(std::string(label), &init);
 		if (!error_or_datachannel.ok())
 		{
 			return nullptr;
 		}
-		return std::make_shared<RTCDataChannelInternal>(std::move(error_or_datachannel.value()));
+		auto channel = std::make_shared<RTCDataChannelInternal>(std::move(error_or_datachannel.value()), _loop, NetworkThread());
+
+		if (options.compression) {
+			channel->ConfigureCompression(options.compressionThreshold, options.compressionLevel);
+		}
+
+		if (options.coalescing) {
+			channel->ConfigureCoalescing(options.coalescingDelay, options.coalescingMaxSize);
+		}
+
+		return channel;
 	}
 
 	return nullptr;
 }
 
-void RTCPeerConnectionInternal::AddIceCandidate(const RTCPeerConnection::RTCIceCandidate& candidate) {
-	Promise<>::New([=](
-		const Promise<>::FullFilledCallback& resolve,
-		const Promise<>::RejectedCallback& reject) {
-			webrtc::SdpParseError error;
-			webrtc::IceCandidateInterface* ice = webrtc::CreateIceCandidate(std::string(candidate.sdpMid), candidate.sdpMLineIndex, std::string(candidate.candidate), &error);
-
-			if (ice && _socket) {
-				if (!_socket->pending_remote_description() && !_socket->current_remote_description()) {
-					_pending_candidates.push_back([=]() {
-						if (_socket->AddIceCandidate(ice)) {
-							return resolve();
-						}
-
-						if (error.description.empty()) {
-							if (!_socket->pending_remote_description() && !_socket->current_remote_description()) {
-								return reject(Error::New("ICE candidates can't be added without any remote session description.", __FILE__, __LINE__));
-							}
-
-							return reject(Error::New("Candidate cannot be used.", __FILE__, __LINE__));
-						}
-						});
-				}
-				else {
-					if (_socket->AddIceCandidate(ice)) {
-						return resolve();
-					}
-
-					if (error.description.empty()) {
-						if (!_socket->pending_remote_description() && !_socket->current_remote_description()) {
-							return reject(Error::New("ICE candidates can't be added without any remote session description.", __FILE__, __LINE__));
-						}
-
-						return reject(Error::New("Candidate cannot be used.", __FILE__, __LINE__));
-					}
-				}
+void RTCPeerConnectionInternal::AddIceCandidate(const RTCPeerConnection::RTCIceCandidate& candidate, std::function<void(std::shared_ptr<Error>)> callback) {
+	std::function<void(std::vector<std::shared_ptr<Error>>)> done;
+
+	if (callback) {
+		done = [callback](std::vector<std::shared_ptr<Error>> errors) {
+			callback(errors.front());
+		};
+	}
+
+	AddIceCandidates(std::vector<RTCPeerConnection::RTCIceCandidate>(1, candidate), done);
+}
+
+void RTCPeerConnectionInternal::AddIceCandidates(const std::vector<RTCPeerConnection::RTCIceCandidate>& candidates, std::function<void(std::vector<std::shared_ptr<Error>>)> callback) {
+	auto batch = std::make_shared<CandidateBatch>();
+	auto socket = Socket();
+	auto queue = _pending_candidates;
+
+	batch->callback = std::move(callback);
+	batch->loop = EventLoopInternal::From(_loop);
+	batch->candidates.reserve(candidates.size());
+	batch->errors.reserve(candidates.size());
+
+	// Parsing needs no connection state, it is done here so the signaling thread only applies.
+	for (const auto& candidate : candidates) {
+		webrtc::SdpParseError error;
+		std::unique_ptr<webrtc::IceCandidateInterface> ice(webrtc::CreateIceCandidate(std::string(candidate.sdpMid), candidate.sdpMLineIndex, std::string(candidate.candidate), &error));
+
+		batch->errors.push_back(ice ? nullptr : Error::New(error.description.c_str(), __FILE__, __LINE__));
+		batch->candidates.push_back(std::move(ice));
+	}
+
+	_context->SignalThread()->PostTask([socket, queue, batch]() {
+		if (socket && !socket->pending_remote_description() && !socket->current_remote_description()) {
+			queue->push_back(batch);
+		}
+		else {
+			ApplyCandidates(socket, batch);
+		}
+	});
+}
+
+void RTCPeerConnectionInternal::ApplyCandidates(const rtc::scoped_refptr<webrtc::PeerConnectionInterface>& socket, const std::shared_ptr<CandidateBatch>& batch) {
+	for (size_t index = 0; index < batch->candidates.size(); index++) {
+		if (!batch->candidates[index]) {
+			continue;
+		}
+
+		if (!socket) {
+			batch->errors[index] = Error::New("SOCKET is NULL!", __FILE__, __LINE__);
+		}
+		else if (!socket->AddIceCandidate(batch->candidates[index].get())) {
+			if (!socket->pending_remote_description() && !socket->current_remote_description()) {
+				batch->errors[index] = Error::New("ICE candidates can't be added without any remote session description.", __FILE__, __LINE__);
+			}
+			else {
+				batch->errors[index] = Error::New("Candidate cannot be used.", __FILE__, __LINE__);
 			}
+		}
+	}
 
-			return reject(Error::New(error.description.c_str()));
-		})->WaitForResult();
+	batch->candidates.clear();
+
+	if (batch->callback) {
+		batch->loop->Post([batch]() {
+			batch->callback(batch->errors);
+		});
+	}
+}
+
+void RTCPeerConnectionInternal::FlushCandidates(const rtc::scoped_refptr<webrtc::PeerConnectionInterface>& socket, const std::shared_ptr<CandidateQueue>& queue) {
+	CandidateQueue batches;
+
+	batches.swap(*queue);
+
+	for (const auto& batch : batches) {
+		ApplyCandidates(socket, batch);
+	}
 }
 
 void RTCPeerConnectionInternal::AddStream(const std::shared_ptr<MediaStream>& stream) {
-	if (_socket)
-		_socket->AddStream(reinterpret_cast<webrtc::MediaStreamInterface*>(stream->GetStream()));
+	auto socket = Socket();
+
+	if (socket)
+		socket->AddStream(reinterpret_cast<webrtc::MediaStreamInterface*>(stream->GetStream()));
 }
 
 /*
@@ -194,7 +207,10 @@ std::shared_ptr<RTCPeerConnection::RTCRtpSender> RTCPeerConnectionInternal::AddT
 }
 */
 
-void RTCPeerConnectionInternal::CreateAnswer(std::function<void(RTCPeerConnection::RTCSessionDescription*)> callback, const RTCAnswerOptions& options) {
+void RTCPeerConnectionInternal::CreateAnswer(std::function<void(RTCPeerConnection::RTCSessionDescription*)> callback, const RTCAnswerOptions& options, std::function<void(std::shared_ptr<Error>)> onerror) {
+	// Holds the connection until the continuations ran, the executor and both of them use it.
+	auto self = shared_from_this();
+
 	Promise<RTCPeerConnection::RTCSessionDescription>::New([=](
 		const Promise<RTCPeerConnection::RTCSessionDescription>::FullFilledCallback& resolve,
 		const Promise<RTCPeerConnection::RTCSessionDescription>::RejectedCallback& reject) {
@@ -207,21 +223,33 @@ void RTCPeerConnectionInternal::CreateAnswer(std::function<void(RTCPeerConnectio
 				true  // use_rtp_mux
 			);
 
-			if (observer.get() && _socket) {
-				_socket->CreateAnswer(observer.get(), answer_options);
+			auto socket = self->Socket();
+
+			if (observer.get() && socket) {
+				socket->CreateAnswer(observer.get(), answer_options);
 			}
 			else {
 				reject(Error::New("CreateOfferAnswerObserver Failed", __FILE__, __LINE__));
 			}
-		}
+		}, _loop
 	)
-		->Then([=](RTCPeerConnection::RTCSessionDescription desc) mutable {
-			callback(&desc);
+		->Then([=](RTCPeerConnection::RTCSessionDescription desc) {
+			self->Deliver([=]() mutable {
+				callback(&desc);
+			});
+			}
+		)
+		->Catch([=](const std::shared_ptr<Error>& error) {
+			if (onerror) {
+				self->Deliver([=]() { onerror(error); });
+			}
 			}
 		);
 }
 
-void RTCPeerConnectionInternal::CreateOffer(std::function<void(RTCPeerConnection::RTCSessionDescription*)> callback, const RTCOfferOptions& options) {
+void RTCPeerConnectionInternal::CreateOffer(std::function<void(RTCPeerConnection::RTCSessionDescription*)> callback, const RTCOfferOptions& options, std::function<void(std::shared_ptr<Error>)> onerror) {
+	// Holds the connection until the continuations ran, the executor and both of them use it.
+	auto self = shared_from_this();
 
 	Promise<RTCPeerConnection::RTCSessionDescription>::New([=](
 		const Promise<RTCPeerConnection::RTCSessionDescription>::FullFilledCallback& resolve,
@@ -236,16 +264,26 @@ void RTCPeerConnectionInternal::CreateOffer(std::function<void(RTCPeerConnection
 				true  // use_rtp_mux
 			);
 
-			if (observer.get() && _socket) {
-				_socket->CreateOffer(observer.get(), offer_options);
+			auto socket = self->Socket();
+
+			if (observer.get() && socket) {
+				socket->CreateOffer(observer.get(), offer_options);
 			}
 			else {
 				reject(Error::New("CreateOfferAnswerObserver Failed", __FILE__, __LINE__));
 			}
-		}
+		}, _loop
 	)
-		->Then([=](RTCPeerConnection::RTCSessionDescription desc) mutable {
-			callback(&desc);
+		->Then([=](RTCPeerConnection::RTCSessionDescription desc) {
+			self->Deliver([=]() mutable {
+				callback(&desc);
+			});
+			}
+		)
+		->Catch([=](const std::shared_ptr<Error>& error) {
+			if (onerror) {
+				self->Deliver([=]() { onerror(error); });
+			}
 			}
 		);
 }
@@ -266,11 +304,13 @@ std::shared_ptr<Promise<RTCPeerConnection::RTCCertificate>> RTCPeerConnectionInt
 
 MediaStreams RTCPeerConnectionInternal::GetLocalStreams() {
 	MediaStreams streams;
-	if (_socket)
+	auto socket = Socket();
+
+	if (socket)
 	{
-		rtc::scoped_refptr<webrtc::StreamCollectionInterface> lstreams(_socket->local_streams());
+		rtc::scoped_refptr<webrtc::StreamCollectionInterface> lstreams(socket->local_streams());
 		for (size_t index = 0; index < lstreams->count(); index++) {
-			auto stream = MediaStreamInternal::New(lstreams->at(index));
+			auto stream = MediaStreamInternal::New(lstreams->at(index), _loop);
 
 			if (stream) {
 				streams.push_back(stream);
@@ -283,11 +323,13 @@ MediaStreams RTCPeerConnectionInternal::GetLocalStreams() {
 
 MediaStreams RTCPeerConnectionInternal::GetRemoteStreams() {
 	MediaStreams streams;
-	if (_socket)
+	auto socket = Socket();
+
+	if (socket)
 	{
-		rtc::scoped_refptr<webrtc::StreamCollectionInterface> rstreams(_socket->remote_streams());
+		rtc::scoped_refptr<webrtc::StreamCollectionInterface> rstreams(socket->remote_streams());
 		for (size_t index = 0; index < rstreams->count(); index++) {
-			auto stream = MediaStreamInternal::New(rstreams->at(index));
+			auto stream = MediaStreamInternal::New(rstreams->at(index), _loop);
 
 			if (stream) {
 				streams.push_back(stream);
@@ -299,8 +341,10 @@ MediaStreams RTCPeerConnectionInternal::GetRemoteStreams() {
 }
 
 void RTCPeerConnectionInternal::RemoveStream(const std::shared_ptr<MediaStream>& stream) {
-	if (_socket)
-		_socket->RemoveStream(reinterpret_cast<webrtc::MediaStreamInterface*>(stream->GetStream()));
+	auto socket = Socket();
+
+	if (socket)
+		socket->RemoveStream(reinterpret_cast<webrtc::MediaStreamInterface*>(stream->GetStream()));
 }
 
 /*
@@ -309,16 +353,26 @@ void RTCPeerConnectionInternal::RemoveTrack(const std::shared_ptr<RTCPeerConnect
 }
 */
 
-bool RTCPeerConnectionInternal::SetConfiguration(const RTCPeerConnection::RTCConfiguration& config) {
+bool RTCPeerConnectionInternal::SetConfiguration(const RTCPeerConnection::RTCConfiguration& config, const rtc::scoped_refptr<rtc::RTCCertificate>& certificate) {
 	webrtc::PeerConnectionInterface::RTCConfiguration cfg(webrtc::PeerConnectionInterface::RTCConfigurationType::kAggressive);
 
 	auto error = ParseConfiguration(config, &cfg);
 
 	if (!error) {
+		if (certificate) {
+			cfg.certificates.push_back(certificate);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_sctp->mutex);
+			_sctp->options = config.sctp;
+		}
+
 		webrtc::PeerConnectionDependencies pc_dependencies(this);
 		auto error_or_peer_connection = _factory->CreatePeerConnectionOrError(cfg, std::move(pc_dependencies));
 		if (error_or_peer_connection.ok())
 		{
+			std::lock_guard<std::mutex> lock(_socketMutex);
 			_socket = std::move(error_or_peer_connection.value());
 			return true;
 		}
@@ -327,127 +381,214 @@ bool RTCPeerConnectionInternal::SetConfiguration(const RTCPeerConnection::RTCCon
 	return false;
 }
 
-void RTCPeerConnectionInternal::SetLocalDescription(std::shared_ptr<const RTCSessionDescription> sdp) {
+void RTCPeerConnectionInternal::SetLocalDescription(std::shared_ptr<const RTCSessionDescription> sdp, std::function<void(std::shared_ptr<Error>)> callback) {
+	if (_settingLocalDesc.exchange(true)) {
+		if (callback) {
+			Deliver([=]() { callback(Error::New("SetLocalDescription is already in progress", __FILE__, __LINE__)); });
+		}
 
-	if (!_settingLocalDesc)
-	{
-		_settingLocalDesc = true;
-		Promise<>::New([=](
-			const Promise<>::FullFilledCallback& resolve,
-			const Promise<>::RejectedCallback& reject)
-			{
-				auto desc = SDP2SDP(sdp.get());
-
-				if (desc && _socket) {
-					auto observer = rtc::make_ref_counted<SetLocalDescriptionObserver>(resolve, reject);
-					_socket->SetLocalDescription(std::move(desc), observer);
-				}
-				else {
-					reject(Error::New("Failed to create local description from SDP", __FILE__, __LINE__));
-				}
-			})->Finally([=]() {
-				_settingLocalDesc = false;
-			});
+		return;
 	}
+
+	// Holds the connection until the continuations ran, the executor and both of them use it.
+	auto self = shared_from_this();
+
+	Promise<>::New([=](
+		const Promise<>::FullFilledCallback& resolve,
+		const Promise<>::RejectedCallback& reject)
+		{
+			auto desc = SDP2SDP(sdp.get());
+			auto socket = self->Socket();
+
+			if (desc && socket) {
+				auto observer = rtc::make_ref_counted<SetLocalDescriptionObserver>(resolve, reject);
+				socket->SetLocalDescription(std::move(desc), observer);
+			}
+			else {
+				reject(Error::New("Failed to create local description from SDP", __FILE__, __LINE__));
+			}
+		}, _loop)->Then([=]() {
+			self->_settingLocalDesc = false;
+
+			if (callback) {
+				self->Deliver([=]() { callback(nullptr); });
+			}
+		})->Catch([=](const std::shared_ptr<Error>& error) {
+			self->_settingLocalDesc = false;
+
+			if (callback) {
+				self->Deliver([=]() { callback(error); });
+			}
+		});
 }
 
-void RTCPeerConnectionInternal::SetRemoteDescription(std::shared_ptr<const RTCSessionDescription> sdp) {
-	if (!_settingRemoteDesc)
-	{
-		_settingRemoteDesc = true;
-		Promise<>::New([=](
-			const Promise<>::FullFilledCallback& resolve,
-			const Promise<>::RejectedCallback& reject)
-			{
-				if (_socket) {
-					Promise<>::New([=](const Promise<>::FullFilledCallback& res, const Promise<>::RejectedCallback& rej) {
-						auto desc = SDP2SDP(sdp.get());
-						if (desc)
-						{
-							auto observer = rtc::make_ref_counted<SetRemoteDescriptionObserver>(res, rej);
-							_socket->SetRemoteDescription(std::move(desc), observer);
-						}
-						else {
-							reject(Error::New("Failed to create remote description from SDP", __FILE__, __LINE__));
-						}
-						})->Then([=]()
-							{
-								if (_pending_candidates.size()) {
-									for (const auto& callback : _pending_candidates) {
-										callback();
-									}
-
-									_pending_candidates.clear();
-								}
-								resolve();
-							}
-						)->Catch([=](const std::shared_ptr<Error>& error)
-							{
-								reject(error);
-							});
-				}
-				else {
-					reject(Error::New("SOCKET is NULL!", __FILE__, __LINE__));
-				}
-			})->Finally([=]() {
-				_settingRemoteDesc = false;
-				});
+void RTCPeerConnectionInternal::SetRemoteDescription(std::shared_ptr<const RTCSessionDescription> sdp, std::function<void(std::shared_ptr<Error>)> callback) {
+	if (_settingRemoteDesc.exchange(true)) {
+		if (callback) {
+			Deliver([=]() { callback(Error::New("SetRemoteDescription is already in progress", __FILE__, __LINE__)); });
+		}
+
+		return;
 	}
+
+	// Holds the connection until the continuations ran, the executor and both of them use it.
+	auto self = shared_from_this();
+
+	Promise<>::New([=](
+		const Promise<>::FullFilledCallback& resolve,
+		const Promise<>::RejectedCallback& reject)
+		{
+			auto socket = self->Socket();
+
+			if (!socket) {
+				return reject(Error::New("SOCKET is NULL!", __FILE__, __LINE__));
+			}
+
+			auto desc = SDP2SDP(sdp.get());
+
+			if (desc) {
+				auto queue = self->_pending_candidates;
+
+				// The observer runs on the signaling thread, where the candidate queue lives.
+				auto observer = rtc::make_ref_counted<SetRemoteDescriptionObserver>(resolve, reject, [socket, queue]() {
+					FlushCandidates(socket, queue);
+				});
+
+				socket->SetRemoteDescription(std::move(desc), observer);
+			}
+			else {
+				reject(Error::New("Failed to create remote description from SDP", __FILE__, __LINE__));
+			}
+		}, _loop)->Then([=]() {
+			self->_settingRemoteDesc = false;
+
+			if (callback) {
+				self->Deliver([=]() { callback(nullptr); });
+			}
+		})->Catch([=](const std::shared_ptr<Error>& error) {
+			self->_settingRemoteDesc = false;
+
+			if (callback) {
+				self->Deliver([=]() { callback(error); });
+			}
+		});
 }
 
 void RTCPeerConnectionInternal::Close() {
-	if (_socket && _socket->signaling_state() != webrtc::PeerConnectionInterface::kClosed) {
-		_socket->Close();
+	auto socket = Socket();
+
+	if (socket && socket->signaling_state() != webrtc::PeerConnectionInterface::kClosed) {
+		socket->Close();
 	}
 }
 
+void RTCPeerConnectionInternal::CloseAsync(std::function<void()> callback) {
+	if (_closed.exchange(true)) {
+		return;
+	}
+
+	auto self = shared_from_this();
+	auto loop = EventLoopInternal::From(_loop);
+	auto event = loop->Hold();
+
+	for (const auto& s : _streams)
+	{
+		s->ClearObserver();
+	}
+
+	// Close() and the final releases are blocking calls into the signaling thread, running them there makes them inline.
+	// The decoder factories still point at this connection, so it is kept alive until they are gone.
+	_context->SignalThread()->PostTask([self, loop, callback, event]() mutable {
+		// Handed off here, the webrtc observers run on this thread and the other threads go through Socket().
+		rtc::scoped_refptr<webrtc::PeerConnectionInterface> socket;
+
+		{
+			std::lock_guard<std::mutex> lock(self->_socketMutex);
+			socket = std::move(self->_socket);
+		}
+
+		auto factory = std::move(self->_factory);
+
+		if (socket && socket->signaling_state() != webrtc::PeerConnectionInterface::kClosed) {
+			socket->Close();
+		}
+
+		socket = nullptr;
+		factory = nullptr;
+
+		// _shard stays set, NetworkThread() reads it from other threads. _closed keeps the destructor from releasing again.
+		self->_context->Release(self->_shard);
+
+		// The last reference to the connection is dropped on its loop, not on the signaling thread.
+		loop->Post([self = std::move(self), callback]() {
+			if (callback) {
+				callback();
+			}
+		});
+	});
+}
+
 
 RTCPeerConnection::RTCSessionDescription RTCPeerConnectionInternal::CurrentLocalDescription() {
 	RTCPeerConnection::RTCSessionDescription sdp;
-	if (_socket)
-		SDP2SDP(_socket->current_local_description(), &sdp);
+	auto socket = Socket();
+
+	if (socket)
+		SDP2SDP(socket->current_local_description(), &sdp);
 	return sdp;
 }
 
 RTCPeerConnection::RTCSessionDescription RTCPeerConnectionInternal::CurrentRemoteDescription() {
 	RTCPeerConnection::RTCSessionDescription sdp;
-	if (_socket)
-		SDP2SDP(_socket->current_remote_description(), &sdp);
+	auto socket = Socket();
+
+	if (socket)
+		SDP2SDP(socket->current_remote_description(), &sdp);
 	return sdp;
 }
 
 RTCPeerConnection::RTCSessionDescription RTCPeerConnectionInternal::LocalDescription() {
 	RTCPeerConnection::RTCSessionDescription sdp;
-	if (_socket)
-		SDP2SDP(_socket->local_description(), &sdp);
+	auto socket = Socket();
+
+	if (socket)
+		SDP2SDP(socket->local_description(), &sdp);
 	return sdp;
 }
 
 RTCPeerConnection::RTCSessionDescription RTCPeerConnectionInternal::PendingLocalDescription() {
 	RTCPeerConnection::RTCSessionDescription sdp;
-	if (_socket)
-		SDP2SDP(_socket->pending_local_description(), &sdp);
+	auto socket = Socket();
+
+	if (socket)
+		SDP2SDP(socket->pending_local_description(), &sdp);
 	return sdp;
 }
 
 RTCPeerConnection::RTCSessionDescription RTCPeerConnectionInternal::PendingRemoteDescription() {
 	RTCPeerConnection::RTCSessionDescription sdp;
-	if (_socket)
-		SDP2SDP(_socket->pending_remote_description(), &sdp);
+	auto socket = Socket();
+
+	if (socket)
+		SDP2SDP(socket->pending_remote_description(), &sdp);
 	return sdp;
 }
 
 RTCPeerConnection::RTCSessionDescription RTCPeerConnectionInternal::RemoteDescription() {
 	RTCPeerConnection::RTCSessionDescription sdp;
-	if (_socket)
-		SDP2SDP(_socket->remote_description(), &sdp);
+	auto socket = Socket();
+
+	if (socket)
+		SDP2SDP(socket->remote_description(), &sdp);
 	return sdp;
 }
 
 RTCPeerConnection::RTCIceConnectionState RTCPeerConnectionInternal::IceConnectionState() {
-	if (_socket)
+	auto socket = Socket();
+
+	if (socket)
 	{
-		switch (_socket->ice_connection_state()) {
+		switch (socket->ice_connection_state()) {
 		case webrtc::PeerConnectionInterface::kIceConnectionNew:
 			return RTCPeerConnection::kNew;
 		case webrtc::PeerConnectionInterface::kIceConnectionChecking:
@@ -466,13 +607,15 @@ RTCPeerConnection::RTCIceConnectionState RTCPeerConnectionInternal::IceConnectio
 		}
 	}
 
-	return RTCPeerConnection::kNew;
+	return _closed ? RTCPeerConnection::kClosed : RTCPeerConnection::kNew;
 }
 
 RTCPeerConnection::RTCIceGatheringState RTCPeerConnectionInternal::IceGatheringState() {
-	if (_socket)
+	auto socket = Socket();
+
+	if (socket)
 	{
-		switch (_socket->ice_gathering_state()) {
+		switch (socket->ice_gathering_state()) {
 		case webrtc::PeerConnectionInterface::kIceGatheringNew:
 			return RTCPeerConnection::kNewGathering;
 		case webrtc::PeerConnectionInterface::kIceGatheringGathering:
@@ -486,9 +629,11 @@ RTCPeerConnection::RTCIceGatheringState RTCPeerConnectionInternal::IceGatheringS
 }
 
 RTCPeerConnection::RTCSignalingState RTCPeerConnectionInternal::SignalingState() {
-	if (_socket)
+	auto socket = Socket();
+
+	if (socket)
 	{
-		switch (_socket->signaling_state()) {
+		switch (socket->signaling_state()) {
 		case webrtc::PeerConnectionInterface::kStable:
 			return RTCPeerConnection::kStable;
 		case webrtc::PeerConnectionInterface::kHaveLocalOffer:
@@ -504,32 +649,32 @@ RTCPeerConnection::RTCSignalingState RTCPeerConnectionInternal::SignalingState()
 		}
 	}
 
-	return RTCPeerConnection::kStable;
+	return _closed ? RTCPeerConnection::kSignalingClosed : RTCPeerConnection::kStable;
 }
 
 void RTCPeerConnectionInternal::OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState new_state) {
-	_onsignalingstatechange();
+	Emit(_loop, _onsignalingstatechange);
 
 	if (new_state == webrtc::PeerConnectionInterface::kClosed) {
 		_event.reset();
 	}
 	else if (!_event) {
-		_event = Event::New();
+		_event = _loop ? _loop->Hold() : Event::New();
 	}
 }
 
 void RTCPeerConnectionInternal::OnAddStream(rtc::scoped_refptr<webrtc::MediaStreamInterface> stream) {
-	_streams.emplace_back(MediaStreamInternal::New(stream.get()));
+	_streams.emplace_back(MediaStreamInternal::New(stream.get(), _loop));
 	_streams.back()->onAddTrack(std::bind(&RTCPeerConnectionInternal::OnMediaTrack, this, std::placeholders::_1));
 	_streams.back()->onRemoveTrack(std::bind(&RTCPeerConnectionInternal::OnRemoveMediaTrack, this, std::placeholders::_1));
-	_onaddstream(_streams.back());
+	Emit(_loop, _onaddstream, _streams.back());
 }
 
 void RTCPeerConnectionInternal::OnRemoveStream(rtc::scoped_refptr<webrtc::MediaStreamInterface> stream) {
 	for (const auto& s : _streams)
 	{
 		if (s->IdString() == stream->id()) {
-			_onremovestream(s);
+			Emit(_loop, _onremovestream, s);
 			//_streams.erase(it);
 			break;
 		}
@@ -544,7 +689,7 @@ void RTCPeerConnectionInternal::OnTrack(rtc::scoped_refptr<webrtc::RtpTransceive
 
 void crtc::RTCPeerConnectionInternal::OnMediaTrack(std::shared_ptr<MediaStreamTrack> track)
 {
-	_onaddtrack(track);
+	Emit(_loop, _onaddtrack, track);
 }
 
 void RTCPeerConnectionInternal::OnRemoveTrack(rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver)
@@ -555,29 +700,29 @@ void RTCPeerConnectionInternal::OnRemoveTrack(rtc::scoped_refptr<webrtc::RtpRece
 
 void crtc::RTCPeerConnectionInternal::OnRemoveMediaTrack(std::shared_ptr<MediaStreamTrack> track)
 {
-	_onremovetrack(track);
+	Emit(_loop, _onremovetrack, track);
 }
 
 void RTCPeerConnectionInternal::OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel) {
 	if (data_channel.get()) {
-		auto channel = std::make_shared<RTCDataChannelInternal>(data_channel);
+		auto channel = std::make_shared<RTCDataChannelInternal>(data_channel, _loop, NetworkThread());
 
 		if (channel) {
-			_ondatachannel(channel);
+			Emit(_loop, _ondatachannel, channel);
 		}
 	}
 }
 
 void RTCPeerConnectionInternal::OnRenegotiationNeeded() {
-	_onnegotiationneeded();
+	Emit(_loop, _onnegotiationneeded);
 }
 
 void RTCPeerConnectionInternal::OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state) {
-	_oniceconnectionstatechange();
+	Emit(_loop, _oniceconnectionstatechange);
 }
 
 void RTCPeerConnectionInternal::OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state) {
-	_onicegatheringstatechange();
+	Emit(_loop, _onicegatheringstatechange);
 }
 
 void RTCPeerConnectionInternal::OnIceCandidate(const webrtc::IceCandidateInterface* candidate) {
@@ -590,7 +735,7 @@ void RTCPeerConnectionInternal::OnIceCandidate(const webrtc::IceCandidateInterfa
 
 	if (candidate->ToString(&candidateStr)) {
 		iceCandidate->candidate = candidateStr.c_str();
-		_onicecandidate(iceCandidate);
+		Emit(_loop, _onicecandidate, iceCandidate);
 	}
 }
 
@@ -600,7 +745,7 @@ void crtc::RTCPeerConnectionInternal::OnIceCandidateError(const std::string& add
 }
 
 void RTCPeerConnectionInternal::OnIceCandidatesRemoved(const std::vector<cricket::Candidate>& candidates) {
-	_onicecandidatesremoved();
+	Emit(_loop, _onicecandidatesremoved);
 }
 
 void RTCPeerConnectionInternal::OnIceConnectionReceivingChange(bool receiving) {
@@ -619,79 +764,143 @@ bool crtc::RTCPeerConnectionInternal::BypassAudioDecoder()
 
 void crtc::RTCPeerConnectionInternal::onRawVideo(const webrtc::EncodedImage& input_image, int64_t render_time_ms)
 {
-	if (_onRawVideo)
-		_onRawVideo(input_image.data(), input_image.size(), input_image.FrameType() == webrtc::VideoFrameType::kVideoFrameKey, render_time_ms);
+	if (!_onRawVideo)
+		return;
+
+	bool isKeyFrame = input_image.FrameType() == webrtc::VideoFrameType::kVideoFrameKey;
+
+	if (_loop && !_onRawVideo.Routed()) {
+		auto callback = _onRawVideo.load();
+
+		if (!callback) {
+			return;
+		}
+
+		// The encoded buffer is reference counted, holding it keeps the data valid until the loop runs the callback.
+		auto buffer = input_image.GetEncodedData();
+
+		_loop->Post([=]() {
+			callback(buffer->data(), buffer->size(), isKeyFrame, render_time_ms);
+		});
+	}
+	else {
+		_onRawVideo(input_image.data(), input_image.size(), isKeyFrame, render_time_ms);
+	}
 }
 
 void crtc::RTCPeerConnectionInternal::onRawAudio(const uint8_t* data, size_t data_length)
 {
-	if (_onRawAudio)
+	if (!_onRawAudio)
+		return;
+
+	if (_loop && !_onRawAudio.Routed()) {
+		auto callback = _onRawAudio.load();
+
+		if (!callback) {
+			return;
+		}
+
+		auto buffer = std::make_shared<std::vector<uint8_t>>(data, data + data_length);
+
+		_loop->Post([=]() {
+			callback(buffer->data(), buffer->size());
+		});
+	}
+	else {
 		_onRawAudio(data, data_length);
+	}
 }
 
-void crtc::RTCPeerConnectionInternal::onRawVideo(std::function<void((const unsigned char* data, size_t length, bool isKeyFrame, int64_t renderTimeMs))> callback)
+void crtc::RTCPeerConnectionInternal::onRawVideo(std::function<void((const unsigned char* data, size_t length, bool isKeyFrame, int64_t renderTimeMs))> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onRawVideo = callback;
+	auto target = ExecutorInternal::From(executor);
+
+	if (!target || target->IsInline() || !callback) {
+		_onRawVideo.Set(callback, executor);
+		return;
+	}
+
+	// Only the pointer reaches the callback cell, the executor gets a copy of the encoded data.
+	_onRawVideo.SetRouted([target, callback](const unsigned char* data, size_t length, bool isKeyFrame, int64_t renderTimeMs) {
+		auto buffer = std::make_shared<std::vector<uint8_t>>(data, data + length);
+
+		target->Execute([=]() {
+			callback(buffer->data(), buffer->size(), isKeyFrame, renderTimeMs);
+		});
+	});
 }
 
-void crtc::RTCPeerConnectionInternal::onRawAudio(std::function<void((const unsigned char* data, size_t length))> callback)
+void crtc::RTCPeerConnectionInternal::onRawAudio(std::function<void((const unsigned char* data, size_t length))> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onRawAudio = callback;
+	auto target = ExecutorInternal::From(executor);
+
+	if (!target || target->IsInline() || !callback) {
+		_onRawAudio.Set(callback, executor);
+		return;
+	}
+
+	_onRawAudio.SetRouted([target, callback](const unsigned char* data, size_t length) {
+		auto buffer = std::make_shared<std::vector<uint8_t>>(data, data + length);
+
+		target->Execute([=]() {
+			callback(buffer->data(), buffer->size());
+		});
+	});
 }
 
-void crtc::RTCPeerConnectionInternal::onAddTrack(std::function<void(const std::shared_ptr<MediaStreamTrack>)> callback)
+void crtc::RTCPeerConnectionInternal::onAddTrack(std::function<void(const std::shared_ptr<MediaStreamTrack>)> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onaddtrack = callback;
+	_onaddtrack.Set(callback, executor);
 }
 
-void crtc::RTCPeerConnectionInternal::onRemoveTrack(std::function<void(const std::shared_ptr<MediaStreamTrack>)> callback)
+void crtc::RTCPeerConnectionInternal::onRemoveTrack(std::function<void(const std::shared_ptr<MediaStreamTrack>)> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onremovetrack = callback;
+	_onremovetrack.Set(callback, executor);
 }
 
-void crtc::RTCPeerConnectionInternal::onAddStream(std::function<void(const std::shared_ptr<MediaStream>)> callback)
+void crtc::RTCPeerConnectionInternal::onAddStream(std::function<void(const std::shared_ptr<MediaStream>)> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onaddstream = callback;
+	_onaddstream.Set(callback, executor);
 }
 
-void crtc::RTCPeerConnectionInternal::onRemoveStream(std::function<void(const std::shared_ptr<MediaStream>)> callback)
+void crtc::RTCPeerConnectionInternal::onRemoveStream(std::function<void(const std::shared_ptr<MediaStream>)> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onremovestream = callback;
+	_onremovestream.Set(callback, executor);
 }
 
-void crtc::RTCPeerConnectionInternal::onDataChannel(std::function<void(const std::shared_ptr<RTCDataChannel>)> callback)
+void crtc::RTCPeerConnectionInternal::onDataChannel(std::function<void(const std::shared_ptr<RTCDataChannel>)> callback, const std::shared_ptr<Executor>& executor)
 {
-	_ondatachannel = callback;
+	_ondatachannel.Set(callback, executor);
 }
 
-void crtc::RTCPeerConnectionInternal::onIceCandidate(std::function<void(const std::shared_ptr<RTCIceCandidate>)> callback)
+void crtc::RTCPeerConnectionInternal::onIceCandidate(std::function<void(const std::shared_ptr<RTCIceCandidate>)> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onicecandidate = callback;
+	_onicecandidate.Set(callback, executor);
 }
 
-void crtc::RTCPeerConnectionInternal::onNegotiationNeeded(std::function<void()> callback)
+void crtc::RTCPeerConnectionInternal::onNegotiationNeeded(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onnegotiationneeded = callback;
+	_onnegotiationneeded.Set(callback, executor);
 }
 
-void crtc::RTCPeerConnectionInternal::onsignalingstatechange(std::function<void()> callback)
+void crtc::RTCPeerConnectionInternal::onsignalingstatechange(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onsignalingstatechange = callback;
+	_onsignalingstatechange.Set(callback, executor);
 }
 
-void crtc::RTCPeerConnectionInternal::onIceGatheringStateChange(std::function<void()> callback)
+void crtc::RTCPeerConnectionInternal::onIceGatheringStateChange(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onicegatheringstatechange = callback;
+	_onicegatheringstatechange.Set(callback, executor);
 }
 
-void crtc::RTCPeerConnectionInternal::onIceConnectionStateChange(std::function<void()> callback)
+void crtc::RTCPeerConnectionInternal::onIceConnectionStateChange(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
 {
-	_oniceconnectionstatechange = callback;
+	_oniceconnectionstatechange.Set(callback, executor);
 }
 
-void crtc::RTCPeerConnectionInternal::onIceCandidatesRemoved(std::function<void()> callback)
+void crtc::RTCPeerConnectionInternal::onIceCandidatesRemoved(std::function<void()> callback, const std::shared_ptr<Executor>& executor)
 {
-	_onicecandidatesremoved = callback;
+	_onicecandidatesremoved.Set(callback, executor);
 }
 
 // DEPRECATED -> //
@@ -711,11 +920,31 @@ void RTCPeerConnectionInternal::OnRemoveStream(webrtc::MediaStreamInterface* str
 // <- DEPRECATED //
 
 
-std::shared_ptr<RTCPeerConnection> RTCPeerConnection::New(const RTCPeerConnection::RTCConfiguration& config) {
-	auto pc = std::make_shared<RTCPeerConnectionInternal>();
-	if (pc && pc->SetConfiguration(config))
-		return pc;
-	return nullptr;
+void RTCPeerConnectionInternal::Deliver(std::function<void()> callback) {
+	// Promise continuations run on the signaling thread, results go to the connection's loop when it has one.
+	if (_loop) {
+		_loop->Post(std::move(callback));
+	}
+	else {
+		callback();
+	}
+}
+
+rtc::scoped_refptr<webrtc::PeerConnectionInterface> RTCPeerConnectionInternal::Socket() {
+	std::lock_guard<std::mutex> lock(_socketMutex);
+	return _socket;
+}
+
+rtc::Thread* RTCPeerConnectionInternal::NetworkThread() const {
+	return _shard ? _shard->network_thread.get() : nullptr;
+}
+
+void RTCPeerConnectionInternal::SetEventLoop(const std::shared_ptr<EventLoopInternal>& loop) {
+	_loop = loop;
+}
+
+std::shared_ptr<RTCPeerConnection> RTCPeerConnection::New(const RTCPeerConnection::RTCConfiguration& config, const std::shared_ptr<EventLoop>& loop) {
+	return RTCPeerConnectionFactory::Default()->CreatePeerConnection(config, loop);
 }
 
 RTCPeerConnection::RTCConfiguration::RTCConfiguration() :
@@ -29,43 +29,55 @@
 
 #include "crtc.h"
 #include "event.h"
+#include "eventloop.h"
+#include "executor.h"
 #include "utils.hpp"
 #include "promise.h"
 #include "mediastreamtrack.h"
 #include "mediastream.h"
+#include "rtcpeerconnectionfactory.h"
 #include <api/peer_connection_interface.h>
 #include <api/create_peerconnection_factory.h>
-#include <api/task_queue/default_task_queue_factory.h>
 #include <media/engine/webrtc_video_engine.h>
 #include <modules/audio_device/include/audio_device.h>
 #include <modules/video_coding/codecs/h264/include/h264.h>
+#include <mutex>
 
 namespace crtc {
 	class RTCPeerConnectionInternal;
 
-	class RTCPeerConnectionInternal : public RTCPeerConnection, public webrtc::PeerConnectionObserver {
+	class RTCPeerConnectionInternal : public RTCPeerConnection, public webrtc::PeerConnectionObserver, public std::enable_shared_from_this<RTCPeerConnectionInternal> {
 		friend class RTCPeerConnectionObserver;
 
 	public:
-		explicit RTCPeerConnectionInternal();
+		explicit RTCPeerConnectionInternal(const std::shared_ptr<RTCPeerConnectionFactoryInternal>& context, RTCPeerConnectionShard* shard, const std::shared_ptr<EventLoopInternal>& loop = nullptr);
 		virtual ~RTCPeerConnectionInternal() override;
 
+		// Deleter of the connections the factory hands out. The last reference can go on any thread, the connection is
+		// deleted on its loop. Offers, answers and descriptions in flight hold a reference until their callbacks ran.
+		static void Destroy(RTCPeerConnectionInternal* pc);
+
 		std::shared_ptr<RTCDataChannel> CreateDataChannel(const String& label, const RTCDataChannelInit& options = RTCDataChannelInit()) override;
-		void AddIceCandidate(const RTCPeerConnection::RTCIceCandidate& candidate) override;
+		void AddIceCandidate(const RTCPeerConnection::RTCIceCandidate& candidate, std::function<void(std::shared_ptr<Error>)> callback = nullptr) override;
+		void AddIceCandidates(const std::vector<RTCPeerConnection::RTCIceCandidate>& candidates, std::function<void(std::vector<std::shared_ptr<Error>>)> callback = nullptr) override;
 		void AddStream(const std::shared_ptr<MediaStream>& stream) override;
 		// Let<RTCPeerConnection::RTCRtpSender> AddTrack(const Let<MediaStreamTrack> &track, const Let<MediaStream> &stream) override;
-		void CreateAnswer(std::function<void(RTCPeerConnection::RTCSessionDescription*)> callback, const RTCAnswerOptions& options) override;
-		void CreateOffer(std::function<void(RTCPeerConnection::RTCSessionDescription*)> callback, const RTCOfferOptions& options) override;
+		void CreateAnswer(std::function<void(RTCPeerConnection::RTCSessionDescription*)> callback, const RTCAnswerOptions& options, std::function<void(std::shared_ptr<Error>)> onerror = nullptr) override;
+		void CreateOffer(std::function<void(RTCPeerConnection::RTCSessionDescription*)> callback, const RTCOfferOptions& options, std::function<void(std::shared_ptr<Error>)> onerror = nullptr) override;
 		// Let<Promise<RTCPeerConnection::RTCCertificate>> GenerateCertificate() override;
 		MediaStreams GetLocalStreams() override;
 		MediaStreams GetRemoteStreams() override;
 		void RemoveStream(const std::shared_ptr<MediaStream>& stream) override;
 		// void RemoveTrack(const Let<RTCPeerConnection::RTCRtpSender> &sender) override;
-		void SetLocalDescription(std::shared_ptr<const RTCSessionDescription> sdp) override;
-		void SetRemoteDescription(std::shared_ptr<const RTCSessionDescription> sdp) override;
+		void SetLocalDescription(std::shared_ptr<const RTCSessionDescription> sdp, std::function<void(std::shared_ptr<Error>)> callback = nullptr) override;
+		void SetRemoteDescription(std::shared_ptr<const RTCSessionDescription> sdp, std::function<void(std::shared_ptr<Error>)> callback = nullptr) override;
 		void Close() override;
+		void CloseAsync(std::function<void()> callback = nullptr) override;
+
+		bool SetConfiguration(const RTCPeerConnection::RTCConfiguration& config, const rtc::scoped_refptr<rtc::RTCCertificate>& certificate = nullptr);
 
-		bool SetConfiguration(const RTCPeerConnection::RTCConfiguration& config);
+		// Binds a pooled connection to a loop, only valid before the connection is handed out.
+		void SetEventLoop(const std::shared_ptr<EventLoopInternal>& loop);
 		RTCPeerConnection::RTCSessionDescription CurrentLocalDescription() override;
 		RTCPeerConnection::RTCSessionDescription CurrentRemoteDescription() override;
 		RTCPeerConnection::RTCSessionDescription LocalDescription() override;
@@ -81,21 +93,45 @@ namespace crtc {
 		void onRawVideo(const webrtc::EncodedImage& input_image, int64_t render_time_ms);
 		void onRawAudio(const uint8_t* data, size_t data_length);
 
-		void onRawVideo(std::function<void(const unsigned char* data, size_t length, bool isKeyFrame, int64_t renderTimeMs)> callback) override;
-		void onRawAudio(std::function<void(const unsigned char* data, size_t length)> callback) override;
-		void onAddTrack(std::function<void(const std::shared_ptr<MediaStreamTrack>)> callback) override;
-		void onRemoveTrack(std::function<void(const std::shared_ptr<MediaStreamTrack>)> callback) override;
-		void onAddStream(std::function<void(const std::shared_ptr<MediaStream>)> callback) override;
-		void onRemoveStream(std::function<void(const std::shared_ptr<MediaStream>)> callback) override;
-		void onDataChannel(std::function<void(const std::shared_ptr<RTCDataChannel>)> callback) override;
-		void onIceCandidate(std::function<void(const std::shared_ptr<RTCIceCandidate>)> callback) override;
-		void onNegotiationNeeded(std::function<void()> callback) override;
-		void onsignalingstatechange(std::function<void()> callback) override;
-		void onIceGatheringStateChange(std::function<void()> callback) override;
-		void onIceConnectionStateChange(std::function<void()> callback) override;
-		void onIceCandidatesRemoved(std::function<void()> callback) override;
+		void onRawVideo(std::function<void(const unsigned char* data, size_t length, bool isKeyFrame, int64_t renderTimeMs)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onRawAudio(std::function<void(const unsigned char* data, size_t length)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onAddTrack(std::function<void(const std::shared_ptr<MediaStreamTrack>)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onRemoveTrack(std::function<void(const std::shared_ptr<MediaStreamTrack>)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onAddStream(std::function<void(const std::shared_ptr<MediaStream>)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onRemoveStream(std::function<void(const std::shared_ptr<MediaStream>)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onDataChannel(std::function<void(const std::shared_ptr<RTCDataChannel>)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onIceCandidate(std::function<void(const std::shared_ptr<RTCIceCandidate>)> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onNegotiationNeeded(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onsignalingstatechange(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onIceGatheringStateChange(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onIceConnectionStateChange(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
+		void onIceCandidatesRemoved(std::function<void()> callback, const std::shared_ptr<Executor>& executor = nullptr) override;
 
 	private:
+		// Parsed trickle batch, candidates[i] is null where errors[i] is set.
+		struct CandidateBatch {
+			std::vector<std::unique_ptr<webrtc::IceCandidateInterface>> candidates;
+			std::vector<std::shared_ptr<Error>> errors;
+			std::function<void(std::vector<std::shared_ptr<Error>>)> callback;
+			std::shared_ptr<EventLoopInternal> loop;
+		};
+
+		typedef std::vector<std::shared_ptr<CandidateBatch>> CandidateQueue;
+
+		// Runs a completion callback on the connection's loop, inline when it has none.
+		void Deliver(std::function<void()> callback);
+
+		// Network thread of the connection's shard, data channels hand their batches to it.
+		rtc::Thread* NetworkThread() const;
+
+		// CloseAsync() takes _socket on the signaling thread, every other thread works on the copy returned here and
+		// sees nullptr once it is gone.
+		rtc::scoped_refptr<webrtc::PeerConnectionInterface> Socket();
+
+		// Both run on the signaling thread, which is the only thread touching the candidate queue.
+		static void ApplyCandidates(const rtc::scoped_refptr<webrtc::PeerConnectionInterface>& socket, const std::shared_ptr<CandidateBatch>& batch);
+		static void FlushCandidates(const rtc::scoped_refptr<webrtc::PeerConnectionInterface>& socket, const std::shared_ptr<CandidateQueue>& queue);
+
 		inline static std::shared_ptr<Error> SDP2SDP(const webrtc::SessionDescriptionInterface* desc = nullptr, RTCPeerConnection::RTCSessionDescription* sdp = nullptr) {
 			if (desc && sdp) {
 				if (desc->type().compare(webrtc::SessionDescriptionInterface::kOffer) == 0) {
@@ -293,31 +329,38 @@ namespace crtc {
 		class SetRemoteDescriptionObserver : public webrtc::SetRemoteDescriptionObserverInterface {
 		public:
 			SetRemoteDescriptionObserver(const Promise<>::FullFilledCallback& resolve,
-				const Promise<>::RejectedCallback& reject) :
+				const Promise<>::RejectedCallback& reject,
+				std::function<void()> applied = nullptr) :
 				_resolve(resolve),
-				_reject(reject)
+				_reject(reject),
+				_applied(std::move(applied))
 			{ }
 
 			~SetRemoteDescriptionObserver() override { }
 
 		private:
 			void OnSetRemoteDescriptionComplete(webrtc::RTCError error) override {
-				if (error.ok())
+				if (error.ok()) {
+					if (_applied) {
+						_applied();
+					}
+
 					_resolve();
+				}
 				else
 					_reject(Error::New(error.message(), __FILE__, __LINE__));
 			}
 
 			Promise<>::FullFilledCallback _resolve;
 			Promise<>::RejectedCallback _reject;
+			std::function<void()> _applied;
 		};
 
-		std::unique_ptr<rtc::Thread> _network_thread;
-		std::unique_ptr<rtc::Thread> _worker_thread;
-		std::unique_ptr<rtc::Thread> _signal_thread;
-		std::unique_ptr<webrtc::TaskQueueFactory> _task_queue;
-		//rtc::scoped_refptr<webrtc::AudioDeviceModule> _audio_device;
+		std::shared_ptr<RTCPeerConnectionFactoryInternal> _context;
+		RTCPeerConnectionShard* _shard;
+		std::shared_ptr<EventLoopInternal> _loop;
 		rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> _factory;
+		std::shared_ptr<SctpTuning> _sctp;
 
 	protected:
 		void OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState new_state) override;
@@ -336,25 +379,27 @@ namespace crtc {
 		void OnIceCandidatesRemoved(const std::vector<cricket::Candidate>& candidates) override;
 		void OnIceConnectionReceivingChange(bool receiving) override;
 
+		std::mutex _socketMutex;
 		rtc::scoped_refptr<webrtc::PeerConnectionInterface> _socket;
+		std::atomic<bool> _closed;
 		std::shared_ptr<Event> _event;
-		std::vector<std::function<void()>> _pending_candidates;
+		std::shared_ptr<CandidateQueue> _pending_candidates;
 		std::vector<std::shared_ptr<MediaStreamInternal>> _streams;
-		bool _settingLocalDesc, _settingRemoteDesc;
-
-		synchronized_callback<> _onnegotiationneeded;
-		synchronized_callback<> _onsignalingstatechange;
-		synchronized_callback<> _onicegatheringstatechange;
-		synchronized_callback<> _oniceconnectionstatechange;
-		synchronized_callback<> _onicecandidatesremoved;
-		synchronized_callback<const std::shared_ptr<MediaStream>> _onaddstream;
-		synchronized_callback<const std::shared_ptr<MediaStream>> _onremovestream;
-		synchronized_callback<const unsigned char*, size_t, bool, int64_t> _onRawVideo;
-		synchronized_callback<const unsigned char*, size_t> _onRawAudio;
-		synchronized_callback<const std::shared_ptr<MediaStreamTrack>> _onaddtrack;
-		synchronized_callback<const std::shared_ptr<MediaStreamTrack>> _onremovetrack;
-		synchronized_callback<const std::shared_ptr<RTCDataChannel>> _ondatachannel;
-		synchronized_callback<const std::shared_ptr<RTCIceCandidate>> _onicecandidate;
+		std::atomic<bool> _settingLocalDesc, _settingRemoteDesc;
+
+		routed_callback<synchronized_callback> _onnegotiationneeded;
+		routed_callback<synchronized_callback> _onsignalingstatechange;
+		routed_callback<synchronized_callback> _onicegatheringstatechange;
+		routed_callback<synchronized_callback> _oniceconnectionstatechange;
+		routed_callback<synchronized_callback> _onicecandidatesremoved;
+		routed_callback<synchronized_callback, const std::shared_ptr<MediaStream>> _onaddstream;
+		routed_callback<synchronized_callback, const std::shared_ptr<MediaStream>> _onremovestream;
+		routed_callback<atomic_callback, const unsigned char*, size_t, bool, int64_t> _onRawVideo;
+		routed_callback<atomic_callback, const unsigned char*, size_t> _onRawAudio;
+		routed_callback<synchronized_callback, const std::shared_ptr<MediaStreamTrack>> _onaddtrack;
+		routed_callback<synchronized_callback, const std::shared_ptr<MediaStreamTrack>> _onremovetrack;
+		routed_callback<synchronized_callback, const std::shared_ptr<RTCDataChannel>> _ondatachannel;
+		routed_callback<synchronized_callback, const std::shared_ptr<RTCIceCandidate>> _onicecandidate;
 
 
 	};
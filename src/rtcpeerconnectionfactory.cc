@@ -0,0 +1,245 @@
+#include "rtcpeerconnectionfactory.h"
+#include "rtcpeerconnection.h"
+#include "customaudiofactory.h"
+#include "customvideofactory.h"
+#include "fakeaudiodevice.h"
+#include "api/audio_codecs/builtin_audio_encoder_factory.h"
+#include "api/create_peerconnection_factory.h"
+#include "api/call/call_factory_interface.h"
+#include "api/rtc_event_log/rtc_event_log_factory.h"
+#include "api/task_queue/default_task_queue_factory.h"
+#include "api/transport/field_trial_based_config.h"
+#include "media/engine/webrtc_media_engine.h"
+#include "modules/audio_processing/include/audio_processing.h"
+#include "api/video_codecs/video_encoder_factory_template.h"
+#include "api/video_codecs/video_encoder_factory_template_open_h264_adapter.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/null_socket_server.h"
+#include "rtc_base/physical_socket_server.h"
+#include <mutex>
+
+using namespace crtc;
+
+static std::mutex defaultFactoryMutex;
+static std::shared_ptr<RTCPeerConnectionFactoryInternal> defaultFactory;
+
+ShardThread::ShardThread(std::unique_ptr<rtc::SocketServer> ss) :
+	rtc::Thread(std::move(ss)),
+	_tasks(0)
+{
+}
+
+ShardThread::~ShardThread() {
+	rtc::Thread::Stop();
+}
+
+uint64_t ShardThread::Tasks() const {
+	return _tasks.load(std::memory_order_relaxed);
+}
+
+void ShardThread::PostTaskImpl(absl::AnyInvocable<void()&&> task,
+	const PostTaskTraits& traits,
+	const webrtc::Location& location)
+{
+	_tasks.fetch_add(1, std::memory_order_relaxed);
+	rtc::Thread::PostTaskImpl(std::move(task), traits, location);
+}
+
+void ShardThread::PostDelayedTaskImpl(absl::AnyInvocable<void()&&> task,
+	webrtc::TimeDelta delay,
+	const PostDelayedTaskTraits& traits,
+	const webrtc::Location& location)
+{
+	_tasks.fetch_add(1, std::memory_order_relaxed);
+	rtc::Thread::PostDelayedTaskImpl(std::move(task), delay, traits, location);
+}
+
+RTCPeerConnectionFactoryInternal::RTCPeerConnectionFactoryInternal(const RTCPeerConnectionFactory::Options& options) :
+	_options(options),
+	_next(0)
+{
+	_signal_thread = rtc::Thread::CreateWithSocketServer();
+	_signal_thread->SetName("signal", nullptr);
+
+	if (!_signal_thread->Start()) {
+		rtc::webrtc_logging_impl::LogCall();
+	}
+
+	size_t count = (_options.shards > 0) ? _options.shards : 1;
+
+	for (size_t index = 0; index < count; index++) {
+		auto shard = std::make_unique<RTCPeerConnectionShard>();
+		std::string suffix = (count > 1) ? std::to_string(index) : std::string();
+
+		shard->connections = 0;
+		shard->placed = 0;
+
+		shard->network_thread = std::make_unique<ShardThread>(std::make_unique<rtc::PhysicalSocketServer>());
+		shard->network_thread->SetName("network" + suffix, nullptr);
+
+		if (!shard->network_thread->Start()) {
+			rtc::webrtc_logging_impl::LogCall();
+		}
+
+		shard->worker_thread = std::make_unique<ShardThread>(std::make_unique<rtc::NullSocketServer>());
+		shard->worker_thread->SetName("worker" + suffix, nullptr);
+
+		if (!shard->worker_thread->Start()) {
+			rtc::webrtc_logging_impl::LogCall();
+		}
+
+		_shards.push_back(std::move(shard));
+	}
+
+	_audio_encoder_factory = webrtc::CreateBuiltinAudioEncoderFactory();
+}
+
+RTCPeerConnectionFactoryInternal::~RTCPeerConnectionFactoryInternal() {
+
+}
+
+std::shared_ptr<RTCPeerConnection> RTCPeerConnectionFactoryInternal::CreatePeerConnection(const RTCPeerConnection::RTCConfiguration& config, const std::shared_ptr<EventLoop>& loop) {
+	return CreatePeerConnection(config, Acquire(), std::dynamic_pointer_cast<EventLoopInternal>(loop));
+}
+
+std::shared_ptr<RTCPeerConnection> RTCPeerConnectionFactoryInternal::CreatePeerConnection(const RTCPeerConnection::RTCConfiguration& config, uint64_t key, const std::shared_ptr<EventLoop>& loop) {
+	return CreatePeerConnection(config, Acquire(key), std::dynamic_pointer_cast<EventLoopInternal>(loop));
+}
+
+std::shared_ptr<RTCPeerConnection> RTCPeerConnectionFactoryInternal::CreatePeerConnection(const RTCPeerConnection::RTCConfiguration& config,
+	RTCPeerConnectionShard* shard,
+	const std::shared_ptr<EventLoopInternal>& loop,
+	const rtc::scoped_refptr<rtc::RTCCertificate>& certificate)
+{
+	std::shared_ptr<RTCPeerConnectionInternal> pc(new RTCPeerConnectionInternal(shared_from_this(), shard, loop), &RTCPeerConnectionInternal::Destroy);
+	if (pc && pc->SetConfiguration(config, certificate))
+		return pc;
+	return nullptr;
+}
+
+std::vector<RTCPeerConnectionFactory::ShardStats> RTCPeerConnectionFactoryInternal::Shards() const {
+	std::vector<RTCPeerConnectionFactory::ShardStats> stats;
+
+	for (const auto& shard : _shards) {
+		RTCPeerConnectionFactory::ShardStats stat;
+
+		stat.connections = shard->connections.load(std::memory_order_relaxed);
+		stat.placed = shard->placed.load(std::memory_order_relaxed);
+		stat.networkTasks = shard->network_thread->Tasks();
+		stat.workerTasks = shard->worker_thread->Tasks();
+
+		stats.push_back(stat);
+	}
+
+	return stats;
+}
+
+RTCPeerConnectionShard* RTCPeerConnectionFactoryInternal::Acquire() {
+	RTCPeerConnectionShard* shard = nullptr;
+
+	switch (_options.placement) {
+	case RTCPeerConnectionFactory::kLeastLoaded:
+		for (const auto& candidate : _shards) {
+			if (!shard || candidate->connections.load(std::memory_order_relaxed) < shard->connections.load(std::memory_order_relaxed)) {
+				shard = candidate.get();
+			}
+		}
+		break;
+	case RTCPeerConnectionFactory::kRoundRobin:
+	default:
+		shard = _shards[_next.fetch_add(1, std::memory_order_relaxed) % _shards.size()].get();
+		break;
+	}
+
+	shard->connections.fetch_add(1, std::memory_order_relaxed);
+	shard->placed.fetch_add(1, std::memory_order_relaxed);
+	return shard;
+}
+
+RTCPeerConnectionShard* RTCPeerConnectionFactoryInternal::Acquire(uint64_t key) {
+	RTCPeerConnectionShard* shard = _shards[key % _shards.size()].get();
+
+	shard->connections.fetch_add(1, std::memory_order_relaxed);
+	shard->placed.fetch_add(1, std::memory_order_relaxed);
+	return shard;
+}
+
+void RTCPeerConnectionFactoryInternal::Release(RTCPeerConnectionShard* shard) {
+	if (shard) {
+		shard->connections.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
+
+rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> RTCPeerConnectionFactoryInternal::CreateFactory(RTCPeerConnectionInternal* pc, RTCPeerConnectionShard* shard, const std::shared_ptr<SctpTuning>& sctp) {
+	//auto audio_device = webrtc::AudioDeviceModule::Create(webrtc::AudioDeviceModule::kDummyAudio, _task_queue.get());
+	auto audio_device = FakeAudioDeviceModule::Create(); // new webrtc::FakeAudioDeviceModule();
+
+	// What webrtc::CreatePeerConnectionFactory() assembles, plus the SCTP transport factory it has no parameter for.
+	webrtc::PeerConnectionFactoryDependencies dependencies;
+
+	dependencies.network_thread = shard->network_thread.get();
+	dependencies.worker_thread = shard->worker_thread.get();
+	dependencies.signaling_thread = _signal_thread.get();
+	dependencies.task_queue_factory = webrtc::CreateDefaultTaskQueueFactory();
+	dependencies.call_factory = webrtc::CreateCallFactory();
+	dependencies.event_log_factory = std::make_unique<webrtc::RtcEventLogFactory>(dependencies.task_queue_factory.get());
+	dependencies.trials = std::make_unique<webrtc::FieldTrialBasedConfig>();
+	dependencies.sctp_factory = std::make_unique<SctpTransportFactory>(shard->network_thread.get(), sctp);
+
+	cricket::MediaEngineDependencies media;
+
+	media.task_queue_factory = dependencies.task_queue_factory.get();
+	media.adm = audio_device;
+	media.audio_encoder_factory = _audio_encoder_factory;
+	media.audio_decoder_factory = rtc::make_ref_counted<CustomAudioFactory>(pc);
+	media.audio_processing = webrtc::AudioProcessingBuilder().Create();
+	media.video_encoder_factory = std::make_unique<webrtc::VideoEncoderFactoryTemplate<webrtc::OpenH264EncoderTemplateAdapter>>();
+	media.video_decoder_factory = std::make_unique<CustomVideoFactory>(pc);
+	media.trials = dependencies.trials.get();
+
+	dependencies.media_engine = cricket::CreateMediaEngine(std::move(media));
+
+	return webrtc::CreateModularPeerConnectionFactory(std::move(dependencies));
+}
+
+rtc::Thread* RTCPeerConnectionFactoryInternal::SignalThread() const {
+	return _signal_thread.get();
+}
+
+std::shared_ptr<RTCPeerConnectionFactoryInternal> RTCPeerConnectionFactoryInternal::Default() {
+	std::lock_guard<std::mutex> lock(defaultFactoryMutex);
+
+	if (!defaultFactory) {
+		defaultFactory = std::make_shared<RTCPeerConnectionFactoryInternal>(RTCPeerConnectionFactory::Options());
+	}
+
+	return defaultFactory;
+}
+
+void RTCPeerConnectionFactoryInternal::Dispose() {
+	std::shared_ptr<RTCPeerConnectionFactoryInternal> factory;
+
+	{
+		std::lock_guard<std::mutex> lock(defaultFactoryMutex);
+		factory.swap(defaultFactory);
+	}
+
+	// Threads are stopped here unless a connection still holds the factory.
+	factory.reset();
+}
+
+std::shared_ptr<RTCPeerConnectionFactory> RTCPeerConnectionFactory::New(const Options& options) {
+	return std::make_shared<RTCPeerConnectionFactoryInternal>(options);
+}
+
+std::shared_ptr<RTCPeerConnectionFactory> RTCPeerConnectionFactory::Default() {
+	return RTCPeerConnectionFactoryInternal::Default();
+}
+
+RTCPeerConnectionFactory::RTCPeerConnectionFactory() {
+
+}
+
+RTCPeerConnectionFactory::~RTCPeerConnectionFactory() {
+
+}
@@ -0,0 +1,83 @@
+#ifndef CRTC_RTCPEERCONNECTIONFACTORY_H
+#define CRTC_RTCPEERCONNECTIONFACTORY_H
+
+#include "crtc.h"
+#include "eventloop.h"
+#include "sctptransportfactory.h"
+#include <api/peer_connection_interface.h>
+#include <api/audio_codecs/audio_encoder_factory.h>
+#include "rtc_base/rtc_certificate.h"
+#include "rtc_base/thread.h"
+#include <atomic>
+
+namespace crtc {
+	class RTCPeerConnectionInternal;
+
+	// rtc::Thread that counts the tasks posted to it, used as the shard load counter.
+	class ShardThread : public rtc::Thread {
+	public:
+		explicit ShardThread(std::unique_ptr<rtc::SocketServer> ss);
+		~ShardThread() override;
+
+		uint64_t Tasks() const;
+
+	protected:
+		void PostTaskImpl(absl::AnyInvocable<void()&&> task,
+			const PostTaskTraits& traits,
+			const webrtc::Location& location) override;
+
+		void PostDelayedTaskImpl(absl::AnyInvocable<void()&&> task,
+			webrtc::TimeDelta delay,
+			const PostDelayedTaskTraits& traits,
+			const webrtc::Location& location) override;
+
+		std::atomic<uint64_t> _tasks;
+	};
+
+	struct RTCPeerConnectionShard {
+		std::unique_ptr<ShardThread> network_thread;
+		std::unique_ptr<ShardThread> worker_thread;
+		std::atomic<size_t> connections;
+		std::atomic<uint64_t> placed;
+	};
+
+	class RTCPeerConnectionFactoryInternal : public RTCPeerConnectionFactory, public std::enable_shared_from_this<RTCPeerConnectionFactoryInternal> {
+	public:
+		explicit RTCPeerConnectionFactoryInternal(const RTCPeerConnectionFactory::Options& options);
+		virtual ~RTCPeerConnectionFactoryInternal() override;
+
+		std::shared_ptr<RTCPeerConnection> CreatePeerConnection(const RTCPeerConnection::RTCConfiguration& config, const std::shared_ptr<EventLoop>& loop = nullptr) override;
+		std::shared_ptr<RTCPeerConnection> CreatePeerConnection(const RTCPeerConnection::RTCConfiguration& config, uint64_t key, const std::shared_ptr<EventLoop>& loop = nullptr) override;
+		std::vector<RTCPeerConnectionFactory::ShardStats> Shards() const override;
+
+		// Creates the connection on an already acquired shard, optionally with a pre-generated DTLS certificate.
+		std::shared_ptr<RTCPeerConnection> CreatePeerConnection(const RTCPeerConnection::RTCConfiguration& config,
+			RTCPeerConnectionShard* shard,
+			const std::shared_ptr<EventLoopInternal>& loop,
+			const rtc::scoped_refptr<rtc::RTCCertificate>& certificate = nullptr);
+
+		// Picks a shard for a new connection, Release() must be called once the connection is gone.
+		RTCPeerConnectionShard* Acquire();
+		RTCPeerConnectionShard* Acquire(uint64_t key);
+		void Release(RTCPeerConnectionShard* shard);
+
+		// Builds the webrtc factory for a single connection on top of the shared threads.
+		// The decoder factories stay per connection because raw decoder bypass has to know its owner, and so does the
+		// SCTP transport factory to apply the connection's RTCConfiguration::sctp.
+		rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> CreateFactory(RTCPeerConnectionInternal* pc, RTCPeerConnectionShard* shard, const std::shared_ptr<SctpTuning>& sctp);
+
+		rtc::Thread* SignalThread() const;
+
+		static std::shared_ptr<RTCPeerConnectionFactoryInternal> Default();
+		static void Dispose();
+
+	private:
+		RTCPeerConnectionFactory::Options _options;
+		std::atomic<size_t> _next;
+		std::unique_ptr<rtc::Thread> _signal_thread;
+		std::vector<std::unique_ptr<RTCPeerConnectionShard>> _shards;
+		rtc::scoped_refptr<webrtc::AudioEncoderFactory> _audio_encoder_factory;
+	};
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include "rtcpeerconnectionpool.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/rtc_certificate_generator.h"
+#include "rtc_base/time_utils.h"
+#include <algorithm>
+
+using namespace crtc;
+
+RTCPeerConnectionPoolInternal::RTCPeerConnectionPoolInternal(size_t size, const std::shared_ptr<RTCPeerConnectionFactoryInternal>& factory) :
+	_size(size),
+	_factory(factory),
+	_hits(0),
+	_misses(0),
+	_refills(0),
+	_lastRefillUs(0),
+	_maxRefillUs(0),
+	_totalRefillUs(0)
+{
+	_thread = rtc::Thread::Create();
+	_thread->SetName("pool", nullptr);
+
+	if (!_thread->Start()) {
+		rtc::webrtc_logging_impl::LogCall();
+	}
+}
+
+RTCPeerConnectionPoolInternal::~RTCPeerConnectionPoolInternal() {
+	// Refill tasks capture this, stop them before the profiles go away.
+	_thread->Stop();
+}
+
+void RTCPeerConnectionPoolInternal::Warm(const RTCPeerConnection::RTCConfiguration& config) {
+	std::string key = ProfileKey(config);
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		GetProfile(key, config);
+	}
+
+	Refill(key);
+}
+
+std::shared_ptr<RTCPeerConnection> RTCPeerConnectionPoolInternal::Acquire(const RTCPeerConnection::RTCConfiguration& config, const std::shared_ptr<EventLoop>& loop) {
+	std::shared_ptr<RTCPeerConnectionInternal> pc;
+	std::string key = ProfileKey(config);
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		Profile& profile = GetProfile(key, config);
+
+		if (!profile.ready.empty()) {
+			pc = std::move(profile.ready.front());
+			profile.ready.pop_front();
+			_hits++;
+		}
+		else {
+			_misses++;
+		}
+	}
+
+	Refill(key);
+
+	if (!pc) {
+		return _factory->CreatePeerConnection(config, loop);
+	}
+
+	pc->SetEventLoop(std::dynamic_pointer_cast<EventLoopInternal>(loop));
+	return pc;
+}
+
+RTCPeerConnectionPool::Stats RTCPeerConnectionPoolInternal::GetStats() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	RTCPeerConnectionPool::Stats stats;
+
+	stats.hits = _hits;
+	stats.misses = _misses;
+	stats.ready = 0;
+	stats.refills = _refills;
+	stats.lastRefillUs = _lastRefillUs;
+	stats.maxRefillUs = _maxRefillUs;
+	stats.averageRefillUs = _refills ? _totalRefillUs / static_cast<int64_t>(_refills) : 0;
+
+	for (const auto& profile : _profiles) {
+		stats.ready += profile.second.ready.size();
+	}
+
+	return stats;
+}
+
+std::string RTCPeerConnectionPoolInternal::ProfileKey(const RTCPeerConnection::RTCConfiguration& config) {
+	std::string key;
+
+	key += std::to_string(config.iceCandidatePoolSize) + ';';
+	key += std::to_string(config.bundlePolicy) + ';';
+	key += std::to_string(config.iceTransportPolicy) + ';';
+	key += std::to_string(config.rtcpMuxPolicy) + ';';
+	key += std::to_string(config.sctp.sendBufferSize) + ',';
+	key += std::to_string(config.sctp.receiveWindowSize) + ',';
+	key += std::to_string(config.sctp.maxMessageSize) + ',';
+	key += std::to_string(config.sctp.maxOutboundStreams) + ',';
+	key += std::to_string(config.sctp.maxInboundStreams) + ';';
+
+	for (const auto& server : config.iceServers) {
+		key += '[';
+
+		for (const auto& url : server.urls) {
+			key += to_string(url) + ',';
+		}
+
+		key += to_string(server.username) + ';' + to_string(server.credential) + ';' + to_string(server.credentialType) + ']';
+	}
+
+	return key;
+}
+
+RTCPeerConnectionPoolInternal::Profile& RTCPeerConnectionPoolInternal::GetProfile(const std::string& key, const RTCPeerConnection::RTCConfiguration& config) {
+	auto it = _profiles.find(key);
+
+	if (it == _profiles.end()) {
+		it = _profiles.emplace(key, Profile(config)).first;
+	}
+
+	return it->second;
+}
+
+void RTCPeerConnectionPoolInternal::Refill(const std::string& key) {
+	size_t missing = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		Profile& profile = _profiles.at(key);
+		size_t queued = profile.ready.size() + profile.pending;
+
+		if (queued < _size) {
+			missing = _size - queued;
+			profile.pending += missing;
+		}
+	}
+
+	for (size_t index = 0; index < missing; index++) {
+		_thread->PostTask([this, key]() {
+			Fill(key);
+		});
+	}
+}
+
+void RTCPeerConnectionPoolInternal::Fill(const std::string& key) {
+	int64_t begin = rtc::TimeMicros();
+	std::unique_ptr<RTCPeerConnection::RTCConfiguration> config;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		config = std::make_unique<RTCPeerConnection::RTCConfiguration>(_profiles.at(key).config);
+	}
+
+	// Generate the DTLS certificate here so the connection does not have to do it after Acquire().
+	auto certificate = rtc::RTCCertificateGenerator::GenerateCertificate(rtc::KeyParams(rtc::KT_DEFAULT), absl::nullopt);
+	auto pc = std::static_pointer_cast<RTCPeerConnectionInternal>(_factory->CreatePeerConnection(*config, _factory->Acquire(), nullptr, certificate));
+	int64_t elapsed = rtc::TimeMicros() - begin;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	Profile& profile = _profiles.at(key);
+
+	profile.pending--;
+
+	if (pc) {
+		profile.ready.push_back(std::move(pc));
+	}
+
+	_refills++;
+	_lastRefillUs = elapsed;
+	_maxRefillUs = std::max(_maxRefillUs, elapsed);
+	_totalRefillUs += elapsed;
+}
+
+std::shared_ptr<RTCPeerConnectionPool> RTCPeerConnectionPool::New(size_t size, const std::shared_ptr<RTCPeerConnectionFactory>& factory) {
+	auto internal = std::dynamic_pointer_cast<RTCPeerConnectionFactoryInternal>(factory ? factory : RTCPeerConnectionFactory::Default());
+
+	if (internal) {
+		return std::make_shared<RTCPeerConnectionPoolInternal>(size, internal);
+	}
+
+	return nullptr;
+}
+
+RTCPeerConnectionPool::RTCPeerConnectionPool() {
+
+}
+
+RTCPeerConnectionPool::~RTCPeerConnectionPool() {
+
+}
@@ -0,0 +1,56 @@
+#ifndef CRTC_RTCPEERCONNECTIONPOOL_H
+#define CRTC_RTCPEERCONNECTIONPOOL_H
+
+#include "crtc.h"
+#include "rtcpeerconnectionfactory.h"
+#include "rtcpeerconnection.h"
+#include "rtc_base/thread.h"
+#include <deque>
+#include <map>
+#include <mutex>
+
+namespace crtc {
+	class RTCPeerConnectionPoolInternal : public RTCPeerConnectionPool {
+	public:
+		explicit RTCPeerConnectionPoolInternal(size_t size, const std::shared_ptr<RTCPeerConnectionFactoryInternal>& factory);
+		virtual ~RTCPeerConnectionPoolInternal() override;
+
+		void Warm(const RTCPeerConnection::RTCConfiguration& config) override;
+		std::shared_ptr<RTCPeerConnection> Acquire(const RTCPeerConnection::RTCConfiguration& config, const std::shared_ptr<EventLoop>& loop = nullptr) override;
+		RTCPeerConnectionPool::Stats GetStats() const override;
+
+	private:
+		struct Profile {
+			explicit Profile(const RTCPeerConnection::RTCConfiguration& cfg) :
+				config(cfg),
+				pending(0)
+			{ }
+
+			RTCPeerConnection::RTCConfiguration config;
+			std::deque<std::shared_ptr<RTCPeerConnectionInternal>> ready;
+			size_t pending;
+		};
+
+		static std::string ProfileKey(const RTCPeerConnection::RTCConfiguration& config);
+
+		Profile& GetProfile(const std::string& key, const RTCPeerConnection::RTCConfiguration& config);
+		void Refill(const std::string& key);
+		void Fill(const std::string& key);
+
+		size_t _size;
+		std::shared_ptr<RTCPeerConnectionFactoryInternal> _factory;
+		std::unique_ptr<rtc::Thread> _thread;
+
+		mutable std::mutex _mutex;
+		std::map<std::string, Profile> _profiles;
+
+		uint64_t _hits;
+		uint64_t _misses;
+		uint64_t _refills;
+		int64_t _lastRefillUs;
+		int64_t _maxRefillUs;
+		int64_t _totalRefillUs;
+	};
+}
+
+#endif
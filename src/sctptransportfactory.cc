@@ -0,0 +1,73 @@
+#include "sctptransportfactory.h"
+#include "media/sctp/dcsctp_transport.h"
+#include "net/dcsctp/public/dcsctp_options.h"
+#include "net/dcsctp/public/dcsctp_socket_factory.h"
+#include "system_wrappers/include/clock.h"
+
+using namespace crtc;
+
+namespace {
+	class TunedSocketFactory : public dcsctp::DcSctpSocketFactory {
+	public:
+		explicit TunedSocketFactory(const RTCPeerConnection::RTCSctpTransportOptions& options) :
+			_options(options)
+		{ }
+
+		std::unique_ptr<dcsctp::DcSctpSocketInterface> Create(absl::string_view log_prefix,
+			dcsctp::DcSctpSocketCallbacks& callbacks,
+			std::unique_ptr<dcsctp::PacketObserver> packet_observer,
+			const dcsctp::DcSctpOptions& options) override
+		{
+			dcsctp::DcSctpOptions tuned = options;
+
+			// The per stream limit would otherwise cap a single channel below the larger send buffer.
+			if (_options.sendBufferSize) {
+				tuned.max_send_buffer_size = _options.sendBufferSize;
+				tuned.per_stream_send_queue_limit = _options.sendBufferSize;
+			}
+
+			if (_options.receiveWindowSize) {
+				tuned.max_receiver_window_buffer_size = _options.receiveWindowSize;
+			}
+
+			if (_options.maxMessageSize) {
+				tuned.max_message_size = _options.maxMessageSize;
+			}
+
+			if (_options.maxOutboundStreams) {
+				tuned.announced_maximum_outgoing_streams = _options.maxOutboundStreams;
+			}
+
+			if (_options.maxInboundStreams) {
+				tuned.announced_maximum_incoming_streams = _options.maxInboundStreams;
+			}
+
+			return dcsctp::DcSctpSocketFactory::Create(log_prefix, callbacks, std::move(packet_observer), tuned);
+		}
+
+	private:
+		RTCPeerConnection::RTCSctpTransportOptions _options;
+	};
+}
+
+SctpTransportFactory::SctpTransportFactory(rtc::Thread* network, const std::shared_ptr<SctpTuning>& tuning) :
+	_network(network),
+	_tuning(tuning)
+{
+
+}
+
+SctpTransportFactory::~SctpTransportFactory() {
+
+}
+
+std::unique_ptr<cricket::SctpTransportInternal> SctpTransportFactory::CreateSctpTransport(rtc::PacketTransportInternal* transport) {
+	RTCPeerConnection::RTCSctpTransportOptions options;
+
+	{
+		std::lock_guard<std::mutex> lock(_tuning->mutex);
+		options = _tuning->options;
+	}
+
+	return std::make_unique<webrtc::DcSctpTransport>(_network, transport, webrtc::Clock::GetRealTimeClock(), std::make_unique<TunedSocketFactory>(options));
+}
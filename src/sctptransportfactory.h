@@ -0,0 +1,33 @@
+#ifndef CRTC_SCTPTRANSPORTFACTORY_H
+#define CRTC_SCTPTRANSPORTFACTORY_H
+
+#include "crtc.h"
+#include "api/transport/sctp_transport_factory_interface.h"
+#include "rtc_base/thread.h"
+#include <memory>
+#include <mutex>
+
+namespace crtc {
+	// RTCConfiguration::sctp of one connection. The webrtc factory is built before SetConfiguration() runs, the
+	// options are read whenever a data channel transport is created, which only happens once a description is set.
+	struct SctpTuning {
+		std::mutex mutex;
+		RTCPeerConnection::RTCSctpTransportOptions options;
+	};
+
+	// Creates webrtc's dcsctp transport with a socket factory that applies the tuning on top of the options webrtc
+	// picked, fields left at 0 keep webrtc's values.
+	class SctpTransportFactory : public webrtc::SctpTransportFactoryInterface {
+	public:
+		explicit SctpTransportFactory(rtc::Thread* network, const std::shared_ptr<SctpTuning>& tuning);
+		~SctpTransportFactory() override;
+
+		std::unique_ptr<cricket::SctpTransportInternal> CreateSctpTransport(rtc::PacketTransportInternal* transport) override;
+
+	private:
+		rtc::Thread* _network;
+		std::shared_ptr<SctpTuning> _tuning;
+	};
+}
+
+#endif
@@ -0,0 +1,163 @@
+#include "timerwheel.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace crtc;
+
+static int LowestBit(uint64_t bits) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+static uint64_t RotateRight(uint64_t bits, int shift) {
+	shift &= TimerWheel::kSlots - 1;
+	return shift ? (bits >> shift) | (bits << (TimerWheel::kSlots - shift)) : bits;
+}
+
+TimerWheel::TimerWheel(int64_t now) :
+	_now(now),
+	_size(0)
+{
+	for (int level = 0; level < kLevels; level++) {
+		_occupied[level] = 0;
+
+		for (int slot = 0; slot < kSlots; slot++) {
+			_slots[level][slot] = nullptr;
+			_tails[level][slot] = nullptr;
+		}
+	}
+}
+
+void TimerWheel::Insert(TimerNode* node) {
+	int64_t expires = node->expires;
+	int64_t delta = expires - _now;
+	int level = 0;
+
+	while (level < kLevels - 1 && delta >= (int64_t(1) << (kBits * (level + 1)))) {
+		level++;
+	}
+
+	// Past the top level the timer parks in the farthest slot and is placed again when that slot cascades.
+	int64_t limit = (int64_t(1) << (kBits * kLevels)) - 1;
+
+	if (delta > limit) {
+		expires = _now + limit;
+	}
+
+	Link(node, level, static_cast<int>((expires >> (kBits * level)) & (kSlots - 1)));
+	_size++;
+}
+
+void TimerWheel::Remove(TimerNode* node) {
+	if (node->prev) {
+		node->prev->next = node->next;
+	}
+	else {
+		_slots[node->level][node->slot] = node->next;
+
+		if (!node->next) {
+			_occupied[node->level] &= ~(uint64_t(1) << node->slot);
+		}
+	}
+
+	if (node->next) {
+		node->next->prev = node->prev;
+	}
+	else {
+		_tails[node->level][node->slot] = node->prev;
+	}
+
+	node->prev = nullptr;
+	node->next = nullptr;
+	_size--;
+}
+
+int64_t TimerWheel::Next() const {
+	int64_t next = kNever;
+
+	for (int level = 0; level < kLevels; level++) {
+		if (!_occupied[level]) {
+			continue;
+		}
+
+		// Slots are scanned from the one after the current position, the current slot itself comes last.
+		int shift = kBits * level;
+		int64_t position = _now >> shift;
+		int offset = LowestBit(RotateRight(_occupied[level], static_cast<int>((position + 1) & (kSlots - 1)))) + 1;
+		int64_t tick = (position + offset) << shift;
+
+		if (tick < next) {
+			next = tick;
+		}
+	}
+
+	return next;
+}
+
+int64_t TimerWheel::NextStep() const {
+	// Next occupied level 0 slot before the wheel turns over, otherwise the turn over itself (it cascades).
+	int64_t boundary = (_now | (kSlots - 1)) + 1;
+	int start = static_cast<int>((_now + 1) & (kSlots - 1));
+
+	if (!start) {
+		return boundary;
+	}
+
+	uint64_t bits = _occupied[0] & (~uint64_t(0) << start);
+
+	if (bits) {
+		return (_now & ~int64_t(kSlots - 1)) + LowestBit(bits);
+	}
+
+	return boundary;
+}
+
+void TimerWheel::Cascade() {
+	for (int level = 1; level < kLevels; level++) {
+		int slot = static_cast<int>((_now >> (kBits * level)) & (kSlots - 1));
+		TimerNode* node = _slots[level][slot];
+
+		_slots[level][slot] = nullptr;
+		_tails[level][slot] = nullptr;
+		_occupied[level] &= ~(uint64_t(1) << slot);
+
+		while (node) {
+			TimerNode* next = node->next;
+
+			_size--;
+			Insert(node);
+			node = next;
+		}
+
+		// The next level only turns over when this one wrapped around.
+		if (slot) {
+			break;
+		}
+	}
+}
+
+void TimerWheel::Link(TimerNode* node, int level, int slot) {
+	TimerNode* tail = _tails[level][slot];
+
+	node->level = static_cast<uint8_t>(level);
+	node->slot = static_cast<uint8_t>(slot);
+	node->prev = tail;
+	node->next = nullptr;
+
+	if (tail) {
+		tail->next = node;
+	}
+	else {
+		_slots[level][slot] = node;
+	}
+
+	_tails[level][slot] = node;
+	_occupied[level] |= uint64_t(1) << slot;
+}
@@ -0,0 +1,94 @@
+#ifndef CRTC_TIMERWHEEL_H
+#define CRTC_TIMERWHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace crtc {
+	// Intrusive node of a TimerWheel, linked into one slot while it is scheduled.
+	struct TimerNode {
+		TimerNode* prev;
+		TimerNode* next;
+		int64_t expires; // tick
+		uint8_t level;
+		uint8_t slot;
+	};
+
+	// Hierarchical timing wheel of kLevels x kSlots slots, a slot on level n spans kSlots^n ticks.
+	// Insert() and Remove() are O(1), timers move one level down when the wheel reaches their slot and all timers
+	// of a tick expire together. Not thread safe, the owner locks.
+	class TimerWheel {
+	public:
+		static constexpr int kBits = 6;
+		static constexpr int kSlots = 1 << kBits;
+		static constexpr int kLevels = 4;
+		static constexpr int64_t kNever = INT64_MAX;
+
+		explicit TimerWheel(int64_t now);
+
+		// node->expires has to be later than Now().
+		void Insert(TimerNode* node);
+		void Remove(TimerNode* node);
+
+		// Moves the wheel to now and calls expired(node) for every timer that expired on the way.
+		template <typename F> void Advance(int64_t now, F&& expired) {
+			while (_now < now) {
+				if (!_size) {
+					_now = now;
+					break;
+				}
+
+				int64_t step = NextStep();
+
+				if (step > now) {
+					_now = now;
+					break;
+				}
+
+				_now = step;
+
+				if (!(_now & (kSlots - 1))) {
+					Cascade();
+				}
+
+				int slot = static_cast<int>(_now & (kSlots - 1));
+				TimerNode* node = _slots[0][slot];
+
+				_slots[0][slot] = nullptr;
+				_tails[0][slot] = nullptr;
+				_occupied[0] &= ~(uint64_t(1) << slot);
+
+				while (node) {
+					TimerNode* next = node->next;
+
+					node->prev = nullptr;
+					node->next = nullptr;
+					_size--;
+
+					expired(node);
+					node = next;
+				}
+			}
+		}
+
+		// Tick at which Advance() has work next, kNever when no timer is scheduled. Timers on the upper levels report
+		// the tick they cascade at, which is never later than their expiry.
+		int64_t Next() const;
+
+		int64_t Now() const { return _now; }
+		size_t Size() const { return _size; }
+
+	private:
+		int64_t NextStep() const;
+		void Cascade();
+		void Link(TimerNode* node, int level, int slot);
+
+		TimerNode* _slots[kLevels][kSlots];
+		TimerNode* _tails[kLevels][kSlots];
+		uint64_t _occupied[kLevels];
+		int64_t _now;
+		size_t _size;
+	};
+}
+
+#endif
@@ -8,6 +8,9 @@
 #include <tuple>
 #include <utility>
 #include <any>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 namespace crtc {
 
@@ -121,6 +124,146 @@ namespace crtc {
 		mutable std::optional<std::tuple<Args...>> stored;
 	};
 
+	// callback whose invoke path takes no lock: a call pins the current epoch with one atomic increment and runs the
+	// installed function directly. Assigning waits until calls still running the previous function have returned
+	// (two epoch flips, so a steady stream of new calls cannot starve it), unless the assignment is made from inside
+	// one of those calls, then the previous function is retired and freed by the next assignment.
+	template <typename... Args> class atomic_callback {
+	public:
+		atomic_callback() : _current(nullptr), _epoch(0) {
+			_readers[0] = 0;
+			_readers[1] = 0;
+		}
+
+		atomic_callback(std::function<void(Args...)> func) : atomic_callback() { *this = std::move(func); }
+		atomic_callback(const atomic_callback&) = delete;
+		atomic_callback& operator=(const atomic_callback&) = delete;
+
+		~atomic_callback() {
+			*this = nullptr;
+
+			for (auto slot : _retired) {
+				delete slot;
+			}
+		}
+
+		atomic_callback& operator=(std::function<void(Args...)> func) {
+			Slot* slot = func ? new Slot{ std::move(func) } : nullptr;
+			std::lock_guard<std::mutex> lock(_mutex);
+			Slot* previous = _current.exchange(slot);
+
+			if (Invoking()) {
+				if (previous) {
+					_retired.push_back(previous);
+				}
+
+				return *this;
+			}
+
+			Synchronize();
+			delete previous;
+
+			for (auto retired : _retired) {
+				delete retired;
+			}
+
+			_retired.clear();
+			return *this;
+		}
+
+		template <typename... CallArgs> bool operator()(CallArgs&&... args) const {
+			Pin pin(this);
+			Slot* slot = _current.load();
+
+			if (!slot) {
+				return false;
+			}
+
+			slot->func(std::forward<CallArgs>(args)...);
+			return true;
+		}
+
+		operator bool() const {
+			return _current.load() != nullptr;
+		}
+
+		// Copy of the installed function, for calls that run later on another thread.
+		std::function<void(Args...)> load() const {
+			Pin pin(this);
+			Slot* slot = _current.load();
+
+			return slot ? slot->func : nullptr;
+		}
+
+	private:
+		struct Slot {
+			std::function<void(Args...)> func;
+		};
+
+		// Calls running on this thread, walked by an assignment to detect reentrancy.
+		struct Frame {
+			const atomic_callback* owner;
+			Frame* previous;
+		};
+
+		static Frame*& Frames() {
+			static thread_local Frame* frames = nullptr;
+			return frames;
+		}
+
+		class Pin {
+		public:
+			explicit Pin(const atomic_callback* owner) :
+				_owner(owner),
+				_epoch(owner->_epoch.load() & 1),
+				_frame{ owner, Frames() }
+			{
+				_owner->_readers[_epoch].fetch_add(1);
+				Frames() = &_frame;
+			}
+
+			~Pin() {
+				Frames() = _frame.previous;
+				_owner->_readers[_epoch].fetch_sub(1);
+			}
+
+		private:
+			const atomic_callback* _owner;
+			unsigned _epoch;
+			Frame _frame;
+		};
+
+		bool Invoking() const {
+			for (Frame* frame = Frames(); frame; frame = frame->previous) {
+				if (frame->owner == this) {
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void Synchronize() {
+			for (int flip = 0; flip < 2; flip++) {
+				unsigned epoch = _epoch.load() & 1;
+
+				_epoch.store(epoch ^ 1);
+
+				while (_readers[epoch].load() != 0) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		std::atomic<Slot*> _current;
+		mutable std::atomic<unsigned> _epoch;
+
+		// Written by every call, kept off the line that holds _current.
+		alignas(64) mutable std::atomic<intptr_t> _readers[2];
+		std::mutex _mutex;
+		std::vector<Slot*> _retired;
+	};
+
 	// pimpl base class
 	template <typename T> using impl_ptr = std::shared_ptr<T>;
 	template <typename T> class CheshireCat {